@@ -27,6 +27,7 @@
 #include <System/symbols.h>
 #include <Parser/context_parser.h>
 #include <API/compile_settings.h>
+#include <API/parse_stats.h>
 
 #if !defined(__APPLE__) && !defined(__FreeBSD__)
 #include <malloc.h>
@@ -118,32 +119,31 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
     case TT_CLASS: case TT_STRUCT: case TT_ENUM: case TT_UNION: {
         full_type ft = cparse->read_type(token, search_scope); // Read the full set of declarators
         track(ft.toString());
-        myroot = make_unique<AST_Node_Type>(ft);
-        myroot->filename = token.get_filename();
-        myroot->linenum = token.linenum;
-        myroot->pos = token.pos;
+        myroot = ast->make<AST_Node_Type>(ft);
+        myroot->locate(token);
         handled_basics = read_next = true;
       } break;
 
     case TT_DECLARATOR: case TT_DEFINITION:
         at = AT_DEFINITION;
-        myroot = make_unique<AST_Node_Definition>(token.def, token.content.toString());
+        myroot = ast->make<AST_Node_Definition>(token.def, token.content.toString());
         track(myroot->content);
       break;
 
     case TT_IDENTIFIER: {
         if (search_scope) {
           string n(token.content.toString());
+          ParseStats::count(&ParseStats::lookups);
           definition *def = search_scope->look_up(n);
           if (def) {
-            myroot = make_unique<AST_Node_Definition>(def, token.content.toString());
+            myroot = ast->make<AST_Node_Definition>(def, token.content.toString());
             at = AT_DEFINITION;
           }
           else
-            myroot = make_unique<AST_Node>(token.content.toString(), at = AT_IDENTIFIER);
+            myroot = ast->make<AST_Node>(token.content.toString(), at = AT_IDENTIFIER);
         }
         else
-          myroot = make_unique<AST_Node>(token.content.toString(), at = AT_IDENTIFIER);
+          myroot = ast->make<AST_Node>(token.content.toString(), at = AT_IDENTIFIER);
 
         track(myroot->content);
       } break;
@@ -173,7 +173,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
         token.report_errorf(herr, "Expected identifier to treat as template before %s");
         return nullptr;
       }
-      myroot = make_unique<AST_Node>(token.content.toString(), at = AT_TEMPID);
+      myroot = ast->make<AST_Node>(token.content.toString(), at = AT_TEMPID);
       break;
 
     case TT_SLASH: case TT_MODULO: case TT_NOT_EQUAL_TO: case TT_EQUAL_TO:
@@ -190,16 +190,19 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
     case TT_PLUS: case TT_MINUS: case TT_INCREMENT: case TT_DECREMENT:
     case TT_NOT: case TT_TILDE: case TT_STAR: case TT_AMPERSAND: case TT_AMPERSANDS: {
       ct = token.content.toString();
-      symbol& op = symbols[ct];
+      const operator_info &op = operators[token.type];
       if (not(op.type & ST_UNARY_PRE)) {
         token.report_error(herr, "Operator " + ct
                            + " cannot be used as unary prefix");
         return nullptr;
       }
       track(ct);
+      auto unary = ast->make<AST_Node_Unary>(nullptr, ct, true);
+      unary->locate(token);
       token = get_next_token();
-      myroot = make_unique<AST_Node_Unary>(parse_expression(ast, token, op.prec_unary_pre), ct, true);
-      read_next = true;
+      unary->operand = parse_expression(ast, token, op.prec_unary_pre);
+      myroot = fold(ast, std::move(unary));
+      handled_basics = read_next = true;
     } break;
 
     case TT_GREATERTHAN: case TT_LESSTHAN: case TT_COLON:
@@ -231,8 +234,8 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
         token = get_next_token();
         read_next = true;
 
-        auto nr = make_unique<AST_Node_Cast>(
-            parse_expression(ast, token, symbols["(cast)"].prec_unary_pre));
+        auto nr = ast->make<AST_Node_Cast>(
+            parse_expression(ast, token, precedence::unary_pre));
         nr->cast_type.swap(ad->dec_type);
         nr->content = nr->cast_type.toString();
         myroot = std::move(nr);
@@ -242,8 +245,8 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
         token = get_next_token();
         read_next = true;
 
-        auto nr = make_unique<AST_Node_Cast>(
-            parse_expression(ast, token, symbols["(cast)"].prec_unary_pre));
+        auto nr = ast->make<AST_Node_Cast>(
+            parse_expression(ast, token, precedence::unary_pre));
         nr->cast_type.def = ad->def;
         nr->content = nr->cast_type.toString();
         myroot = std::move(nr);
@@ -254,7 +257,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
 
     case TT_LEFTBRACKET:
     case TT_LEFTBRACE: {
-      auto array = make_unique<AST_Node_Array>();
+      auto array = ast->make<AST_Node_Array>();
       token = get_next_token();
       while (token.type != TT_RIGHTBRACE and token.type != TT_SEMICOLON and token.type != TT_ENDOFCODE) {
         unique_ptr<AST_Node> node =
@@ -283,7 +286,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
 
     case TT_NEW: {
       token = get_next_token();
-      auto ann = make_unique<AST_Node_new>();
+      auto ann = ast->make<AST_Node_new>();
       if (token.type == TT_LEFTPARENTH) {
         track(string("("));
         ann->position = parse_expression(ast, token, 0);
@@ -333,7 +336,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
           return nullptr;
         }
       }
-      myroot = make_unique<AST_Node_delete>(
+      myroot = ast->make<AST_Node_delete>(
           parse_expression(ast, token, precedence::unary_pre), is_array);
     } break;
 
@@ -342,29 +345,29 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
       herr->error(token) << "Expected expression before " << token;
       return nullptr;
 
-    case TT_STRINGLITERAL: myroot = make_unique<AST_Node>(unescape(token.content.str, token.content.len), at = AT_STRLITERAL);
+    case TT_STRINGLITERAL: myroot = ast->make<AST_Node>(unescape(token.content.str, token.content.len), at = AT_STRLITERAL);
                            track(token.content.toString()); break;
-    case TT_CHARLITERAL:   myroot = make_unique<AST_Node>(unescape(token.content.str, token.content.len), at = AT_CHRLITERAL);
+    case TT_CHARLITERAL:   myroot = ast->make<AST_Node>(unescape(token.content.str, token.content.len), at = AT_CHRLITERAL);
                            track(token.content.toString()); break;
 
     case TT_DECLITERAL:
-        myroot = make_unique<AST_Node>(token.content.toString(), at = AT_DECLITERAL);
+        myroot = ast->make<AST_Node>(token.content.toString(), at = AT_DECLITERAL);
         track(myroot->content);
       break;
     case TT_HEXLITERAL:
-        myroot = make_unique<AST_Node>(token.content.toString(), at = AT_HEXLITERAL);
+        myroot = ast->make<AST_Node>(token.content.toString(), at = AT_HEXLITERAL);
         track(myroot->content);
       break;
     case TT_OCTLITERAL:
-        myroot = make_unique<AST_Node>(token.content.toString(), at = AT_OCTLITERAL);
+        myroot = ast->make<AST_Node>(token.content.toString(), at = AT_OCTLITERAL);
         track(myroot->content);
       break;
     case TT_BINLITERAL:
-        myroot = make_unique<AST_Node>(token.content.toString(), at = AT_BINLITERAL);
+        myroot = ast->make<AST_Node>(token.content.toString(), at = AT_BINLITERAL);
         track(myroot->content);
       break;
     case TT_TRUE: case TT_FALSE:
-        myroot = make_unique<AST_Node>(token.content.toString(), at = AT_BOOLLITERAL);
+        myroot = ast->make<AST_Node>(token.content.toString(), at = AT_BOOLLITERAL);
         track(myroot->content);
       break;
 
@@ -396,7 +399,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
       // some decltype node, but I'm lazy.
       ErrorContext errc(herr, dt_tok);
       full_type ft = coerce_node->coerce(errc);
-      myroot = make_unique<AST_Node_Type>(ft);
+      myroot = ast->make<AST_Node_Type>(ft);
       at = AT_DEFINITION;
       read_next = true;
       break;
@@ -424,7 +427,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
         if (token.type == TT_LEFTPARENTH) {
           token = get_next_token(); track(string("("));
           full_type ft = cparse->read_fulltype(token, search_scope);
-          myroot = make_unique<AST_Node_sizeof>(make_unique<AST_Node_Type>(ft), not_result);
+          myroot = ast->make<AST_Node_sizeof>(ast->make<AST_Node_Type>(ft), not_result);
           if (token.type != TT_RIGHTPARENTH) {
             herr->error(token)
                 << "Expected closing parenthesis to `sizeof` before "
@@ -434,7 +437,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
             token = get_next_token();
           }
         } else {
-          myroot = make_unique<AST_Node_sizeof>(parse_expression(ast, token,precedence::unary_pre), not_result);
+          myroot = ast->make<AST_Node_sizeof>(parse_expression(ast, token,precedence::unary_pre), not_result);
         }
         at = AT_UNARY_PREFIX;
         read_next = true;
@@ -466,7 +469,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
         return nullptr;
       }
       token = get_next_token();
-      myroot = make_unique<AST_Node_Cast>(parse_expression(ast, token, 0), casttype, mode);
+      myroot = ast->make<AST_Node_Cast>(parse_expression(ast, token, 0), casttype, mode);
       if (token.type != TT_RIGHTPARENTH) {
         token.report_errorf(herr, "Expected closing parenthesis for cast expression before %s");
         return nullptr;
@@ -499,9 +502,7 @@ unique_ptr<AST_Node> AST_Builder::parse_expression(AST* ast, token_t &token, int
   }
   if (!handled_basics) {
     myroot->type = at;
-    myroot->filename = token.get_filename();
-    myroot->linenum = token.linenum;
-    myroot->pos = token.pos;
+    myroot->locate(token);
   }
   if (!read_next)
     token = get_next_token();
@@ -541,7 +542,7 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
         herr->error(token) << "Expected qualified-id for scope access";
         return left_node;
       }
-      left_node = make_unique<AST_Node_Scope>(std::move(left_node),
+      left_node = ast->make<AST_Node_Scope>(std::move(left_node),
                                               std::move(right), "::");
       break;
     }
@@ -563,7 +564,7 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
                ((AST_Node_Scope*) left_node.get())->right &&
                ((AST_Node_Scope*) left_node.get())->right->type == AT_TEMPID)) {
           track(string("<"));
-          auto ti = make_unique<AST_Node_TempInst>(std::move(left_node),
+          auto ti = ast->make<AST_Node_TempInst>(std::move(left_node),
                                                    "()<>");
           token = get_next_token();
 
@@ -607,9 +608,8 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
     case TT_AND_ASSIGN: case TT_OR_ASSIGN: case TT_XOR_ASSIGN: case TT_NEGATE_ASSIGN:
     case TT_THROW:
     case_TT_OPERATOR: {
-        string op(token.content.toString());
-        auto b = symbols.find(op);
-        if (b == symbols.end()) {
+        const operator_info &s = operators[token.type];
+        if (!s.type) {
           token.report_error(herr, "Operator `" + token.content.toString() + "' not defined");
           return nullptr;
         }
@@ -617,7 +617,7 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
           AST_Node_Definition *ad = (AST_Node_Definition*) left_node.get();
           if (ad->def->flags & DEF_TYPENAME) {
             full_type cme(ad->def);
-            left_node = make_unique<AST_Node_Type>(cme);
+            left_node = ast->make<AST_Node_Type>(cme);
           }
         }
         if (left_node->type == AT_TYPE) {
@@ -640,7 +640,7 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
               << PQuote(((AST_Node_Type*) left_node.get())->dec_type);
           return nullptr;
         }
-        symbol &s = b->second;
+        string op(token.content.toString());
         if (s.type & ST_BINARY) {
           if (s.prec_binary < prec_min)
             return left_node;
@@ -653,8 +653,8 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
                 << PQuote(op);
             return left_node;
           }
-          left_node = make_unique<AST_Node_Binary>(std::move(left_node),
-                                                   std::move(right), op);
+          left_node = fold(ast, ast->make<AST_Node_Binary>(
+              std::move(left_node), std::move(right), op));
         } else if (s.type & ST_TERNARY) {
           if (s.prec_binary < prec_min)
             return left_node;
@@ -674,14 +674,14 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
           unique_ptr<AST_Node> expfalse = parse_expression(ast, token, 0);
           if (!expfalse) return nullptr;
 
-          left_node = make_unique<AST_Node_Ternary>(
+          left_node = fold(ast, ast->make<AST_Node_Ternary>(
               std::move(left_node), std::move(exptrue), std::move(expfalse),
-              ct);
+              ct));
         } else if (s.type & ST_UNARY_POST) {
           if (s.prec_unary_post < prec_min)
             return left_node;
-          left_node = make_unique<AST_Node_Unary>(std::move(left_node),
-                                                  op, false);
+          left_node = fold(ast, ast->make<AST_Node_Unary>(
+              std::move(left_node), op, false));
           token = get_next_token();
         } else {
           if (s.type & ST_UNARY_PRE) {
@@ -739,12 +739,10 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
               cparse->read_referencers(ft.refs, ft, token, search_scope); // Read all referencers
               track(ft.refs.toString());
               if (!ant) {
-                auto uant = make_unique<AST_Node_Type>(ft);
+                auto uant = ast->make<AST_Node_Type>(ft);
                 ant = uant.get();
                 left_node = std::move(uant);
-                left_node->filename = token.get_filename();
-                left_node->linenum = token.linenum;
-                left_node->pos = token.pos;
+                left_node->locate(token);
               }
             }
             else {
@@ -755,7 +753,7 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
               }
               track(string("("));
               token = get_next_token();
-              auto nr = make_unique<AST_Node_Cast>(
+              auto nr = ast->make<AST_Node_Cast>(
                   parse_expression(ast, token, 0), ft);
               if (token.type == TT_RIGHTPARENTH) {
                 token = get_next_token();
@@ -767,9 +765,7 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
               nr->content = nr->cast_type.toString();
 
               left_node = std::move(nr);
-              left_node->filename = token.get_filename();
-              left_node->linenum = token.linenum;
-              left_node->pos = token.pos;
+              left_node->locate(token);
               track(string(")"));
             }
             break;
@@ -788,7 +784,7 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
             token.report_errorf(herr, "Expected closing parenthesis here before %s");
             FATAL_RETURN(left_node);
           }
-          left_node = make_unique<AST_Node_Binary>(std::move(left_node),
+          left_node = ast->make<AST_Node_Binary>(std::move(left_node),
                                                    std::move(params), "");
           token = get_next_token(); // Skip that closing paren
           track(string(")"));
@@ -806,8 +802,8 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
           token.report_error(herr, "Expected secondary expression after comma");
           return left_node;
         }
-        left_node = make_unique<AST_Node_Binary>(std::move(left_node),
-                                                 std::move(right), op);
+        left_node = fold(ast, ast->make<AST_Node_Binary>(
+            std::move(left_node), std::move(right), op));
       } break;
 
     case TT_LEFTBRACKET: {
@@ -820,7 +816,7 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
           token.report_error(herr, "Expected index for array subscript");
           return left_node;
         }
-        left_node = make_unique<AST_Node_Subscript>(std::move(left_node),
+        left_node = ast->make<AST_Node_Subscript>(std::move(left_node),
                                                     std::move(indx));
         if (token.type != TT_RIGHTBRACKET) {
           token.report_errorf(herr, "Expected closing bracket to array subscript before %s");
@@ -859,6 +855,66 @@ unique_ptr<AST_Node> AST_Builder::parse_binary_or_unary_post(
   return parse_binary_or_unary_post(ast, token, std::move(left_node), prec_min);
 }
 
+namespace {
+
+/// Notes whether anything was reported while folding an expression.
+struct FoldErrors: ErrorHandler {
+  bool reported = false;
+  void error(string_view, SourceLocation) final { reported = true; }
+  void warning(string_view, SourceLocation) final { reported = true; }
+  void info(string_view, int, SourceLocation) final {}
+};
+
+/// Returns whether the given node evaluates to the same value everywhere.
+bool is_constant(const AST_Node *node) {
+  if (!node) return false;
+  const AST_TYPE t = node->type;
+  if (t == AT_DECLITERAL || t == AT_HEXLITERAL || t == AT_OCTLITERAL
+      || t == AT_CHRLITERAL || t == AT_CONSTANT)
+    return true;
+  if (t != AT_DEFINITION) return false;
+  const definition *def = ((const AST_Node_Definition*) node)->def;
+  if (!def || !(def->flags & DEF_VALUED)) return false;
+  const value &v = ((const definition_valued*) def)->value_of;
+  return v.type == VT_INTEGER || v.type == VT_DOUBLE;
+}
+
+}  // namespace
+
+unique_ptr<AST_Node> AST_Builder::fold(AST *ast, unique_ptr<AST_Node> node) {
+  bool constant = false;
+  if (node->type == AT_UNARY_PREFIX || node->type == AT_UNARY_POSTFIX) {
+    constant = is_constant(((AST_Node_Unary*) node.get())->operand.get());
+  } else if (node->type == AT_BINARYOP) {
+    AST_Node_Binary *bin = (AST_Node_Binary*) node.get();
+    constant = is_constant(bin->left.get()) && is_constant(bin->right.get());
+  } else if (node->type == AT_TERNARYOP) {
+    AST_Node_Ternary *ter = (AST_Node_Ternary*) node.get();
+    constant = is_constant(ter->exp.get()) && is_constant(ter->left.get())
+            && is_constant(ter->right.get());
+  }
+  if (!constant) return node;
+
+  // Anything the evaluation would complain about is left to be reported when
+  // the expression is actually evaluated, where it is in context.
+  FoldErrors errs;
+  const ErrorContext errc = errs.at({"", 0, 0});
+  const value val = node->eval(errc);
+  const full_type type = node->coerce(errc);
+  if (errs.reported || (val.type != VT_INTEGER && val.type != VT_DOUBLE))
+    return node;
+
+  auto res = ast->make<AST_Node_Constant>(node->toString(), val, type);
+  #ifndef NO_ERROR_REPORTING
+    res->file = node->file;
+    res->linenum = node->linenum;
+    #ifndef NO_ERROR_POSITION
+      res->pos = node->pos;
+    #endif
+  #endif
+  return res;
+}
+
 token_t AST_Builder::get_next_token() {
   return search_scope
       ? lex->get_token_in_scope(search_scope)
@@ -870,12 +926,34 @@ token_t AST_Builder::get_next_token() {
 //===========================================================================================================================
 
 value AST::eval(const ErrorContext &errc) const {
+  ParseStats::timer evaluating(ParseStats::EVALUATION);
   if (!root) {
     errc.error("Evaluating a broken expression");
     return value();
   }
+  if (program)
+    return program->run(substitutions.empty() ? nullptr : &substitutions, errc);
   return root->eval(errc);
 }
+value AST::eval(const ErrorContext &errc, const remap_set &n) const {
+  ParseStats::timer evaluating(ParseStats::EVALUATION);
+  if (!program) {
+    AST remapped(*this, true);
+    remapped.remap(n, errc);
+    return remapped.eval(errc);
+  }
+  if (substitutions.empty()) return program->run(&n, errc);
+  // Our own substitutions are older than the given ones; make both.
+  remap_set both;
+  for (definition *def : program->names()) {
+    auto sub = substitutions.find(def);
+    definition *cur = sub == substitutions.end() ? def : sub->second;
+    auto it = n.find(cur);
+    if (it != n.end()) cur = it->second;
+    if (cur != def) both[def] = cur;
+  }
+  return program->run(&both, errc);
+}
 
 value AST_Node::eval(const ErrorContext &errc) const {
   if (type == AT_DECLITERAL) {
@@ -930,12 +1008,18 @@ value AST_Node_Definition::eval(const ErrorContext &errc) const {
   errc.error("Evaluating null definition");
   return value();
 }
+value AST_Node_Constant::eval(const ErrorContext &) const {
+  return val;
+}
 value AST_Node_Ternary::eval(const ErrorContext &errc) const {
   if (!exp) {
     errc.error("Bad ternary expression: cannot be evaluated");
     return value();
   }
-  if (exp->eval(errc)) {
+  const value cond = exp->eval(errc);
+  if (cond.type == VT_DEPENDENT)
+    return cond;
+  if (cond) {
     if (left) return left->eval(errc);
     errc.error("Bad ternary left operand: cannot be evaluated");
   } else {
@@ -949,18 +1033,19 @@ value AST_Node_Binary::eval(const ErrorContext &errc) const {
     errc.error("Invalid (null) operands");
     return value();
   }
-  symbol_iter si = symbols.find(content);
-  if (si == symbols.end()) {
-    errc.error("Internal error! Operator not found!");
+  if (!method) {
+    errc.error() << "No method to binary `operator" << content << "`!";
     return value();
   }
-  symbol &s = si->second;
-  if (!s.operate) {
-    errc.error("Internal error: Operator has no definition");
-    return value();
+  value l = left->eval(errc);
+  // The logical operators don't evaluate their right operand if the left
+  // one already decides the result, as in C++.
+  if (l.type == VT_INTEGER || l.type == VT_DOUBLE || l.type == VT_STRING) {
+    if (method == values_booland && !l) return value(0L);
+    if (method == values_boolor  &&  l) return value(1L);
   }
-  value l = left->eval(errc), r = right->eval(errc);
-  value res = s.operate(l, r);
+  value r = right->eval(errc);
+  value res = method(l, r);
   return res;
 }
 value AST_Node_Scope::eval(const ErrorContext &errc) const {
@@ -988,24 +1073,13 @@ value AST_Node_Unary::eval(const ErrorContext &errc) const {
     errc.error() << "No operand to unary `operator" << content << "`!";
     return value();
   }
-  if (prefix) {
-    if (!symbols[content].operate_unary_pre) {
-      errc.error() << "No method to unary `operator" << content << "`!";
-      return value();
-    }
-    value b4 = operand->eval(errc);
-    value after = symbols[content].operate_unary_pre(b4);
-    return after;
-  }
-  else {
-    if (!symbols[content].operate_unary_post) {
-      errc.error() << "No method to unary `operator" << content << "`!";
-      return value();
-    }
-    value b4 = operand->eval(errc);
-    value after = symbols[content].operate_unary_post(b4);
-    return after;
+  if (!method) {
+    errc.error() << "No method to unary `operator" << content << "`!";
+    return value();
   }
+  value b4 = operand->eval(errc);
+  value after = method(b4);
+  return after;
 }
 /*value AST_Node_Group::eval() {
   return root?root->eval(errc):value();
@@ -1126,7 +1200,9 @@ value AST_Node_TempKeyInst::eval(const ErrorContext &errc) const {
 //===========================================================================================================================
 
 full_type AST::coerce(const ErrorContext &errc) const {
-  return root? root->coerce(errc) : full_type();
+  if (!root) return full_type();
+  AST scratch;
+  return substituted(scratch, errc).root->coerce(errc);
 }
 
 full_type AST_Node::coerce(const ErrorContext &errc) const {
@@ -1250,6 +1326,12 @@ full_type AST_Node_Ternary::coerce(const ErrorContext &errc) const {
   return t1;
 }
 
+full_type AST_Node_Constant::coerce(const ErrorContext &) const {
+  full_type ret;
+  ret.copy(val_type);
+  return ret;
+}
+
 full_type AST_Node_Type::coerce(const ErrorContext &) const {
   full_type ret;
   ret.copy(dec_type);
@@ -1380,6 +1462,39 @@ static const string kStrCast("cast");
 
 AST_Node::AST_Node(AST_TYPE tp): type(tp) {}
 
+void AST_Node::locate(const token_t &token) {
+  #ifndef NO_ERROR_REPORTING
+    file = token.get_file_id();
+    linenum = token.linenum;
+    #ifndef NO_ERROR_POSITION
+      pos = token.pos;
+    #endif
+  #endif
+  (void) token;
+}
+
+// Each node is preceded by the arena it was allocated from, or null if it was
+// allocated on the heap; the header keeps the node maximally aligned.
+static constexpr size_t kNodeHeader = quick::arena::alignment;
+static_assert(kNodeHeader >= sizeof(quick::arena*), "Node header too small");
+
+void *AST_Node::operator new(size_t size) {
+  char *block = (char*) ::operator new(size + kNodeHeader);
+  *(quick::arena**) block = nullptr;
+  return block + kNodeHeader;
+}
+void *AST_Node::operator new(size_t size, quick::arena &arena) {
+  char *block = (char*) arena.allocate(size + kNodeHeader);
+  *(quick::arena**) block = &arena;
+  return block + kNodeHeader;
+}
+void AST_Node::operator delete(void *node) {
+  if (!node) return;
+  char *block = (char*) node - kNodeHeader;
+  if (!*(quick::arena**) block) ::operator delete(block);
+}
+void AST_Node::operator delete(void*, quick::arena&) {}
+
 AST_Node::AST_Node(string_view ct, AST_TYPE tp): type(tp), content(ct) {}
 
 AST_Node_Definition::AST_Node_Definition(definition* d, string_view ct):
@@ -1389,6 +1504,12 @@ AST_Node_Scope::AST_Node_Scope(unique_ptr<AST_Node> l, unique_ptr<AST_Node> r,
                                string_view op):
     AST_Node_Binary(std::move(l), std::move(r), op, AT_SCOPE) {}
 
+AST_Node_Constant::AST_Node_Constant(string_view ct, const value &v,
+                                     const full_type &ft):
+    AST_Node(ct, AT_CONSTANT), val(v) {
+  val_type.copy(ft);
+}
+
 AST_Node_Type::AST_Node_Type(full_type &ft):
     AST_Node(AT_TYPE) {
   dec_type.swap(ft);
@@ -1397,14 +1518,28 @@ AST_Node_Type::AST_Node_Type(full_type &ft):
 AST_Node_Unary::AST_Node_Unary(AST_TYPE tp, unique_ptr<AST_Node> r):
     AST_Node(tp), operand(std::move(r)) {}
 
+// Operators are resolved once, here, so that evaluation needn't search the
+// symbol table by name. The table is only read, so this is safe to do from
+// any number of threads.
+static const symbol *find_symbol(string_view op) {
+  const symbol_table &table = symbols;
+  auto si = table.find(op);
+  return si == table.end() ? nullptr : &si->second;
+}
+static value (*unary_method(string_view op, bool pre))(const value&) {
+  const symbol *s = find_symbol(op);
+  return !s ? nullptr : pre ? s->operate_unary_pre : s->operate_unary_post;
+}
+
 AST_Node_Unary::AST_Node_Unary(unique_ptr<AST_Node> r, string_view ct, bool pre,
                                AST_TYPE tp):
-    AST_Node(ct, tp), operand(std::move(r)), prefix(pre) {}
+    AST_Node(ct, tp), operand(std::move(r)), prefix(pre),
+    method(unary_method(ct, pre)) {}
 
 AST_Node_Unary::AST_Node_Unary(unique_ptr<AST_Node> r, string_view ct,
                                bool pre):
     AST_Node(ct, pre? AT_UNARY_PREFIX : AT_UNARY_POSTFIX),
-    operand(std::move(r)), prefix(pre) {}
+    operand(std::move(r)), prefix(pre), method(unary_method(ct, pre)) {}
 
 AST_Node_sizeof::AST_Node_sizeof(unique_ptr<AST_Node> param, bool n):
     AST_Node_Unary(std::move(param), kStrSizeof, true, AT_SIZEOF), negate(n) {}
@@ -1436,6 +1571,7 @@ AST_Node_Binary::AST_Node_Binary(unique_ptr<AST_Node> l, unique_ptr<AST_Node> r,
                                  string_view op, AST_TYPE tp):
     AST_Node(op, tp), left(std::move(l)), right(std::move(r)) {
   assert(type == tp);
+  if (const symbol *s = find_symbol(op)) method = s->operate;
 }
 
 AST_Node_Ternary::AST_Node_Ternary(unique_ptr<AST_Node> expression,
@@ -1504,6 +1640,7 @@ void AST_Node_delete     ::operate(ASTOperator *aop, void *param) { aop->operate
 void AST_Node_Subscript  ::operate(ASTOperator *aop, void *param) { aop->operate_Subscript  (this, param); }
 void AST_Node_TempInst   ::operate(ASTOperator *aop, void *param) { aop->operate_TempInst   (this, param); }
 void AST_Node_TempKeyInst::operate(ASTOperator *aop, void *param) { aop->operate_TempKeyInst(this, param); }
+void AST_Node_Constant   ::operate(ASTOperator *aop, void *param) { aop->operate_Constant   (this, param); }
 
 void AST_Node            ::operate(ConstASTOperator *aop, void *param) const { aop->operate            (this, param); }
 void AST_Node_Definition ::operate(ConstASTOperator *aop, void *param) const { aop->operate_Definition (this, param); }
@@ -1521,8 +1658,18 @@ void AST_Node_delete     ::operate(ConstASTOperator *aop, void *param) const { a
 void AST_Node_Subscript  ::operate(ConstASTOperator *aop, void *param) const { aop->operate_Subscript  (this, param); }
 void AST_Node_TempInst   ::operate(ConstASTOperator *aop, void *param) const { aop->operate_TempInst   (this, param); }
 void AST_Node_TempKeyInst::operate(ConstASTOperator *aop, void *param) const { aop->operate_TempKeyInst(this, param); }
+void AST_Node_Constant   ::operate(ConstASTOperator *aop, void *param) const { aop->operate_Constant   (this, param); }
 
 void AST::remap(const remap_set& n, ErrorContext errc) {
+  if (program) {
+    for (definition *def : program->names()) {
+      auto sub = substitutions.find(def);
+      auto it = n.find(sub == substitutions.end() ? def : sub->second);
+      if (it != n.end()) substitutions[def] = it->second;
+    }
+    return;
+  }
+  unshare(errc);
   if (root)
     root->remap(n, errc);
 }
@@ -1534,6 +1681,9 @@ void AST::remap(const remap_set& n, ErrorContext errc) {
 int AST_Builder::parse_expression(AST *ast, token_t &token,
                                   definition_scope *scope, int precedence) {
   search_scope = scope;
+  ast->program.reset();
+  ast->substitutions.clear();
+  if (ast->arena.use_count() > 1) ast->arena.reset();
   return !(ast->root = parse_expression(ast, token, precedence));
 }
 
@@ -1541,14 +1691,35 @@ void AST::clear() {
   #ifdef DEBUG_MODE
     expression.clear();
   #endif
+  program.reset();
+  substitutions.clear();
   root.reset();
+  arena.reset();
+}
+void AST::compile() {
+  if (!program) program = AST_Bytecode::compile(root.get());
 }
-bool AST::empty() {
+bool AST::empty() const {
   return !root;
 }
 
+void AST::operate(ASTOperator *aop, void *p) {
+  unshare(default_error_handler->at({
+      __FILE__ " @ AST::operate", __LINE__ + 1, 0}));
+  if (root) root->operate(aop, p);
+}
+void AST::operate(ConstASTOperator *caop, void *p) const {
+  if (!root) return;
+  AST scratch;
+  substituted(scratch, default_error_handler->at({
+      __FILE__ " @ AST::operate", __LINE__ + 1, 0})).root->operate(caop, p);
+}
+
 void AST::swap(AST& o) {
+  o.arena.swap(arena);
   o.root.swap(root);
+  o.program.swap(program);
+  o.substitutions.swap(substitutions);
 }
 
 AST::AST(): root(nullptr), tt_greater_is_op(true) {}
@@ -30,7 +30,9 @@
 #define JDI_API_AST_h_debug // Used in debug_macros.h. Do not rename on a whim.
 
 #include "AST_forward.h"
+#include "AST_bytecode.h"
 
+#include <General/quickarena.h>
 #include <Storage/arg_key.h>
 #include <System/token.h>
 #include <System/lex_cpp.h>
@@ -76,6 +78,7 @@ enum AST_TYPE {
   AT_DELETE,      ///< This node is a delete or delete[] operator.
   AT_INSTANTIATE, ///< This node is a template instantiation.
   AT_INSTBYKEY,   ///< This node is a template instantiation with an arg_key.
+  AT_CONSTANT,    ///< This node is an expression of constants, evaluated as it was read.
   AT_USERBEGIN    ///< This is the first user-defined token index.
 };
 
@@ -88,13 +91,26 @@ struct AST_Node {
   std::string content; ///< The literal, as a string, such as "1234", or the symbol representing the operator, as a symbol for lookup, such as "+=".
 
   #ifndef NO_ERROR_REPORTING
-    std::string filename; ///< The name of the file in which the token was created, for error reporting.
-    int linenum; ///< The line on which this token appeared in the file.
+    uint32_t file = 0; ///< The \c FileTable ID of the file in which the token was created, for error reporting.
+    uint32_t linenum = 0; ///< The line on which this token appeared in the file.
     #ifndef NO_ERROR_POSITION
-      int pos; ///< The position at which this token appeared in the line.
+      uint32_t pos = 0; ///< The position at which this token appeared in the line.
     #endif
   #endif
 
+  /// Record the location of the given token as that of this node.
+  void locate(const token_t &token);
+
+  /// Allocate a node on the heap.
+  static void *operator new(size_t size);
+  /// Allocate a node from the given arena; see \c AST::make().
+  static void *operator new(size_t size, quick::arena &arena);
+  /// Free a node allocated by either of the above. Memory from an arena is
+  /// left to the arena, to be given back all at once.
+  static void operator delete(void *node);
+  /// Called only if a constructor throws; the arena keeps the memory.
+  static void operator delete(void *node, quick::arena &arena);
+
   /// Evaluates this node recursively, returning a value containing its result.
   virtual value eval(const ErrorContext &errc) const;
   /// Coerces this node recursively for type, returning a full_type representing it.
@@ -134,6 +150,9 @@ struct AST_Node {
 struct AST_Node_Unary: AST_Node {
   unique_ptr<AST_Node> operand; ///< The stuff we're operating on.
   bool prefix; ///< True if we are a unary prefix, false otherwise.
+  /// Method to perform this operation, looked up from \c symbols when this
+  /// node is constructed; null if the operator has no such method.
+  value (*method)(const value&) = nullptr;
 
   /// Evaluates this node recursively, returning a value containing its result.
   value eval(const ErrorContext &errc) const override;
@@ -288,6 +307,23 @@ struct AST_Node_Definition: AST_Node {
   ~AST_Node_Definition() override = default;
 };
 
+/// Child of AST_Node for an expression of constants, which was folded into
+/// its value when it was read. The content is the text of that expression.
+struct AST_Node_Constant: AST_Node {
+  value val;          ///< The value to which the expression evaluated.
+  full_type val_type; ///< The type to which the expression coerced.
+
+  unique_ptr<AST_Node> duplicate() const override;
+  value eval(const ErrorContext &errc) const override; ///< Returns \c val.
+  full_type coerce(const ErrorContext &errc) const override; ///< Returns a copy of \c val_type.
+  void operate(ASTOperator *aop, void *p) override;
+  void operate(ConstASTOperator *caop, void *p) const override;
+
+  AST_Node_Constant(string_view content, const value &val,
+                    const full_type &type);
+  ~AST_Node_Constant() override = default;
+};
+
 /// Child of AST_Node for tokens with an attached \c full_type.
 struct AST_Node_Type: AST_Node {
   full_type dec_type; ///< The \c full_type read into this node.
@@ -314,6 +350,9 @@ struct AST_Node_Type: AST_Node {
 struct AST_Node_Binary: AST_Node {
   unique_ptr<AST_Node> left; ///< The left-hand side of the expression.
   unique_ptr<AST_Node> right; ///< The right-hand side of the expression.
+  /// Method to perform this operation, looked up from \c symbols when this
+  /// node is constructed; null if the operator has no such method.
+  value (*method)(const value&, const value&) = nullptr;
 
   /// Evaluates this node recursively, returning a \c value.
   virtual value eval(const ErrorContext &errc) const;
@@ -508,8 +547,38 @@ class AST {
   friend struct jdi::ConstASTOperator;
   friend class jdi::AST_Builder;
 
+  // Copies of an AST share its nodes and program, which are not changed while
+  // shared; see unshare(). A compiled AST is remapped by recording the
+  // substitutions, rather than by copying and changing its nodes.
+
+  /// The memory from which \c AST_Builder allocates our nodes, created with
+  /// the first of them. Declared before \c root, so that it outlives them.
+  std::shared_ptr<quick::arena> arena;
   /// The first node in our AST--The last operation that will be performed.
-  unique_ptr<AST_Node> root;
+  std::shared_ptr<AST_Node> root;
+  /// The tree compiled for evaluation, if \c compile() was called and the
+  /// tree could be compiled.
+  std::shared_ptr<const AST_Bytecode> program;
+  /// Definitions to read in place of those the nodes name, as if the nodes
+  /// had been remapped. Only compiled ASTs hold any; entries are kept only
+  /// for the inputs of the program.
+  remap_set substitutions;
+
+  /// Give this AST its own copy of its nodes, with any substitutions made,
+  /// so that they may be changed. Drops the program, which may no longer
+  /// describe the nodes once they are changed.
+  void unshare(const ErrorContext &errc);
+  /// Returns this AST, or if it holds substitutions, \p scratch made into
+  /// a copy of it with the substitutions made in its nodes.
+  const AST &substituted(AST &scratch, const ErrorContext &errc) const;
+
+  /// Allocate a node from our arena. Nodes so allocated must stay within
+  /// this AST; they are destructed as usual, but their memory is only given
+  /// back with the arena, so throwaway trees cost a few large allocations.
+  template<typename T, typename... Args> unique_ptr<T> make(Args&&... args) {
+    if (!arena) arena = std::make_shared<quick::arena>();
+    return unique_ptr<T>(new (*arena) T(std::forward<Args>(args)...));
+  }
 
   // State flags =============================================================
 
@@ -536,11 +605,20 @@ class AST {
   string expression; ///< The string representation of the expression fed in, for debug purposes.
   #endif
 
-  /// Filter this AST through a definition remap_set, to update references to old definitions.
+  /// Filter this AST through a definition remap_set, to update references to
+  /// old definitions. Compiled ASTs keep sharing their nodes.
   void remap(const remap_set &n, ErrorContext errc);
 
   /// Evaluate the current AST, returning its \c value.
   value eval(const ErrorContext &errc) const;
+  /// Evaluate this AST as if it were first remapped with the given set,
+  /// without changing it. Faster than a remapped duplicate once compiled.
+  value eval(const ErrorContext &errc, const remap_set &substitutions) const;
+
+  /// Compile this AST into a linear program for evaluation, so that ASTs
+  /// kept and evaluated many times needn't walk the tree. Trees which can't
+  /// be compiled are left to be evaluated as before.
+  void compile();
 
   /// Coerce the current AST for the type of its result.
   full_type coerce(const ErrorContext &errc) const;
@@ -549,9 +627,9 @@ class AST {
   void clear();
 
   /// Check if this AST is empty.
-  bool empty();
+  bool empty() const;
 
-  /// Return a new copy of this entire AST.
+  /// Return a new copy of this entire AST, sharing its nodes.
   unique_ptr<AST> duplicate() const;
 
   /// Render the AST as a string: This is a relatively costly operation.
@@ -603,9 +681,9 @@ class AST {
   /// Move constructor.
   AST(AST &&ast) = default;
 
-  /// Copy constructor to stack a duplicate()—means one fewer alloc.
-  AST(const AST &ast, bool):
-      AST(ast.root ? ast.root->duplicate() : nullptr) {}
+  /// Copy constructor to stack a duplicate()—means one fewer alloc. The copy
+  /// shares the nodes of the original until either is changed.
+  AST(const AST &ast, bool);
 
   /// Construct with a root node; this should only be called internally.
   AST(unique_ptr<AST_Node> root);
@@ -670,6 +748,15 @@ class AST_Builder {
   **/
   unique_ptr<AST_Node> parse_unary_pre_or_literal(AST *ast,
                                                   jdi::token_t &token);
+  /** Fold an operator node whose operands are all constants into a single
+      \c AST_Node_Constant, so that it is not evaluated again each time the
+      expression is. Operands are constant if they are literals, folded nodes,
+      or definitions with known, non-dependent values.
+      @param  ast   The AST currently being built. [in-out]
+      @param  node  The operator node just built.
+      @return Returns the folded node, or the given node if it can't be folded.
+  **/
+  unique_ptr<AST_Node> fold(AST *ast, unique_ptr<AST_Node> node);
 
  public:
   /** Parse in an expression, building an AST, with scope information, starting with the given token.
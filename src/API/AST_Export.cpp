@@ -29,8 +29,10 @@ using std::max;
 namespace jdi {
 
 string AST::toString() const {
-  if (root) return root->toString();
-  return "";
+  if (!root) return "";
+  AST scratch;
+  return substituted(scratch, default_error_handler->at({
+      __FILE__ " @ AST::toString", __LINE__ + 1, 0})).root->toString();
 }
 
 /// A wrapper to \c SVG which helps generate IDs for each node.
@@ -296,8 +298,12 @@ int AST_Node_Definition::own_height() { return 24; }
     #endif
 
     svg.svg->write_header(w,h);
-    if (root)
-      root->toSVG(w/2, root->own_height()/2+4, &svg);
+    if (root) {
+      AST scratch;
+      const AST &ast = substituted(scratch, default_error_handler->at({
+          __FILE__ " @ AST::writeSVG", __LINE__ + 1, 0}));
+      ast.root->toSVG(w/2, ast.root->own_height()/2+4, &svg);
+    }
     #ifdef DEBUG_MODE
     svg.svg->draw_text("Expression",w/2,h-8,expression);
     #endif
@@ -0,0 +1,178 @@
+/**
+ * @file  AST_bytecode.cpp
+ * @brief Source compiling and running expression ASTs as linear programs.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "AST_bytecode.h"
+#include <API/AST.h>
+#include <Storage/value_funcs.h>
+
+#include <algorithm>
+
+namespace jdi {
+
+namespace {
+
+/// Evaluates a literal the way its node would, or returns no value if that
+/// would report anything.
+value literal_value(const AST_Node *node) {
+  struct Quiet: ErrorHandler {
+    bool reported = false;
+    void error(std::string_view, SourceLocation) final { reported = true; }
+    void warning(std::string_view, SourceLocation) final { reported = true; }
+    void info(std::string_view, int, SourceLocation) final {}
+  } quiet;
+  value res = node->eval(quiet.at({"", 0, 0}));
+  return quiet.reported ? value() : res;
+}
+
+}  // namespace
+
+std::unique_ptr<AST_Bytecode> AST_Bytecode::compile(const AST_Node *root) {
+  auto res = std::make_unique<AST_Bytecode>();
+  if (!root || !res->compile(root, 0)) return nullptr;
+  return res;
+}
+
+bool AST_Bytecode::compile(const AST_Node *node, size_t depth) {
+  if (!node) return false;
+  stack_size = std::max(stack_size, depth + 1);
+  switch (node->type) {
+    case AT_DECLITERAL: case AT_HEXLITERAL: case AT_OCTLITERAL:
+    case AT_CHRLITERAL: case AT_STRLITERAL: {
+      value v = literal_value(node);
+      if (v.type == VT_NONE) return false;
+      code.emplace_back(OP_CONSTANT, constants.size());
+      constants.push_back(v);
+      return true;
+    }
+    case AT_CONSTANT:
+      code.emplace_back(OP_CONSTANT, constants.size());
+      constants.push_back(((const AST_Node_Constant*) node)->val);
+      return true;
+    case AT_DEFINITION: {
+      definition *def = ((const AST_Node_Definition*) node)->def;
+      if (!def) return false;
+      auto it = std::find(inputs.begin(), inputs.end(), def);
+      code.emplace_back(OP_INPUT, it - inputs.begin());
+      if (it == inputs.end()) inputs.push_back(def);
+      return true;
+    }
+    case AT_UNARY_PREFIX: case AT_UNARY_POSTFIX: {
+      const AST_Node_Unary *un = (const AST_Node_Unary*) node;
+      if (!un->method || !compile(un->operand.get(), depth)) return false;
+      code.emplace_back(OP_UNARY);
+      code.back().unary = un->method;
+      return true;
+    }
+    case AT_BINARYOP: {
+      const AST_Node_Binary *bin = (const AST_Node_Binary*) node;
+      if (!bin->method || !compile(bin->left.get(), depth)) return false;
+      // The logical operators skip their right operand, as eval does.
+      size_t skip = code.size();
+      if (bin->method == values_booland) code.emplace_back(OP_AND);
+      else if (bin->method == values_boolor) code.emplace_back(OP_OR);
+      else skip = size_t(-1);
+      if (!compile(bin->right.get(), depth + 1)) return false;
+      code.emplace_back(OP_BINARY);
+      code.back().binary = bin->method;
+      if (skip != size_t(-1)) code[skip].arg = code.size();
+      return true;
+    }
+    case AT_TERNARYOP: {
+      const AST_Node_Ternary *ter = (const AST_Node_Ternary*) node;
+      if (!compile(ter->exp.get(), depth)) return false;
+      const size_t branch = code.size();
+      code.emplace_back(OP_BRANCH);
+      if (!compile(ter->left.get(), depth)) return false;
+      const size_t jump = code.size();
+      code.emplace_back(OP_JUMP);
+      code[branch].arg = code.size();
+      if (!compile(ter->right.get(), depth)) return false;
+      code[jump].arg = code[branch].end = code.size();
+      return true;
+    }
+    case AT_BINLITERAL: case AT_BOOLLITERAL: case AT_IDENTIFIER:
+    case AT_TEMPID: case AT_TYPE: case AT_ARRAY: case AT_SUBSCRIPT:
+    case AT_SCOPE: case AT_SIZEOF: case AT_CAST: case AT_PARAMLIST:
+    case AT_NEW: case AT_DELETE: case AT_INSTANTIATE: case AT_INSTBYKEY:
+    case AT_USERBEGIN: default:
+      return false;
+  }
+}
+
+value AST_Bytecode::run(const remap_set *substitutions,
+                        const ErrorContext &errc) const {
+  std::vector<value> stack;
+  stack.reserve(stack_size);
+  for (size_t pc = 0; pc < code.size(); ) {
+    const instruction &in = code[pc++];
+    switch (in.op) {
+      case OP_CONSTANT:
+        stack.push_back(constants[in.arg]);
+        break;
+      case OP_INPUT: {
+        const definition *def = inputs[in.arg];
+        if (substitutions) {
+          auto it = substitutions->find(def);
+          if (it != substitutions->end()) def = it->second;
+        }
+        if (def && (def->flags & DEF_VALUED)) {
+          stack.push_back(((const definition_valued*) def)->value_of);
+        } else if (def && (def->flags & DEF_TEMPPARAM)) {
+          stack.push_back(value(VT_DEPENDENT));
+        } else {
+          errc.error("Evaluating null definition");
+          stack.push_back(value());
+        }
+        break;
+      }
+      case OP_UNARY:
+        stack.back() = in.unary(stack.back());
+        break;
+      case OP_BINARY: {
+        value r = stack.back();
+        stack.pop_back();
+        stack.back() = in.binary(stack.back(), r);
+        break;
+      }
+      case OP_AND: case OP_OR: {
+        const value &l = stack.back();
+        if (l.is_number() || l.type == VT_STRING) {
+          if (in.op == OP_AND && !l) stack.back() = value(0L), pc = in.arg;
+          else if (in.op == OP_OR && l) stack.back() = value(1L), pc = in.arg;
+        }
+        break;
+      }
+      case OP_BRANCH: {
+        const value cond = stack.back();
+        stack.pop_back();
+        if (cond.type == VT_DEPENDENT) stack.push_back(cond), pc = in.end;
+        else if (!cond) pc = in.arg;
+        break;
+      }
+      case OP_JUMP: default:
+        pc = in.arg;
+        break;
+    }
+  }
+  return stack.empty() ? value() : stack.back();
+}
+
+}  // namespace jdi
@@ -0,0 +1,94 @@
+/**
+ * @file  AST_bytecode.h
+ * @brief Header declaring a compiled, linear form of an expression AST.
+ *
+ * ASTs kept in definitions, such as the default arguments of template
+ * parameters and dependent enum values, are evaluated again each time their
+ * template is instantiated. This form evaluates them with a short loop over
+ * a stack of values, rather than by recursive virtual calls over the tree.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _AST_BYTECODE__H
+#define _AST_BYTECODE__H
+
+#include <API/error_reporting.h>
+#include <Storage/definition_forward.h>
+#include <Storage/value.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jdi {
+
+struct AST_Node;
+
+/** An expression compiled into a linear program over a stack of values.
+    The definitions the expression reads, such as template parameters, are
+    its inputs; each is looked up when the program is run, so one program
+    serves every instantiation of a template.
+**/
+class AST_Bytecode {
+  enum Opcode: unsigned char {
+    OP_CONSTANT, ///< Push \c constants[arg].
+    OP_INPUT,    ///< Push the value of \c inputs[arg].
+    OP_UNARY,    ///< Replace the top value with the result of \c unary.
+    OP_BINARY,   ///< Replace the top two values with the result of \c binary.
+    OP_AND,      ///< If the top value is known false, make it 0 and jump to \c arg.
+    OP_OR,       ///< If the top value is known true, make it 1 and jump to \c arg.
+    OP_BRANCH,   ///< Pop a condition; jump to \c arg if false, or to \c end if dependent.
+    OP_JUMP      ///< Jump to \c arg.
+  };
+  struct instruction {
+    Opcode op;
+    uint32_t arg = 0; ///< Index of a constant or input, or a jump target.
+    uint32_t end = 0; ///< For \c OP_BRANCH, where a dependent condition goes.
+    union {
+      value (*unary)(const value&);
+      value (*binary)(const value&, const value&);
+    };
+    instruction(Opcode o, uint32_t a = 0): op(o), arg(a), unary(nullptr) {}
+  };
+
+  std::vector<instruction> code;       ///< The program, run in order.
+  std::vector<value> constants;        ///< Literals used by the program.
+  std::vector<definition*> inputs;     ///< Definitions read by the program.
+  size_t stack_size = 0;               ///< The most values the program stacks.
+
+  /// Append code evaluating the given node; returns false if it can't be
+  /// compiled. \p depth is the number of values stacked beneath its result.
+  bool compile(const AST_Node *node, size_t depth);
+
+ public:
+  /// Compile the tree with the given root. Returns null if the tree holds
+  /// anything which can't be compiled, such as casts, calls or sizeof.
+  static std::unique_ptr<AST_Bytecode> compile(const AST_Node *root);
+
+  /// Run the program, as \c AST::eval would evaluate the tree. If given,
+  /// each input is first replaced as by \c AST::remap with \p substitutions.
+  value run(const remap_set *substitutions, const ErrorContext &errc) const;
+
+  /// Returns the definitions the program reads; these are all the
+  /// definitions named in the tree it was compiled from.
+  const std::vector<definition*> &names() const { return inputs; }
+};
+
+}  // namespace jdi
+
+#endif  // _AST_BYTECODE__H
@@ -43,6 +43,7 @@ namespace jdi {
     virtual void operate_Subscript(AST_Node_Subscript* x, void *param) = 0;
     virtual void operate_TempInst(AST_Node_TempInst* x, void *param) = 0;
     virtual void operate_TempKeyInst(AST_Node_TempKeyInst* x, void *param) = 0;
+    virtual void operate_Constant(AST_Node_Constant* x, void *param) = 0;
     virtual ~ASTOperator();
   };
 
@@ -63,6 +64,7 @@ namespace jdi {
     virtual void operate_Subscript(const AST_Node_Subscript* x, void *param) = 0;
     virtual void operate_TempInst(const AST_Node_TempInst* x, void *param) = 0;
     virtual void operate_TempKeyInst(const AST_Node_TempKeyInst* x, void *param) = 0;
+    virtual void operate_Constant(const AST_Node_Constant* x, void *param) = 0;
     virtual ~ConstASTOperator();
   };
 }
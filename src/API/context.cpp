@@ -25,6 +25,8 @@
 #include <string>
 #include <fstream>
 #include <cstring>
+#include <atomic>
+#include <thread>
 using namespace std;
 
 #include "context.h"
@@ -141,6 +143,13 @@ static definition* find_mirror(definition *x, definition_scope* root) {
   return root;
 }
 
+/// Shares the base's macros; they are immutable, so a redefinition in either
+/// context simply replaces that context's pointer.
+static void share_macros(macro_map &dest, const macro_map &src) {
+  for (macro_iter_c mi = src.begin(); mi != src.end(); ++mi)
+    dest.insert(*mi);
+}
+
 void Context::reset()
 {
 
@@ -152,27 +161,32 @@ void Context::reset_all()
 void Context::copy(const Context &ct)
 {
   remap_set n;
-  ct.global->copy(global.get(), n);
-  ct.global->remap(n, ErrorContext(herr, {"Internal Copy Operation", 0, 0}));
+  global->copy(ct.global.get(), n);
+  global->remap(n, ErrorContext(herr, {"Internal Copy Operation", 0, 0}));
 
-  for (macro_iter_c mi = ct.macros.begin(); mi != ct.macros.end(); ++mi){
-    pair<macro_iter,bool> dest = macros.insert(pair<string,macro_type*>(mi->first,nullptr));
-    if (dest.second) {
-      dest.first->second = new_macro(*mi->second);
-    }
-  }
+  share_macros(macros, ct.macros);
   for (definition* var : ct.variadics) {
-    if (var->parent)
+    if (var->parent && ct.owns(var))
       variadics.insert(find_mirror(var, global.get()));
     else
       variadics.insert(var);
   }
 }
+bool Context::owns(const definition *def) const {
+  if (!def) return false;
+  while (def->parent) def = def->parent;
+  return def == global.get();
+}
 void Context::swap(Context &ct) {
   if (!parse_open and !ct.parse_open) {
     ct.global.swap(global);
+    mapping.swap(ct.mapping);
+    std::swap(base, ct.base);
+    std::swap(frozen, ct.frozen);
+    instances.swap(ct.instances);
     macros.swap(ct.macros);
     variadics.swap(ct.variadics);
+    included_files.swap(ct.included_files);
   } else {
     herr->error({"Internal Swap Operation", 0, 0})
         << "ERROR! Cannot swap context while parse is active!";
@@ -267,11 +281,103 @@ void Context::output_definitions(ostream &out) {
   out << global->toString();
 }
 
-Context::Context(ErrorHandler *herr_):
-    parse_open(false), global(new definition_scope()), herr(herr_) {
-  copy(builtin_context());
+void Context::freeze() {
+  if (frozen) return;
+  // Anything instantiated from a frozen base along the way is ours to keep.
+  frozen_instantiations::use use_ours(*instances);
+  // Materializing one instantiation may instantiate more, so sweep until no
+  // work remains. The bound is the same as our nested instantiation limit.
+  for (int sweep = 0; sweep < 128; ++sweep) {
+    bool changed = global->freeze(false);
+    changed |= instances->freeze(false);
+    if (!changed) break;
+  }
+  global->freeze(true);
+  instances->freeze(true);
+  frozen = true;
+}
+
+/// Returns the builtin context, frozen so that others may be layered over it.
+static const Context &frozen_builtins() {
+  Context &builtin = builtin_context();
+  builtin.freeze();
+  return builtin;
+}
+
+Context::Context(ErrorHandler *herr_): Context(frozen_builtins(), herr_) {}
+Context::Context(const Context &base_, ErrorHandler *herr_):
+    parse_open(false), frozen(false), instances(new frozen_instantiations()),
+    global(new definition_scope()), base(&base_),
+    herr(herr_), variadics(base_.variadics) {
+  if (!base_.frozen) {
+    cerr << "Cannot layer a context over one which is not frozen." << endl;
+    abort();
+  }
+  global->use_namespace(base_.global.get());
+  instances->base = base_.instances.get();
+  share_macros(macros, base_.macros);
+}
+Context::Context(const Context &other):
+    parse_open(false), frozen(false), instances(new frozen_instantiations()),
+    global(new definition_scope()), base(other.base),
+    herr(other.herr) {
+  copy(other);
 }
-Context::Context(int): parse_open(false), global(new definition_scope()) { }
+Context::Context(int):
+    parse_open(false), frozen(false), instances(new frozen_instantiations()),
+    global(new definition_scope()), base(nullptr),
+    herr(default_error_handler) {}
 
-size_t Context::search_dir_count() const { return search_directories.size(); }
-string Context::search_dir(size_t index) const { return search_directories[index]; }
+Context::~Context() = default;
+
+size_t Context::search_dir_count() const {
+  return search_directories.size() + (base ? base->search_dir_count() : 0);
+}
+string Context::search_dir(size_t index) const {
+  if (index < search_directories.size()) return search_directories[index];
+  return base->search_dir(index - search_directories.size());
+}
+
+ParsedFiles jdi::parse_files(const vector<std::filesystem::path> &paths,
+                             unsigned n_threads, ErrorHandler *herr, bool merge,
+                             Context *base) {
+  Context &over = base? *base : builtin_context();
+  over.freeze();
+
+  ParsedFiles res;
+  res.contexts.resize(paths.size());
+  if (!n_threads)
+    n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  n_threads = std::min<size_t>(n_threads, paths.size());
+
+  // Workers claim the next unparsed file until none remain.
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t i; (i = next++) < paths.size(); ) {
+      res.contexts[i] = std::make_unique<Context>(over, herr);
+      llreader file(paths[i]);
+      if (!file.is_open()) {
+        herr->error({paths[i].string(), SourceLocation::npos, SourceLocation::npos})
+            << "Could not open file for parsing";
+        continue;
+      }
+      res.contexts[i]->parse_stream(file);
+    }
+  };
+  vector<std::thread> workers;
+  for (unsigned i = 1; i < n_threads; ++i)
+    workers.emplace_back(work);
+  work();
+  for (std::thread &worker : workers)
+    worker.join();
+
+  if (merge) {
+    res.merged = std::make_unique<Context>(over, herr);
+    for (const unique_ptr<Context> &ct : res.contexts) {
+      res.merged->global->use_namespace(ct->global.get());
+      share_macros(res.merged->macros, ct->macros);
+      res.merged->variadics.insert(ct->variadics.begin(), ct->variadics.end());
+    }
+  }
+  return res;
+}
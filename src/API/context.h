@@ -43,6 +43,9 @@
 namespace jdi {
 class Context;
 class context_parser;
+class frozen_instantiations;
+class mapped_context;
+struct ParsedFiles;
 }
 
 #include <System/macros.h>
@@ -51,6 +54,9 @@ class context_parser;
 #include <General/llreader.h>
 #include <System/token.h>
 #include <API/error_reporting.h>
+#include <API/declaration_observer.h>
+#include <API/parse_stats.h>
+#include <API/parse_trace.h>
 
 namespace jdi {
 
@@ -77,6 +83,9 @@ of parsed source code on separate bases.
 **/
 class Context {
   bool parse_open; ///< True if we're already parsing something
+  friend ParsedFiles parse_files(const vector<std::filesystem::path>&, unsigned,
+                                 ErrorHandler*, bool, Context*);
+  bool frozen; ///< True once freeze() has been called; see there.
   friend class jdi::AST;
   friend class jdi::context_parser;
 
@@ -84,15 +93,37 @@ class Context {
   macro_map macros; ///< A map of macros defined in this context.
   /// A list of #include directories in the order they will be searched.
   vector<string> search_directories;
+  /// The file given to \c load_mapped(), from which scopes are read as they
+  /// are searched. Declared ahead of \c global, which refers into it.
+  shared_ptr<mapped_context> mapping;
+  /// Instantiations of frozen templates made while parsing into this context.
+  unique_ptr<frozen_instantiations> instances;
   /// The global scope represented in this context.
   unique_ptr<definition_scope> global;
+  /// The context this one is layered over, if any. Its global scope is used
+  /// by ours, read-only; declarations made here only ever land in ours.
+  const Context *base;
+  /// Files opened by \c #include while parsing into this context.
+  set<string> included_files;
 
   ErrorHandler *herr;
+  /// Told of each declaration as it is parsed into this context, if set.
+  DeclarationObserver *observer = nullptr;
+  /// Decides which declarations parsing into this context keeps, if set.
+  const DeclarationFilter *filter = nullptr;
+  /// Filled with timings and counts by each parse into this context, if set.
+  ParseStats *stats = nullptr;
+  /// Given a span for each file, declaration and instantiation parsed into
+  /// this context, if set.
+  ParseTrace *trace = nullptr;
+
+  /// Implements \c load() and \c load_mapped().
+  int read_saved(const std::filesystem::path &path, bool lazy);
 
  public:
   set<definition*> variadics; ///< Set of variadic types.
 
-  size_t search_dir_count() const; ///< Return the number of search directories
+  size_t search_dir_count() const; ///< Return the number of search directories, counting those of our bases after ours
   string search_dir(size_t index) const; ///< Return the search directory with the given index, in [0, search_dir_count).
 
   /** Add a type name to this context
@@ -153,6 +184,28 @@ class Context {
   void set_error_handler(ErrorHandler *herr_) {
     herr = herr_;
   }
+  /** Sets an observer to be told of each declaration as it is parsed into
+      this context, or null to stop telling one. See \c DeclarationObserver. */
+  void set_observer(DeclarationObserver *observer_) {
+    observer = observer_;
+  }
+  /** Sets rules choosing which declarations parsing into this context keeps,
+      or null to keep everything. See \c DeclarationFilter. The filter must
+      outlive any parse it is used by. */
+  void set_filter(const DeclarationFilter *filter_) {
+    filter = filter_;
+  }
+  /** Sets statistics to be added to by each parse into this context, or null
+      to stop collecting them. See \c ParseStats. Collection costs a clock
+      read on each change of phase, so leave this unset when not measuring. */
+  void set_stats(ParseStats *stats_) {
+    stats = stats_;
+  }
+  /** Sets a trace to be given the timeline of each parse into this context,
+      or null to stop tracing. See \c ParseTrace. */
+  void set_trace(ParseTrace *trace_) {
+    trace = trace_;
+  }
 
   void output_types(ostream &out = cout); ///< Print a list of scoped-in types.
   void output_macro(string macroname, ostream &out = cout); ///< Print a single macro to a given stream.
@@ -166,6 +219,65 @@ class Context {
   inline const macro_map& get_macros() const { return macros; }
   /// Get our global scope
   inline definition_scope* get_global() const { return global.get(); }
+  /// Get the context this one is layered over, or null if it stands alone.
+  inline const Context *get_base() const { return base; }
+  /// Get the names of the files opened by \c #include while parsing into
+  /// this context, as they were found in the search directories.
+  inline const set<string> &get_included_files() const {
+    return included_files;
+  }
+  /** Returns whether the given definition is stored in this context, as
+      opposed to a context it is layered over. Definitions in the latter
+      must be treated as read-only. */
+  bool owns(const definition *def) const;
+
+  /** Make the definitions in this context immutable, so that they may be
+      read from any number of threads at once without locking. Anything that
+      would be built lazily on lookup, such as the members of template
+      instantiations, is built now. After this call, \c look_up, \c find_local,
+      \c toString, and \c eval and \c coerce on stored ASTs are safe to call
+      concurrently; template instantiations the context lacks are filed in the
+      \c frozen_instantiations store of the thread which asks for them.
+      The context can no longer be parsed into, but other contexts may be
+      layered over it.
+      The base context, if any, should be frozen first.
+  **/
+  void freeze();
+  /// Returns whether \c freeze() has been called on this context.
+  inline bool is_frozen() const { return frozen; }
+
+  /** Write the definitions, macros, and search directories of this context to
+      a file, in a compact binary form which \c load() reads back far faster
+      than the sources could be parsed again. Anything that would be built
+      lazily on lookup is built first, as by \c freeze().
+      Definitions this context refers to in its base are written by name, or
+      by template arguments for instantiations, to be looked up again in the
+      base of the context loading them.
+      @param path  The file to write.
+      @return Zero on success, or nonzero after reporting an error.
+  **/
+  int save(const std::filesystem::path &path);
+  /** Read a file written by \c save() into this context, replacing its global
+      scope and adding to its macros and search directories. This context
+      should be layered over the same base as the one which was saved, and
+      must not be frozen.
+      @param path  The file to read.
+      @return Zero on success, or nonzero after reporting an error, in which
+              case this context is left as it was.
+  **/
+  int load(const std::filesystem::path &path);
+  /** As \c load(), but maps the file into memory and leaves the members of
+      each scope in it until that scope is first searched, so that a context
+      saved from a large set of headers opens at once and costs memory only
+      for what is looked up. The file must not change while this context is
+      in use. Lookups read it in, so this context is not safe to search from
+      several threads until it is frozen, which reads it all.
+      @param path  The file to map.
+      @return Zero on success, or nonzero after reporting an error, in which
+              case this context is left as it was. Errors in the part of the
+              file read later are reported as they are found.
+  **/
+  int load_mapped(const std::filesystem::path &path);
 
   /// Get a non-const reference to the global macro set.
   static macro_map &global_macros();
@@ -181,12 +293,28 @@ class Context {
   int parse_stream(llreader& cfile);
 
   /** Default constructor; allocates a global context with built-in definitions.
-      Definitions are copied into the new context from the \c builtin context.
+      The new context is layered over the \c builtin context, so construction
+      costs nothing in proportion to what the builtin context contains.
+      The builtin context is frozen first, if it is not already; definitions
+      can no longer be parsed into it after that, though macros and search
+      directories may still be added.
       You may specify an error handler to use in this constructor, or you may
       assign one later using `set_error_handler(herr)`.
   **/
   Context(ErrorHandler *herr = default_error_handler);
 
+  /** Construct a context layered over another. Definitions in the base context
+      are visible here but are never modified; new declarations, including the
+      reopening of the base's namespaces, are made in an overlay owned by this
+      context. Macros are shared with the base until redefined here, and the
+      base's search directories are searched after any added here.
+      The base context must be frozen, and must outlive this one. Functions
+      declared here which hide functions of the base keep the base overloads.
+      @param base  The context to build on.
+      @param herr  The error handler to use when parsing into this context.
+  **/
+  Context(const Context &base, ErrorHandler *herr);
+
 
   /** Construct with essentially nothing. This constructor circumvents the copy process. It has
       no purpose other than and is not to be used except in allocating the builtin scope.
@@ -210,9 +338,40 @@ class Context {
   Context(const Context&);
 
   /** A simple destructor to clean up after the definition loading. **/
-  ~Context() = default;
+  ~Context();
 };
 
+/// The contexts produced by \c parse_files.
+struct ParsedFiles {
+  /// One context per input file, in input order, each layered over the base.
+  vector<unique_ptr<Context>> contexts;
+  /// If requested, a context layered over the base which also uses the global
+  /// scope and macros of each of the above. Where inputs declare the same
+  /// name, the first input's declaration is found.
+  unique_ptr<Context> merged;
+};
+
+/** Parse independent files in parallel, each into its own context.
+    Each worker thread runs its own lexer and parser; all of them share the
+    base context, which is frozen first so that they may read it without
+    locking (see \c Context::freeze()). Finish populating the base, including
+    its macros and search directories, before calling this.
+    @param paths      The files to parse.
+    @param n_threads  The number of worker threads to use, or zero to use one
+                      per hardware thread.
+    @param herr       The error handler given to each context. It is called
+                      from several threads at once; the default handler is
+                      safe to use this way.
+    @param merge      Whether to also build \c ParsedFiles::merged.
+    @param base       The context to parse each file over, or null to use the
+                      builtin context.
+    @return One context per input; see \c ParsedFiles.
+**/
+ParsedFiles parse_files(const vector<std::filesystem::path> &paths,
+                        unsigned n_threads = 0,
+                        ErrorHandler *herr = default_error_handler,
+                        bool merge = false, Context *base = nullptr);
+
 }
 
 #endif
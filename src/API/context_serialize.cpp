@@ -0,0 +1,1518 @@
+/**
+ * @file  context_serialize.cpp
+ * @brief Source implementing saving contexts to disk and loading them back.
+ *
+ * A saved context begins with a magic number and format version, followed by
+ * a header of fixed-width offsets to the tables below. Integers are otherwise
+ * written as varints. Strings are interned into one table at the end of the
+ * file and written by index. Definitions are numbered in the order the
+ * ownership tree is walked, starting from the global scope; pointers between
+ * them are written as those numbers, and each number indexes a table of
+ * offsets to the records which describe them. After the definitions come the
+ * search directories, macros, and variadics of the context.
+ *
+ * Each record can thus be read on its own. A definition is allocated as an
+ * empty shell when its number is first read, so that the pointer can be fixed
+ * up at once, and is filled in from its record afterward. The members of a
+ * scope are written last in its record, behind their length in bytes, so that
+ * a mapped context can skip them until the scope is first searched.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "context.h"
+#include <API/AST_operator.h>
+#include <System/builtins.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+using namespace jdi;
+
+namespace {
+
+constexpr char kMagic[4] = {'J', 'D', 'I', 'C'};
+/// Bump this whenever the layout below changes.
+constexpr unsigned kFormatVersion = 4;
+
+/// The fixed-width fields following the format version, each an offset into
+/// the file or a count.
+enum HeaderField {
+  HF_DEF_COUNT,     ///< The number of definitions saved.
+  HF_DEF_INDEX,     ///< The table of offsets to each definition's record.
+  HF_STRING_COUNT,  ///< The number of strings saved.
+  HF_STRING_INDEX,  ///< The table of offsets to each string, plus its end.
+  HF_PREAMBLE,      ///< Search directories, macros, and variadics.
+  HF_COUNT
+};
+constexpr size_t kFieldSize = 8;
+
+/// The most-derived kind of a definition, which decides what is written.
+enum DefTag {
+  TAG_DEFINITION, TAG_TYPED, TAG_OVERLOAD, TAG_VALUED, TAG_FUNCTION,
+  TAG_SCOPE, TAG_CLASS, TAG_UNION, TAG_ENUM, TAG_TEMPLATE, TAG_TEMPPARAM,
+  TAG_ATOMIC, TAG_HYPOTHETICAL, TAG_COUNT
+};
+
+/// How a pointer to a definition was written.
+enum RefKind {
+  REF_NULL,        ///< A null pointer.
+  REF_OWNED,       ///< One of the saved definitions, by number.
+  REF_ABSTRACT,    ///< The \c arg_key::abstract sentinel.
+  REF_BASE_GLOBAL, ///< The global scope of the base context.
+  REF_PRIMITIVE,   ///< A builtin primitive type, by name.
+  REF_MEMBER,      ///< A member of some other scope, by name.
+  REF_C_STRUCT,    ///< A C struct of some other scope, by name.
+  REF_INSTANCE,    ///< An instantiation of a template, by arguments.
+  REF_LOST         ///< Something which can't be found again; read as null.
+};
+
+/// Which kind of AST node was written.
+enum NodeTag {
+  NODE_NULL, NODE_PLAIN, NODE_DEFINITION, NODE_SCOPE, NODE_TYPE, NODE_UNARY,
+  NODE_SIZEOF, NODE_CAST, NODE_BINARY, NODE_TERNARY, NODE_PARAMETERS,
+  NODE_ARRAY, NODE_NEW, NODE_DELETE, NODE_SUBSCRIPT, NODE_TEMPINST,
+  NODE_TEMPKEYINST, NODE_CONSTANT
+};
+
+DefTag tag_of(const definition *d) {
+  // Most derived first; tempparams and hypotheticals are also classes.
+  if (dynamic_cast<const definition_hypothetical*>(d)) return TAG_HYPOTHETICAL;
+  if (dynamic_cast<const definition_tempparam*>(d))    return TAG_TEMPPARAM;
+  if (dynamic_cast<const definition_enum*>(d))         return TAG_ENUM;
+  if (dynamic_cast<const definition_class*>(d))        return TAG_CLASS;
+  if (dynamic_cast<const definition_union*>(d))        return TAG_UNION;
+  if (dynamic_cast<const definition_template*>(d))     return TAG_TEMPLATE;
+  if (dynamic_cast<const definition_atomic*>(d))       return TAG_ATOMIC;
+  if (dynamic_cast<const definition_scope*>(d))        return TAG_SCOPE;
+  if (dynamic_cast<const definition_function*>(d))     return TAG_FUNCTION;
+  if (dynamic_cast<const definition_overload*>(d))     return TAG_OVERLOAD;
+  if (dynamic_cast<const definition_valued*>(d))       return TAG_VALUED;
+  if (dynamic_cast<const definition_typed*>(d))        return TAG_TYPED;
+  return TAG_DEFINITION;
+}
+
+/// Returns whether an expression node saved with the given tag and type can
+/// be read as the node the tag builds, which has the given type. Code
+/// elsewhere casts nodes by their type.
+bool fits_node(unsigned tag, AST_TYPE saved, AST_TYPE built) {
+  switch (tag) {
+    case NODE_PLAIN:
+      return saved >= AT_DECLITERAL && saved <= AT_TEMPID;
+    case NODE_UNARY:
+      return saved == AT_UNARY_PREFIX || saved == AT_UNARY_POSTFIX;
+    case NODE_BINARY:
+      return saved == AT_BINARYOP;
+    default:
+      return saved == built;
+  }
+}
+
+/// Returns whether the given definition is of the kind the given flags
+/// claim; code everywhere else casts by these flags.
+bool fits_flags(const definition *d, unsigned flags) {
+  if ((flags & DEF_SCOPE) && !dynamic_cast<const definition_scope*>(d))
+    return false;
+  if ((flags & DEF_CLASS) && !dynamic_cast<const definition_class*>(d))
+    return false;
+  if ((flags & DEF_ENUM) && !dynamic_cast<const definition_enum*>(d))
+    return false;
+  if ((flags & DEF_UNION) && !dynamic_cast<const definition_union*>(d))
+    return false;
+  if ((flags & DEF_TYPED) && !dynamic_cast<const definition_typed*>(d)
+                          && !dynamic_cast<const definition_function*>(d))
+    return false;
+  if ((flags & DEF_FUNCTION) && !dynamic_cast<const definition_function*>(d))
+    return false;
+  if ((flags & DEF_OVERLOAD) && !dynamic_cast<const definition_overload*>(d))
+    return false;
+  if ((flags & DEF_VALUED) && !dynamic_cast<const definition_valued*>(d))
+    return false;
+  if ((flags & DEF_TEMPLATE) && !dynamic_cast<const definition_template*>(d))
+    return false;
+  if ((flags & DEF_TEMPPARAM) && !dynamic_cast<const definition_tempparam*>(d))
+    return false;
+  if ((flags & DEF_HYPOTHETICAL) &&
+      !dynamic_cast<const definition_hypothetical*>(d))
+    return false;
+  if ((flags & DEF_ATOMIC) && !dynamic_cast<const definition_atomic*>(d))
+    return false;
+  return true;
+}
+
+bool is_typed(unsigned tag) {
+  return tag == TAG_TYPED || tag == TAG_OVERLOAD || tag == TAG_VALUED;
+}
+bool is_scope(unsigned tag) {
+  return tag >= TAG_SCOPE && tag < TAG_COUNT;
+}
+bool is_class(unsigned tag) {
+  return tag == TAG_CLASS || tag == TAG_ENUM || tag == TAG_TEMPPARAM
+      || tag == TAG_HYPOTHETICAL;
+}
+
+//==============================================================================
+//===: Writing :================================================================
+//==============================================================================
+
+class ContextWriter: public ConstASTOperator {
+  string out;
+  size_t header_at;
+  map<string, size_t, std::less<>> strings;
+  vector<string_view> string_order;
+  map<const definition*, size_t> ids;
+  vector<const definition*> order;
+  vector<DefTag> tags;
+  const frozen_instantiations *store;
+  const Context *base;
+
+ public:
+  ContextWriter(const frozen_instantiations *st, const Context *b):
+      store(st), base(b) {
+    out.append(kMagic, sizeof kMagic);
+    u(kFormatVersion);
+    header_at = out.size();
+    out.append(HF_COUNT * kFieldSize, '\0');
+  }
+  const string &data() const { return out; }
+
+  void fixed(unsigned long long v) {
+    for (size_t i = 0; i < kFieldSize; ++i, v >>= 8) out += char(v & 0xFF);
+  }
+  void patch(HeaderField field, unsigned long long v) {
+    for (size_t i = 0; i < kFieldSize; ++i, v >>= 8)
+      out[header_at + field * kFieldSize + i] = char(v & 0xFF);
+  }
+  /// Point the given header field at what is written next.
+  void mark(HeaderField field) { patch(field, out.size()); }
+
+  void u(unsigned long long v) {
+    do {
+      unsigned char b = v & 0x7F;
+      if (v >>= 7) b |= 0x80;
+      out += char(b);
+    } while (v);
+  }
+  void s(long long v) {
+    u((static_cast<unsigned long long>(v) << 1) ^ (v < 0 ? ~0ULL : 0ULL));
+  }
+  void str(string_view sv) {
+    auto it = strings.find(sv);
+    if (it == strings.end()) {
+      it = strings.emplace(string(sv), strings.size()).first;
+      string_order.push_back(it->first);
+    }
+    u(it->second);
+  }
+  /// Write the string table; this must come last.
+  void finish() {
+    vector<size_t> offsets;
+    for (string_view sv : string_order) {
+      offsets.push_back(out.size());
+      out.append(sv);
+    }
+    offsets.push_back(out.size());
+    patch(HF_STRING_COUNT, string_order.size());
+    mark(HF_STRING_INDEX);
+    for (size_t off : offsets) fixed(off);
+  }
+
+  void val(const value &v) {
+    u(v.type);
+    if (v.type == VT_STRING) return str(*v.str);
+    if (v.type == VT_INTEGER) {
+      u(v.is_unsigned);
+      s(v.integer);
+    } else if (v.type == VT_DOUBLE) {
+      char buf[64];
+      snprintf(buf, sizeof buf, "%a", v.real);
+      str(buf);
+    }
+  }
+
+  /// Number the given definition and everything it owns, in tree order.
+  void enumerate(const definition *d) {
+    if (!d || !ids.emplace(d, order.size()).second) return;
+    const DefTag tag = tag_of(d);
+    order.push_back(d);
+    tags.push_back(tag);
+    if (tag == TAG_FUNCTION) {
+      auto *f = (const definition_function*) d;
+      for (const auto &o : f->overloads) enumerate(o.second.get());
+      for (const auto &t : f->template_overloads) enumerate(t.get());
+    }
+    if (is_scope(tag)) {
+      auto *sc = (const definition_scope*) d;
+      for (const auto &m : sc->members) enumerate(m.second.get());
+      for (const auto &m : sc->c_structs) enumerate(m.second.get());
+    }
+    if (tag == TAG_TEMPLATE) {
+      auto *t = (const definition_template*) d;
+      enumerate(t->def.get());
+      for (const auto &p : t->params) enumerate(p.get());
+      for (const auto &sp : t->specializations) enumerate(sp->spec_temp.get());
+      for (const auto &in : t->instantiations) {
+        if (!in.second) continue;
+        enumerate(in.second->def.get());
+        for (const auto &pd : in.second->parameter_defs) enumerate(pd.get());
+      }
+      for (const auto &dep : t->dependents) enumerate(dep.get());
+    }
+  }
+
+  /// Write a pointer to a definition saved alongside this one.
+  void owned(const definition *d) {
+    if (!d) return u(0);
+    u(ids.at(d) + 1);
+  }
+
+  /// Find the arguments with which the given definition was instantiated from
+  /// the given template, if it was.
+  const arg_key *instance_key(const definition_template *temp,
+                              const definition *d) const {
+    for (const auto &in : temp->instantiations)
+      if (in.second && in.second->def.get() == d) return &in.first;
+    return store ? store->key_of(temp, d) : nullptr;
+  }
+
+  /// Write a pointer to any definition.
+  void ref(const definition *d) {
+    if (!d) return u(REF_NULL);
+    auto id = ids.find(d);
+    if (id != ids.end()) {
+      u(REF_OWNED);
+      return u(id->second);
+    }
+    if (d == arg_key::abstract) return u(REF_ABSTRACT);
+    if (!d->parent) {
+      auto prim = builtin_primitives.find(d->name);
+      if (prim != builtin_primitives.end() && prim->second == d) {
+        u(REF_PRIMITIVE);
+        return str(d->name);
+      }
+      for (const Context *b = base; b; b = b->get_base())
+        if (d == b->get_global()) return u(REF_BASE_GLOBAL);
+      u(REF_LOST);
+      return str(d->name);
+    }
+
+    if (auto *cls = dynamic_cast<const definition_class*>(d)) {
+      if (const definition_template *temp = cls->instance_of) {
+        const definition_template *from = temp;
+        const arg_key *key = instance_key(temp, d);
+        for (size_t i = 0; !key && i < temp->specializations.size(); ++i) {
+          from = temp->specializations[i]->spec_temp.get();
+          key = instance_key(from, d);
+        }
+        if (key) {
+          u(REF_INSTANCE);
+          ref(from);
+          return arguments(*key);
+        }
+      }
+    }
+
+    definition_scope *p = d->parent;
+    p->undefer();
+    auto cs = p->c_structs.find(d->name);
+    if (cs != p->c_structs.end() && cs->second.get() == d) {
+      u(REF_C_STRUCT);
+      ref(p);
+      return str(d->name);
+    }
+    auto m = p->members.find(d->name);
+    if (m != p->members.end() && m->second.get() == d) {
+      u(REF_MEMBER);
+      ref(p);
+      return str(d->name);
+    }
+    u(REF_LOST);
+    str(d->qualified_id());
+  }
+
+  void refs(const ref_stack &rs) {
+    str(rs.name);
+    ref(rs.ndef);
+    u(rs.size());
+    for (ref_stack::iterator it = rs.begin(); it; ++it) {
+      u(it->type);
+      if (it->type == ref_stack::RT_ARRAYBOUND) {
+        // The unbounded marker, size_t(-1), wraps around to zero.
+        u(((const ref_stack::node_array*) *it)->bound + 1);
+      } else if (it->type == ref_stack::RT_FUNCTION) {
+        const auto &params = ((const ref_stack::node_func*) *it)->params;
+        u(params.size());
+        for (size_t i = 0; i < params.size(); ++i) {
+          const ref_stack::parameter &param = params[i];
+          type(param);
+          u(param.variadic);
+          ast(param.default_value);
+        }
+      } else if (it->type == ref_stack::RT_MEMBER_POINTER) {
+        ref(((const ref_stack::node_memptr*) *it)->member_of);
+      }
+    }
+  }
+
+  void type(const full_type &ft) {
+    ref(ft.def);
+    refs(ft.refs);
+    u(ft.flags);
+  }
+
+  void arguments(const arg_key &key) {
+    u(key.size());
+    for (const arg_key::node &n : key) {
+      u(n.type);
+      if (n.type == arg_key::AKT_FULLTYPE) {
+        type(n.ft());
+      } else if (n.type == arg_key::AKT_VALUE) {
+        val(n.val());
+        ast(n.av().ast.get());
+      }
+    }
+  }
+
+  void ast(const AST *a) {
+    if (!a || a->empty()) return u(NODE_NULL);
+    a->operate(this, nullptr);
+  }
+  void node(const AST_Node *n) {
+    if (!n) return u(NODE_NULL);
+    n->operate(this, nullptr);
+  }
+  void header(NodeTag tag, const AST_Node *n) {
+    u(tag);
+    u(n->type);
+    str(n->content);
+    #ifndef NO_ERROR_REPORTING
+      str(FileTable::name_of(n->file));
+      s(n->linenum);
+      #ifndef NO_ERROR_POSITION
+        s(n->pos);
+      #else
+        s(0);
+      #endif
+    #else
+      str("");
+      s(0);
+      s(0);
+    #endif
+  }
+
+  void operate(const AST_Node *n, void*) override { header(NODE_PLAIN, n); }
+  void operate_Definition(const AST_Node_Definition *n, void*) override {
+    header(NODE_DEFINITION, n);
+    ref(n->def);
+  }
+  void operate_Scope(const AST_Node_Scope *n, void*) override {
+    header(NODE_SCOPE, n);
+    node(n->left.get());
+    node(n->right.get());
+  }
+  void operate_Type(const AST_Node_Type *n, void*) override {
+    header(NODE_TYPE, n);
+    type(n->dec_type);
+  }
+  void operate_Unary(const AST_Node_Unary *n, void*) override {
+    header(NODE_UNARY, n);
+    u(n->prefix);
+    node(n->operand.get());
+  }
+  void operate_sizeof(const AST_Node_sizeof *n, void*) override {
+    header(NODE_SIZEOF, n);
+    u(n->negate);
+    node(n->operand.get());
+  }
+  void operate_Cast(const AST_Node_Cast *n, void*) override {
+    header(NODE_CAST, n);
+    u(n->cast_mode);
+    type(n->cast_type);
+    node(n->operand.get());
+  }
+  void operate_Binary(const AST_Node_Binary *n, void*) override {
+    header(NODE_BINARY, n);
+    node(n->left.get());
+    node(n->right.get());
+  }
+  void operate_Ternary(const AST_Node_Ternary *n, void*) override {
+    header(NODE_TERNARY, n);
+    node(n->exp.get());
+    node(n->left.get());
+    node(n->right.get());
+  }
+  void operate_Parameters(const AST_Node_Parameters *n, void*) override {
+    header(NODE_PARAMETERS, n);
+    node(n->func.get());
+    u(n->params.size());
+    for (const auto &p : n->params) node(p.get());
+  }
+  void operate_Array(const AST_Node_Array *n, void*) override {
+    header(NODE_ARRAY, n);
+    u(n->elements.size());
+    for (const auto &e : n->elements) node(e.get());
+  }
+  void operate_new(const AST_Node_new *n, void*) override {
+    header(NODE_NEW, n);
+    type(n->alloc_type);
+    node(n->position.get());
+    node(n->bound.get());
+  }
+  void operate_delete(const AST_Node_delete *n, void*) override {
+    header(NODE_DELETE, n);
+    u(n->array);
+    node(n->operand.get());
+  }
+  void operate_Subscript(const AST_Node_Subscript *n, void*) override {
+    header(NODE_SUBSCRIPT, n);
+    node(n->left.get());
+    node(n->index.get());
+  }
+  void operate_TempInst(const AST_Node_TempInst *n, void*) override {
+    header(NODE_TEMPINST, n);
+    node(n->temp.get());
+    u(n->params.size());
+    for (const auto &p : n->params) node(p.get());
+  }
+  void operate_TempKeyInst(const AST_Node_TempKeyInst *n, void*) override {
+    header(NODE_TEMPKEYINST, n);
+    ref(n->temp);
+    arguments(n->key);
+  }
+  void operate_Constant(const AST_Node_Constant *n, void*) override {
+    header(NODE_CONSTANT, n);
+    val(n->val);
+    type(n->val_type);
+  }
+
+  void macro(const macro_type &m) {
+    str(m.name);
+    u(m.is_function);
+    u(m.is_variadic);
+    u(m.params.size());
+    for (const string &p : m.params) str(p);
+    u(m.raw_value.size());
+    for (const token_t &tok : m.raw_value) {
+      u(tok.type);
+      str(tok.get_filename());
+      u(tok.linenum);
+      u(tok.pos);
+      str(tok.content.view());
+    }
+  }
+
+  /// Write the record of each definition, then the table of their offsets.
+  void definitions() {
+    vector<size_t> offsets;
+    for (size_t i = 0; i < order.size(); ++i) {
+      offsets.push_back(out.size());
+      u(tags[i]);
+      str(order[i]->name);
+      u(order[i]->flags & ~DEF_FROZEN);
+      body(order[i], tags[i]);
+    }
+    patch(HF_DEF_COUNT, order.size());
+    mark(HF_DEF_INDEX);
+    for (size_t off : offsets) fixed(off);
+  }
+
+  void members(const definition_scope *sc) {
+    u(sc->members.size());
+    for (const auto &m : sc->members) { str(m.first); owned(m.second.get()); }
+    u(sc->c_structs.size());
+    for (const auto &m : sc->c_structs) { str(m.first); owned(m.second.get()); }
+    u(sc->dec_order.size());
+    for (const auto &it : sc->dec_order) {
+      auto cs = sc->c_structs.find(it->first);
+      u(cs != sc->c_structs.end() && &*cs == &*it);
+      str(it->first);
+    }
+  }
+
+  void body(const definition *d, DefTag tag) {
+    ref(d->parent);
+    if (is_typed(tag)) {
+      auto *t = (const definition_typed*) d;
+      ref(t->type);
+      refs(t->referencers);
+      u(t->modifiers);
+    }
+    if (tag == TAG_VALUED)
+      val(((const definition_valued*) d)->value_of);
+    if (tag == TAG_FUNCTION) {
+      auto *f = (const definition_function*) d;
+      u(f->overloads.size());
+      for (const auto &o : f->overloads) {
+        arguments(o.first);
+        owned(o.second.get());
+      }
+      u(f->template_overloads.size());
+      for (const auto &t : f->template_overloads) owned(t.get());
+    }
+    if (is_scope(tag)) {
+      auto *sc = (const definition_scope*) d;
+      u(sc->using_scopes.size());
+      for (const definition_scope *us : sc->using_scopes) ref(us);
+      u(sc->using_general.size());
+      for (const auto &g : sc->using_general) { str(g.first); ref(g.second); }
+      // The members hold no references, only numbers and names; write them
+      // aside to learn their length, which lets a reader skip them.
+      string rest;
+      rest.swap(out);
+      members(sc);
+      rest.swap(out);
+      u(rest.size());
+      out += rest;
+    }
+    if (is_class(tag)) {
+      auto *c = (const definition_class*) d;
+      u(c->ancestors.size());
+      for (const auto &a : c->ancestors) { u(a.protection); ref(a.def); }
+      ref(c->instance_of);
+      u(c->friends.size());
+      for (const definition *f : c->friends) ref(f);
+    }
+    if (tag == TAG_ENUM) {
+      auto *e = (const definition_enum*) d;
+      u(e->constants.size());
+      for (const auto &c : e->constants) { ref(c.def); ast(c.ast.get()); }
+      ref(e->type);
+      u(e->modifiers);
+    }
+    if (tag == TAG_TEMPLATE) {
+      auto *t = (const definition_template*) d;
+      owned(t->def.get());
+      u(t->params.size());
+      for (const auto &p : t->params) owned(p.get());
+      u(t->specializations.size());
+      for (const auto &sp : t->specializations) {
+        u(sp->key.ind_count);
+        u(sp->key.max_param);
+        for (size_t i = 0; i < sp->key.ind_count; ++i) {
+          const vector<unsigned> &inds = sp->key.arg_inds[i];
+          u(inds.size());
+          for (unsigned ind : inds) u(ind);
+        }
+        arguments(sp->filter);
+        owned(sp->spec_temp.get());
+      }
+      size_t instances = 0;
+      for (const auto &in : t->instantiations) instances += bool(in.second);
+      u(instances);
+      for (const auto &in : t->instantiations) {
+        if (!in.second) continue;
+        arguments(in.first);
+        owned(in.second->def.get());
+        u(in.second->parameter_defs.size());
+        for (const auto &pd : in.second->parameter_defs) owned(pd.get());
+      }
+      u(t->dependents.size());
+      for (const auto &dep : t->dependents) owned(dep.get());
+    }
+    if (tag == TAG_TEMPPARAM) {
+      auto *tp = (const definition_tempparam*) d;
+      ast(tp->default_assignment.get());
+      type(tp->integer_type);
+      u(tp->must_be_class);
+    }
+    if (tag == TAG_ATOMIC)
+      u(((const definition_atomic*) d)->sz);
+    if (tag == TAG_HYPOTHETICAL) {
+      auto *h = (const definition_hypothetical*) d;
+      ast(h->def.get());
+      u(h->required_flags);
+    }
+  }
+};
+
+//==============================================================================
+//===: Reading :================================================================
+//==============================================================================
+
+/// Finds a definition by name in a scope of the base, or in a scope it uses;
+/// the latter is how overlays reach what they cover.
+definition *find_member(definition *parent, const string &name, bool c_struct,
+                        set<definition_scope*> &seen) {
+  auto *scope = dynamic_cast<definition_scope*>(parent);
+  if (!scope || !seen.insert(scope).second) return nullptr;
+  scope->undefer();
+  if (auto *cls = dynamic_cast<definition_class*>(scope))
+    cls->materialize(name);
+  definition_scope::defmap &m = c_struct ? scope->c_structs : scope->members;
+  auto it = m.find(name);
+  if (it != m.end() && it->second) return it->second.get();
+  for (definition_scope *us : scope->using_scopes)
+    if (definition *res = find_member(us, name, c_struct, seen))
+      return res;
+  return nullptr;
+}
+
+class ContextReader;
+
+/// The members of a scope, left in the file until they are wanted.
+struct deferred_region: definition_scope::deferred_members {
+  ContextReader *reader;
+  const char *at;
+  deferred_region(ContextReader *r, const char *a): reader(r), at(a) {}
+  void decode(definition_scope *into) override;
+};
+
+class ContextReader {
+  const char *data, *at, *end;
+  definition_scope *base_global;
+  frozen_instantiations *store;
+  ErrorContext errc;
+  /// Whether to leave the members of each scope until it is searched.
+  bool lazy;
+  bool reported = false;
+  size_t def_count = 0, string_count = 0;
+  const char *def_index = nullptr, *string_index = nullptr, *preamble = nullptr;
+
+  /// The definitions allocated so far, by number.
+  std::unordered_map<size_t, definition*> defs;
+  /// Those of the above which their owners have yet to claim.
+  std::unordered_map<size_t, unique_ptr<definition>> unowned;
+  /// Definitions read, but which corrupt input gave no place to go. Others
+  /// may still refer to them, so they live as long as the reader.
+  vector<unique_ptr<definition>> orphans;
+  /// A definition allocated, but not yet filled in.
+  struct empty_shell {
+    definition *def;
+    unsigned tag;
+    const char *at;
+  };
+  vector<empty_shell> shells;
+
+ public:
+  /// Describes the first problem met, if any; reading stops there.
+  string problem;
+  vector<string> search_directories;
+  vector<shared_ptr<const macro_type>> macros;
+  vector<string> undefined_macros;
+  unique_ptr<definition_scope> global;
+  vector<definition*> variadics;
+  /// Names of definitions which could not be found again in the base.
+  vector<string> lost;
+
+  ContextReader(const char *d, size_t length, definition_scope *bg,
+                frozen_instantiations *st, ErrorContext ec, bool lz):
+      data(d), at(d), end(d + length), base_global(bg), store(st), errc(ec),
+      lazy(lz) {}
+
+  bool fail(string why) {
+    if (problem.empty()) problem = std::move(why);
+    return false;
+  }
+  bool ok() const { return problem.empty(); }
+
+  /// Report any problem, and any names lost, that have not been reported yet.
+  void report() {
+    if (!ok() && !reported) {
+      errc.error() << "Could not load context: " << problem;
+      reported = true;
+    }
+    for (const string &name : lost)
+      errc.warning() << "Saved context refers to `" << name
+                     << "', which its base no longer declares";
+    lost.clear();
+  }
+
+  /// Get a pointer to the given offset in the file, or null if it's outside.
+  const char *offset(unsigned long long off) {
+    if (off > (unsigned long long) (end - data))
+      return fail("Bad offset"), nullptr;
+    return data + off;
+  }
+  static unsigned long long fixed(const char *p) {
+    unsigned long long res = 0;
+    for (size_t i = kFieldSize; i--; )
+      res = res << 8 | (unsigned char) p[i];
+    return res;
+  }
+  /// Find a table of the given number of fixed-width fields.
+  const char *table(unsigned long long off, unsigned long long n) {
+    const char *res = offset(off);
+    if (res && n > (unsigned long long) (end - res) / kFieldSize)
+      return fail("Bad table size"), nullptr;
+    return res;
+  }
+
+  unsigned long long u() {
+    if (!ok()) return 0;
+    unsigned long long res = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      if (at >= end) return fail("Unexpected end of file"), 0;
+      unsigned char b = *at++;
+      res |= (unsigned long long) (b & 0x7F) << shift;
+      if (!(b & 0x80)) return res;
+    }
+    return fail("Malformed integer"), 0;
+  }
+  long long s() {
+    unsigned long long v = u();
+    return (long long) (v >> 1) ^ -(long long) (v & 1);
+  }
+  /// Read a count of items which each take at least one byte.
+  size_t count() {
+    unsigned long long n = u();
+    if (n > (unsigned long long) (end - at)) return fail("Bad count"), 0;
+    return n;
+  }
+  string_view str() {
+    unsigned long long ind = u();
+    if (ind >= string_count) return fail("Bad string index"), string_view();
+    const unsigned long long
+        from = fixed(string_index + ind * kFieldSize),
+        to = fixed(string_index + (ind + 1) * kFieldSize);
+    const char *res = offset(to);
+    if (!res || from > to) return fail("Bad string offset"), string_view();
+    return string_view(data + from, to - from);
+  }
+
+  value val() {
+    switch (u()) {
+      case VT_NONE: return value();
+      case VT_DEPENDENT: return value(VT_DEPENDENT);
+      case VT_STRING: return value(str());
+      case VT_INTEGER: {
+        const bool is_unsigned = u();
+        const long long integer = s();
+        return is_unsigned ? value((unsigned long long) integer)
+                           : value(integer);
+      }
+      case VT_DOUBLE: {
+        const string text(str());
+        return value(strtod(text.c_str(), nullptr));
+      }
+      default:
+        return fail("Bad value type"), value();
+    }
+  }
+
+  /// Get the definition with the given number, allocating it if it hasn't
+  /// been yet. It is filled in by the next call to \c fill().
+  definition *def_at(unsigned long long id) {
+    if (id >= def_count) return fail("Bad definition number"), nullptr;
+    if (auto it = defs.find(id); it != defs.end()) return it->second;
+    const char *const resume = at;
+    at = offset(fixed(def_index + id * kFieldSize));
+    if (!at) return at = resume, nullptr;
+    const unsigned tag = u();
+    string name(str());
+    unique_ptr<definition> res = shell(tag, std::move(name), u());
+    const char *const body = at;
+    at = resume;
+    if (!res) return nullptr;
+    defs[id] = res.get();
+    shells.push_back({res.get(), tag, body});
+    return (unowned[id] = std::move(res)).get();
+  }
+  /// Fill in every definition allocated so far, including any allocated in
+  /// the process.
+  void fill() {
+    while (!shells.empty() && ok()) {
+      const empty_shell next = shells.back();
+      shells.pop_back();
+      const char *const resume = at;
+      at = next.at;
+      body(next.def, next.tag);
+      at = resume;
+    }
+  }
+  /// Read a pointer to a definition owned by another, taking ownership of it.
+  template<typename T> unique_ptr<T> take() {
+    unsigned long long id = u();
+    if (!id) return nullptr;
+    if (!def_at(--id)) return nullptr;
+    auto it = unowned.find(id);
+    if (it == unowned.end()) return fail("Definition owned twice"), nullptr;
+    if (!dynamic_cast<T*>(it->second.get()))
+      return fail("Definition of the wrong kind"), nullptr;
+    unique_ptr<T> res((T*) it->second.release());
+    unowned.erase(it);
+    return res;
+  }
+  /// Store a definition under the given key, unless the key is taken.
+  template<typename M, typename K, typename T>
+  void place(M &m, const K &key, unique_ptr<T> d) {
+    if (!d) return;
+    if (m.find(key) != m.end()) {
+      fail("Duplicate entry");
+      orphans.push_back(std::move(d));
+      return;
+    }
+    m[key] = std::move(d);
+  }
+  /// As \c take(), but a definition must be given.
+  template<typename T> unique_ptr<T> take_some() {
+    unique_ptr<T> res = take<T>();
+    if (!res && ok()) fail("Missing definition");
+    return res;
+  }
+
+  /// Read a reference to a definition. The abstract sentinel may only stand
+  /// where \p abstract allows it: as the type of a template argument.
+  definition *ref(bool abstract = false) {
+    const unsigned long long kind = u();
+    switch (kind) {
+      case REF_NULL: return nullptr;
+      case REF_OWNED: return def_at(u());
+      case REF_ABSTRACT:
+        if (!abstract) return fail("Misplaced abstract argument"), nullptr;
+        return arg_key::abstract;
+      case REF_BASE_GLOBAL:
+        if (!base_global) return fail("Context was saved over a base"), nullptr;
+        return base_global;
+      case REF_PRIMITIVE: {
+        auto prim = builtin_primitives.find(string(str()));
+        if (prim == builtin_primitives.end())
+          return fail("Unknown primitive type"), nullptr;
+        return prim->second;
+      }
+      case REF_MEMBER: case REF_C_STRUCT: {
+        definition *parent = ref();
+        string name(str());
+        set<definition_scope*> seen;
+        definition *res = find_member(parent, name, kind == REF_C_STRUCT, seen);
+        if (!res && ok()) lost.push_back(name);
+        return res;
+      }
+      case REF_INSTANCE: {
+        definition *temp = ref();
+        arg_key key;
+        arguments(key);
+        if (!ok()) return nullptr;
+        if (!temp || !(temp->flags & DEF_TEMPLATE))
+          return fail("Instantiation of something not a template"), nullptr;
+        return ((definition_template*) temp)->instantiate(key, errc);
+      }
+      case REF_LOST:
+        lost.emplace_back(str());
+        return nullptr;
+      default:
+        return fail("Bad definition reference"), nullptr;
+    }
+  }
+  template<typename T> T *ref_as() {
+    definition *d = ref();
+    T *res = dynamic_cast<T*>(d);
+    if (d && !res) fail("Reference to a definition of the wrong kind");
+    return res;
+  }
+  /// As \c ref_as(), but a definition must be given.
+  template<typename T> T *ref_some() {
+    T *res = ref_as<T>();
+    if (!res && ok()) fail("Missing reference");
+    return res;
+  }
+
+  void refs(ref_stack &rs) {
+    rs.name = string(str());
+    rs.ndef = ref();
+    for (size_t n = count(); n-- && ok(); ) {
+      const unsigned long long rt = u();
+      if (rt == ref_stack::RT_POINTERTO || rt == ref_stack::RT_REFERENCE) {
+        ref_stack tmp;
+        tmp.push(ref_stack::ref_type(rt));
+        rs.prepend_c(tmp);
+      } else if (rt == ref_stack::RT_ARRAYBOUND) {
+        rs.push_array(size_t(u() - 1));
+      } else if (rt == ref_stack::RT_FUNCTION) {
+        ref_stack::parameter_ct params;
+        for (size_t np = count(); np-- && ok(); ) {
+          ref_stack::parameter param;
+          full_type ft;
+          type(ft);
+          param.swap_in(ft);
+          param.variadic = u();
+          param.default_value = ast().release();
+          params.throw_on(param);
+        }
+        rs.push_func(params);
+      } else if (rt == ref_stack::RT_MEMBER_POINTER) {
+        if (auto *c = ref_some<definition_class>()) rs.push_memptr(c);
+      } else {
+        fail("Bad referencer");
+      }
+    }
+  }
+
+  void type(full_type &ft, bool abstract = false) {
+    ft.def = ref(abstract);
+    refs(ft.refs);
+    ft.flags = u();
+  }
+
+  void arguments(arg_key &key) {
+    size_t n = count();
+    key = arg_key(n);
+    for (size_t i = 0; i < n && ok(); ++i) {
+      switch (u()) {
+        case arg_key::AKT_NONE: break;
+        case arg_key::AKT_FULLTYPE: {
+          full_type ft;
+          type(ft, true);
+          key.swap_final_type(i, ft);
+          break;
+        }
+        case arg_key::AKT_VALUE:
+          key.put_value(i, val());
+          key[i].av().ast = ast();
+          break;
+        default: fail("Bad template argument");
+      }
+    }
+  }
+
+  unique_ptr<AST> ast() {
+    unique_ptr<AST_Node> root = node();
+    if (!root) return nullptr;
+    auto res = std::make_unique<AST>(std::move(root));
+    res->compile();
+    return res;
+  }
+
+  /// As \c node(), but a node must be given.
+  unique_ptr<AST_Node> some() {
+    unique_ptr<AST_Node> res = node();
+    if (!res && ok()) fail("Missing expression node");
+    return res;
+  }
+
+  unique_ptr<AST_Node> node() {
+    const unsigned long long tag = u();
+    if (tag == NODE_NULL || !ok()) return nullptr;
+    const AST_TYPE atype = AST_TYPE(u());
+    const string content(str());
+    const string_view filename = str();
+    const long long linenum = s(), pos = s();
+
+    unique_ptr<AST_Node> res;
+    switch (tag) {
+      case NODE_PLAIN:
+        res = std::make_unique<AST_Node>(atype);
+        break;
+      case NODE_DEFINITION:
+        res = std::make_unique<AST_Node_Definition>(ref(), content);
+        break;
+      case NODE_SCOPE: {
+        auto left = some();
+        res = std::make_unique<AST_Node_Scope>(std::move(left), node(), content);
+        break;
+      }
+      case NODE_TYPE: {
+        full_type ft;
+        type(ft);
+        res = std::make_unique<AST_Node_Type>(ft);
+        break;
+      }
+      case NODE_UNARY: {
+        const bool prefix = u();
+        res = std::make_unique<AST_Node_Unary>(some(), content, prefix, atype);
+        break;
+      }
+      case NODE_SIZEOF: {
+        const bool negate = u();
+        res = std::make_unique<AST_Node_sizeof>(some(), negate);
+        break;
+      }
+      case NODE_CAST: {
+        auto mode = AST_Node_Cast::cast_modes(u());
+        full_type ft;
+        type(ft);
+        res = std::make_unique<AST_Node_Cast>(some(), ft, mode);
+        break;
+      }
+      case NODE_BINARY: {
+        auto left = some();
+        res = std::make_unique<AST_Node_Binary>(std::move(left), some(),
+                                                content, atype);
+        break;
+      }
+      case NODE_TERNARY: {
+        auto exp = some();
+        auto left = some();
+        res = std::make_unique<AST_Node_Ternary>(std::move(exp), std::move(left),
+                                                 some(), content);
+        break;
+      }
+      case NODE_PARAMETERS: {
+        auto params = std::make_unique<AST_Node_Parameters>();
+        params->func = some();
+        for (size_t n = count(); n-- && ok(); ) params->params.push_back(some());
+        res = std::move(params);
+        break;
+      }
+      case NODE_ARRAY: {
+        auto array = std::make_unique<AST_Node_Array>();
+        for (size_t n = count(); n-- && ok(); )
+          array->elements.push_back(some());
+        res = std::move(array);
+        break;
+      }
+      case NODE_NEW: {
+        full_type ft;
+        type(ft);
+        auto position = node();
+        res = std::make_unique<AST_Node_new>(ft, std::move(position), node());
+        break;
+      }
+      case NODE_DELETE: {
+        const bool array = u();
+        res = std::make_unique<AST_Node_delete>(some(), array);
+        break;
+      }
+      case NODE_SUBSCRIPT: {
+        auto left = some();
+        res = std::make_unique<AST_Node_Subscript>(std::move(left), some());
+        break;
+      }
+      case NODE_TEMPINST: {
+        auto inst = std::make_unique<AST_Node_TempInst>(some(), content);
+        for (size_t n = count(); n-- && ok(); ) inst->params.push_back(some());
+        res = std::move(inst);
+        break;
+      }
+      case NODE_TEMPKEYINST: {
+        auto *temp = ref_as<definition_template>();
+        arg_key key;
+        arguments(key);
+        if (!temp) return fail("Instantiation of something not a template"), nullptr;
+        res = std::make_unique<AST_Node_TempKeyInst>(temp, key);
+        break;
+      }
+      case NODE_CONSTANT: {
+        const value v = val();
+        full_type ft;
+        type(ft);
+        res = std::make_unique<AST_Node_Constant>(content, v, ft);
+        break;
+      }
+      default:
+        return fail("Bad expression node"), nullptr;
+    }
+    if (!ok()) return nullptr;
+    if (!fits_node(tag, atype, res->type))
+      return fail("Expression node of the wrong type"), nullptr;
+    res->type = atype;
+    res->content = content;
+    #ifndef NO_ERROR_REPORTING
+      res->file = FileTable::id_of(filename);
+      res->linenum = linenum;
+      #ifndef NO_ERROR_POSITION
+        res->pos = pos;
+      #endif
+    #endif
+    (void) filename; (void) linenum; (void) pos;
+    return res;
+  }
+
+  void macro() {
+    string name(str());
+    const bool is_function = u(), is_variadic = u();
+    vector<string> params;
+    for (size_t n = count(); n-- && ok(); ) params.emplace_back(str());
+    vector<token_t> definiens;
+    for (size_t n = count(); n-- && ok(); ) {
+      const TOKEN_TYPE type = TOKEN_TYPE(u());
+      const string_view file = str();
+      const size_t line = u(), pos = u();
+      const string_view content = str();
+      if (file.empty() || (content.empty() && type != TT_ENDOFCODE
+                                           && type != TTM_NEWLINE))
+        return (void) fail("Bad macro token");
+      definiens.emplace_back(type, file, line, pos, content);
+      // The content still points into the file; give the token its own copy.
+      definiens.back().content = string(content);
+    }
+    if (!ok()) return;
+    ErrorHandler *herr = errc.get_herr();
+    if (is_function)
+      macros.push_back(std::make_shared<macro_type>(
+          name, std::move(params), is_variadic, std::move(definiens), herr));
+    else
+      macros.push_back(std::make_shared<macro_type>(
+          name, std::move(definiens), herr));
+  }
+
+  unique_ptr<definition> shell(unsigned tag, string name, unsigned flags) {
+    unique_ptr<definition> res;
+    switch (tag) {
+      case TAG_DEFINITION:
+        res = std::make_unique<definition>(name, nullptr, flags); break;
+      case TAG_TYPED:
+        res = std::make_unique<definition_typed>(
+            name, nullptr, (definition*) nullptr, 0u, flags); break;
+      case TAG_OVERLOAD:
+        res = std::make_unique<definition_overload>(
+            name, nullptr, nullptr, ref_stack(), 0u, flags); break;
+      case TAG_VALUED:
+        res = std::make_unique<definition_valued>(
+            name, nullptr, nullptr, 0u, flags, value()); break;
+      case TAG_FUNCTION:
+        res = std::make_unique<definition_function>(name, nullptr, flags); break;
+      case TAG_SCOPE:
+        res = std::make_unique<definition_scope>(name, nullptr, flags); break;
+      case TAG_CLASS:
+        res = std::make_unique<definition_class>(name, nullptr, flags); break;
+      case TAG_UNION:
+        res = std::make_unique<definition_union>(name, nullptr, flags); break;
+      case TAG_ENUM:
+        res = std::make_unique<definition_enum>(name, nullptr, flags); break;
+      case TAG_TEMPLATE:
+        res = std::make_unique<definition_template>(name, nullptr, flags); break;
+      case TAG_TEMPPARAM:
+        res = std::make_unique<definition_tempparam>(name, nullptr, flags); break;
+      case TAG_ATOMIC:
+        res = std::make_unique<definition_atomic>(name, nullptr, flags, 0); break;
+      case TAG_HYPOTHETICAL:
+        res = std::make_unique<definition_hypothetical>(
+            name, nullptr, flags, nullptr); break;
+      default:
+        return fail("Bad definition kind"), nullptr;
+    }
+    if (!fits_flags(res.get(), flags))
+      return fail("Definition flags do not match its kind"), nullptr;
+    // Constructors add flags of their own; restore those saved exactly.
+    res->flags = flags;
+    return res;
+  }
+
+  /// Read the members of a scope from the given place in the file.
+  void members(definition_scope *sc, const char *from) {
+    const char *const resume = at;
+    at = from;
+    for (size_t n = count(); n-- && ok(); ) {
+      string name(str());
+      place(sc->members, name, take_some<definition>());
+    }
+    for (size_t n = count(); n-- && ok(); ) {
+      string name(str());
+      place(sc->c_structs, name, take_some<definition>());
+    }
+    for (size_t n = count(); n-- && ok(); ) {
+      auto &m = u() ? sc->c_structs : sc->members;
+      auto it = m.find(string(str()));
+      if (it == m.end()) { fail("Bad declaration order"); break; }
+      sc->dec_order.push_back(it);
+    }
+    at = resume;
+  }
+  /// Read the deferred members of a scope, and whatever they need.
+  void decode_members(definition_scope *sc, const char *from) {
+    frozen_instantiations::use use_ours(*store);
+    members(sc, from);
+    fill();
+    report();
+  }
+
+  void body(definition *d, unsigned tag) {
+    d->parent = ref_as<definition_scope>();
+    if (is_typed(tag)) {
+      auto *t = (definition_typed*) d;
+      t->type = ref();
+      refs(t->referencers);
+      t->modifiers = u();
+    }
+    if (tag == TAG_VALUED)
+      ((definition_valued*) d)->value_of = val();
+    if (tag == TAG_FUNCTION) {
+      auto *f = (definition_function*) d;
+      for (size_t n = count(); n-- && ok(); ) {
+        arg_key key;
+        arguments(key);
+        place(f->overloads, key, take_some<definition_overload>());
+      }
+      for (size_t n = count(); n-- && ok(); )
+        if (auto t = take_some<definition_template>())
+          f->template_overloads.push_back(std::move(t));
+    }
+    if (is_scope(tag)) {
+      auto *sc = (definition_scope*) d;
+      for (size_t n = count(); n-- && ok(); )
+        if (auto *u = ref_some<definition_scope>()) sc->using_scopes.push_back(u);
+      for (size_t n = count(); n-- && ok(); ) {
+        string name(str());
+        sc->using_general[name] = ref();
+      }
+      const size_t length = count();
+      const char *const from = at;
+      at += length;
+      if (!ok()) return;
+      if (lazy)
+        sc->deferred = std::make_unique<deferred_region>(this, from);
+      else
+        members(sc, from);
+    }
+    if (is_class(tag)) {
+      auto *c = (definition_class*) d;
+      for (size_t n = count(); n-- && ok(); ) {
+        unsigned protection = u();
+        if (auto *a = ref_some<definition_class>())
+          c->ancestors.emplace_back(protection, a);
+      }
+      c->instance_of = ref_as<definition_template>();
+      for (size_t n = count(); n-- && ok(); )
+        if (auto *f = ref_some<definition>()) c->friends.insert(f);
+    }
+    if (tag == TAG_ENUM) {
+      auto *e = (definition_enum*) d;
+      for (size_t n = count(); n-- && ok(); ) {
+        auto *cdef = ref_some<definition_valued>();
+        auto value = ast();
+        if (cdef) e->constants.emplace_back(cdef, std::move(value));
+      }
+      e->type = ref();
+      e->modifiers = u();
+    }
+    if (tag == TAG_TEMPLATE) {
+      auto *t = (definition_template*) d;
+      t->def = take<definition>();
+      for (size_t n = count(); n-- && ok(); )
+        if (auto tp = take_some<definition_tempparam>())
+          t->params.push_back(std::move(tp));
+      for (size_t n = count(); n-- && ok(); ) {
+        spec_key key(0, 0);
+        key.ind_count = count();
+        key.max_param = u();
+        key.arg_inds.resize(key.ind_count);
+        for (auto &inds : key.arg_inds) {
+          inds.resize(count());
+          for (unsigned &ind : inds) ind = u();
+        }
+        arg_key filter;
+        arguments(filter);
+        auto spec_temp = take<definition_template>();
+        if (!spec_temp) return (void) fail("Specialization without a template");
+        auto spec = std::make_unique<definition_template::specialization>(
+            t, std::move(spec_temp));
+        spec->key.arg_inds.swap(key.arg_inds);
+        spec->key.ind_count = key.ind_count;
+        spec->key.max_param = key.max_param;
+        spec->filter = filter;
+        t->specializations.push_back(std::move(spec));
+      }
+      for (size_t n = count(); n-- && ok(); ) {
+        arg_key key;
+        arguments(key);
+        auto inst = std::make_unique<definition_template::instantiation>();
+        inst->def = take_some<definition>();
+        for (size_t np = count(); np-- && ok(); )
+          if (auto p = take_some<definition>())
+            inst->parameter_defs.push_back(std::move(p));
+        if (inst->def && !t->instantiations.count(key)) {
+          t->instantiations[key] = std::move(inst);
+          continue;
+        }
+        if (inst->def) fail("Duplicate entry");
+        orphans.push_back(std::move(inst->def));
+        for (auto &p : inst->parameter_defs) orphans.push_back(std::move(p));
+      }
+      for (size_t n = count(); n-- && ok(); )
+        if (auto h = take_some<definition_hypothetical>())
+          t->dependents.push_back(std::move(h));
+    }
+    if (tag == TAG_TEMPPARAM) {
+      auto *tp = (definition_tempparam*) d;
+      tp->default_assignment = ast();
+      type(tp->integer_type);
+      tp->must_be_class = u();
+    }
+    if (tag == TAG_ATOMIC)
+      ((definition_atomic*) d)->sz = u();
+    if (tag == TAG_HYPOTHETICAL) {
+      auto *h = (definition_hypothetical*) d;
+      h->def = ast();
+      h->required_flags = u();
+    }
+  }
+
+  bool header() {
+    if (end - at < 4 || memcmp(at, kMagic, sizeof kMagic))
+      return fail("Not a saved context");
+    at += sizeof kMagic;
+    if (u() != kFormatVersion)
+      return fail("Saved by an incompatible version");
+    if (size_t(end - at) < HF_COUNT * kFieldSize)
+      return fail("Unexpected end of file");
+    unsigned long long field[HF_COUNT];
+    for (size_t i = 0; i < HF_COUNT; ++i)
+      field[i] = fixed(at + i * kFieldSize);
+    def_count = field[HF_DEF_COUNT];
+    def_index = table(field[HF_DEF_INDEX], def_count);
+    string_count = field[HF_STRING_COUNT];
+    string_index = table(field[HF_STRING_INDEX], string_count + 1);
+    preamble = offset(field[HF_PREAMBLE]);
+    return ok();
+  }
+
+  /// Read the global scope and the preamble. Unless reading lazily, this
+  /// reads every definition.
+  bool read() {
+    if (!header()) return false;
+    if (!def_count) return fail("Missing global scope");
+    global = take_global();
+    at = preamble;
+    for (size_t n = count(); n-- && ok(); )
+      search_directories.emplace_back(str());
+    for (size_t n = count(); n-- && ok(); ) macro();
+    for (size_t n = count(); n-- && ok(); )
+      undefined_macros.emplace_back(str());
+    for (size_t n = count(); n-- && ok(); ) variadics.push_back(ref());
+    fill();
+    // Read in full, everything must have been claimed by an owner.
+    if (!lazy && ok() && (!unowned.empty() || defs.size() != def_count))
+      fail("Definition without an owner");
+    return ok();
+  }
+
+  unique_ptr<definition_scope> take_global() {
+    if (!def_at(0)) return nullptr;
+    fill();
+    auto it = unowned.find(0);
+    if (it == unowned.end()) return fail("Bad global scope"), nullptr;
+    auto *res = dynamic_cast<definition_scope*>(it->second.get());
+    if (!res || tag_of(res) != TAG_SCOPE || res->parent)
+      return fail("Bad global scope"), nullptr;
+    it->second.release();
+    unowned.erase(it);
+    return unique_ptr<definition_scope>(res);
+  }
+};
+
+void deferred_region::decode(definition_scope *into) {
+  reader->decode_members(into, at);
+}
+
+}  // namespace
+
+/// A saved context, kept open so that its scopes can be read as needed.
+class jdi::mapped_context {
+ public:
+  llreader file;
+  ContextReader reader;
+  mapped_context(const std::filesystem::path &path, definition_scope *bg,
+                 frozen_instantiations *store, ErrorContext errc, bool lazy):
+      file(path), reader(file.data, file.length, bg, store, errc, lazy) {}
+};
+
+int Context::save(const std::filesystem::path &path) {
+  ErrorContext errc(herr, {path.string(), SourceLocation::npos,
+                           SourceLocation::npos});
+  if (parse_open) {
+    errc.error() << "Cannot save a context while it is being parsed";
+    return -1;
+  }
+  // Build anything pending, as freeze() does, so the file holds everything.
+  frozen_instantiations::use use_ours(*instances);
+  for (int sweep = 0; sweep < 128; ++sweep) {
+    bool changed = global->freeze(false);
+    changed |= instances->freeze(false);
+    if (!changed) break;
+  }
+
+  ContextWriter out(instances.get(), base);
+  out.enumerate(global.get());
+  out.definitions();
+  out.mark(HF_PREAMBLE);
+
+  vector<string> own_dirs;
+  for (const string &dir : search_directories) {
+    if (!base || std::find(base->search_directories.begin(),
+                           base->search_directories.end(), dir)
+                 == base->search_directories.end())
+      own_dirs.push_back(dir);
+  }
+  out.u(own_dirs.size());
+  for (const string &dir : own_dirs) out.str(dir);
+
+  // Macros shared with the base are found there again; only write ours.
+  vector<const macro_type*> own_macros;
+  for (const auto &m : macros) {
+    auto bm = base ? base->macros.find(m.first) : macro_iter_c();
+    if (!base || bm == base->macros.end() || bm->second != m.second)
+      own_macros.push_back(m.second.get());
+  }
+  out.u(own_macros.size());
+  for (const macro_type *m : own_macros) out.macro(*m);
+  vector<string_view> undefined;
+  if (base) {
+    for (const auto &m : base->macros)
+      if (!macros.count(m.first)) undefined.push_back(m.first);
+  }
+  out.u(undefined.size());
+  for (string_view name : undefined) out.str(name);
+
+  out.u(variadics.size());
+  for (const definition *var : variadics) out.ref(var);
+  out.finish();
+
+  std::ofstream file(path, std::ios::binary);
+  file.write(out.data().data(), out.data().size());
+  if (!file) {
+    errc.error() << "Could not write file";
+    return -1;
+  }
+  return 0;
+}
+
+int Context::load(const std::filesystem::path &path) {
+  return read_saved(path, false);
+}
+
+int Context::load_mapped(const std::filesystem::path &path) {
+  return read_saved(path, true);
+}
+
+int Context::read_saved(const std::filesystem::path &path, bool lazy) {
+  ErrorContext errc(herr, {path.string(), SourceLocation::npos,
+                           SourceLocation::npos});
+  if (parse_open || frozen) {
+    errc.error() << "Cannot load into a context which is frozen or being parsed";
+    return -1;
+  }
+  auto saved = std::make_shared<mapped_context>(
+      path, base ? base->global.get() : nullptr, instances.get(), errc, lazy);
+  if (!saved->file.is_open()) {
+    errc.error() << "Could not open file for loading";
+    return -1;
+  }
+
+  // Instantiations of the base's templates made along the way are ours.
+  frozen_instantiations::use use_ours(*instances);
+  ContextReader &in = saved->reader;
+  const bool read = in.read();
+  in.report();
+  if (!read) return -1;
+
+  global = std::move(in.global);
+  // Read in full, the file is no longer needed.
+  mapping = lazy ? std::move(saved) : nullptr;
+  for (string &dir : in.search_directories)
+    search_directories.push_back(std::move(dir));
+  for (const string &name : in.undefined_macros) macros.erase(name);
+  for (auto &m : in.macros) {
+    const string name = m->name;
+    macros[name] = std::move(m);
+  }
+  variadics.insert(in.variadics.begin(), in.variadics.end());
+  return 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file  declaration_observer.cpp
+ * @brief Source implementing the rules of a declaration filter.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <API/declaration_observer.h>
+#include <Storage/definition.h>
+
+#include <filesystem>
+
+namespace jdi {
+
+static unsigned kind_flags(const definition *def) {
+  unsigned flags = def->flags;
+  if (flags & DEF_OVERLOAD) flags |= DEF_FUNCTION;
+  return flags;
+}
+
+bool DeclarationFilter::keeps(const definition *def,
+                              const SourceRange &range) const {
+  // A template is judged as what it declares.
+  const definition *subject = def;
+  if ((def->flags & DEF_TEMPLATE) && ((const definition_template*) def)->def)
+    subject = ((const definition_template*) def)->def.get();
+
+  // Kinds only sort functions; nothing else is ever discarded.
+  if (kinds && (kind_flags(subject) & DEF_FUNCTION) &&
+      !((kind_flags(def) | kind_flags(subject)) & kinds))
+    return false;
+
+  if (!path_prefixes.empty()) {
+    // Resolve `..` first, or `mine/../sys/s.h` would pass for `mine/`.
+    namespace fs = std::filesystem;
+    const std::string file =
+        fs::path(range.begin.filename()).lexically_normal().generic_string();
+    bool found = false;
+    for (const std::string &prefix : path_prefixes) {
+      const std::string norm =
+          fs::path(prefix).lexically_normal().generic_string();
+      if (!file.compare(0, norm.length(), norm)) { found = true; break; }
+    }
+    if (!found) return false;
+  }
+
+  if (!scopes.empty()) {
+    const std::string qid = subject->qualified_id();
+    bool found = false;
+    for (std::string scope : scopes) {
+      if (scope.compare(0, 2, "::")) scope = "::" + scope;
+      if (scope == "::") scope.clear();
+      scope += "::";
+      if (!qid.compare(0, scope.length(), scope)) { found = true; break; }
+    }
+    if (!found) return false;
+  }
+
+  return true;
+}
+
+}
@@ -0,0 +1,107 @@
+/**
+ * @file  declaration_observer.h
+ * @brief Header declaring an interface for watching declarations as they are
+ *        parsed.
+ *
+ * A tool which only exports or indexes declarations needn't wait for a whole
+ * header set to be parsed before it starts on them. An observer given to a
+ * context is told of each declaration as soon as the parser has read it in
+ * full, so that work on it can proceed while parsing continues. Such a
+ * tool seldom wants everything the system headers declare, either; a filter
+ * given to a context lets the parser throw away what the tool will not use.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _JDI_DECLARATION_OBSERVER__H
+#define _JDI_DECLARATION_OBSERVER__H
+
+#include <string>
+#include <vector>
+
+#include <API/error_reporting.h>
+#include <Storage/definition_forward.h>
+
+namespace jdi {
+
+/**
+  Abstract class notified of each declaration the parser completes. Set one on
+  a context with \c Context::set_observer().
+
+  Declarations are reported in the order they end: the members of a class or
+  namespace come before the class or namespace itself. Each declarator of a
+  declaration such as `int a, b;` is reported on its own. Naming a class,
+  union, or enum which is already declared, as in `struct x *p;`, reports
+  nothing but the declarator; only bodies, and the first declaration of a
+  name, are reported. Templates are reported once their pattern is complete,
+  and functions once their body, if any, has been skipped. A declarator the
+  parser reports an error in is not reported.
+**/
+class DeclarationObserver {
+ public:
+  /** Called as the parser completes a declaration.
+      @param def    The declared definition. It belongs to the context, and
+                    may be kept for as long as the context is, unless a
+                    filter on the context discards it; see
+                    \c DeclarationFilter.
+      @param range  Where the declaration appears; it ends at the token which
+                    closes it, such as its semicolon or closing brace. **/
+  virtual void declared(definition *def, const SourceRange &range) = 0;
+
+  /// Virtual destructor in case children have additional data types to free.
+  virtual ~DeclarationObserver() = default;
+};
+
+/**
+  Rules choosing which declarations a context keeps as it is parsed. Set one on
+  a context with \c Context::set_filter().
+
+  A declaration is kept if it passes every rule which is given. Those it fails
+  are still parsed, and only those which nothing else can depend on are thrown
+  away: types, variables and enumerators are always kept, as later lookups may
+  need them. What is thrown away is the overloads of functions, including
+  function templates; the function itself stays declared, without overloads,
+  so that `using` declarations and other lookups naming it still work. Calls
+  resolved later in the parse, as within `sizeof` or `decltype`, no longer see
+  the discarded overloads. Only memory held by functions thus scales with what
+  is kept. An overload which an earlier declaration kept is never discarded
+  because a later declaration of it fails the rules.
+**/
+struct DeclarationFilter {
+  /// Keep declarations made in files whose path begins with one of these.
+  /// Both paths are compared with `.` and `..` resolved, but symbolic links
+  /// are not followed. If empty, declarations from any file pass.
+  std::vector<std::string> path_prefixes;
+  /// Keep declarations within one of these namespaces or classes, given
+  /// qualified, as in "std" or "::ns::inner". If empty, any scope passes.
+  std::vector<std::string> scopes;
+  /// Keep functions having any of these DEF_FLAGS. A function overload
+  /// matches DEF_FUNCTION, and a function template matches DEF_TEMPLATE as
+  /// well as the flags of what it declares. This rule only sorts functions;
+  /// declarations of any other kind pass it. If zero, every function passes.
+  unsigned kinds = 0;
+
+  /** Check whether a declaration passes these rules.
+      @param def    The declared definition.
+      @param range  Where it was declared, as given to an observer.
+      @return Whether to keep the declaration. */
+  bool keeps(const definition *def, const SourceRange &range) const;
+};
+
+}
+
+#endif
@@ -19,15 +19,48 @@
  * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
 **/
 
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 #include <API/error_reporting.h>
 
 namespace jdi {
 
+namespace {
+struct FileNames {
+  std::mutex lock;
+  std::deque<std::string> names{"", "<no file>"};
+  std::unordered_map<std::string_view, uint32_t> ids{
+      {names[0], 0}, {names[FileTable::kNoFile], FileTable::kNoFile}};
+};
+FileNames &file_names() {
+  static FileNames instance;
+  return instance;
+}
+}  // namespace
+
+uint32_t FileTable::id_of(std::string_view name) {
+  if (name.empty()) return 0;
+  FileNames &fn = file_names();
+  std::lock_guard<std::mutex> guard(fn.lock);
+  auto it = fn.ids.find(name);
+  if (it != fn.ids.end()) return it->second;
+  const uint32_t id = fn.names.size();
+  fn.ids.emplace(fn.names.emplace_back(name), id);
+  return id;
+}
+
+const std::string &FileTable::name_of(uint32_t id) {
+  FileNames &fn = file_names();
+  std::lock_guard<std::mutex> guard(fn.lock);
+  return fn.names[id];
+}
+
 std::string SourceLocation::to_string() const {
   std::string res;
-  if (!filename.empty()) {
-    res += filename;
+  if (const std::string &name = filename(); !name.empty()) {
+    res += name;
     if (line != npos) {
       res += ":" + std::to_string(line);
       if (pos != npos) {
@@ -38,8 +71,14 @@ std::string SourceLocation::to_string() const {
   return res;
 }
 
+bool DefaultErrorHandler::wants(ErrorLevel level) const {
+  if (level > least_severe) return false;
+  return !max_count || error_count + warning_count < max_count;
+}
+
 void DefaultErrorHandler::error(std::string_view err,
                               SourceLocation code_point) {
+if (!wants(ERROR)) return;
 const std::string cps = code_point.to_string();
 if (cps.empty()) {
   std::cerr << "ERROR: " << err << std::endl;
@@ -50,6 +89,7 @@ if (cps.empty()) {
 }
 void DefaultErrorHandler::warning(std::string_view warn,
                                 SourceLocation code_point) {
+if (!wants(WARNING)) return;
 const std::string cps = code_point.to_string();
 if (cps.empty()) {
   std::cerr << "Warning: " << warn << std::endl;
@@ -60,6 +100,7 @@ if (cps.empty()) {
 }
 void DefaultErrorHandler::info(std::string_view msg, int,
                              SourceLocation code_point) {
+if (!wants(INFO)) return;
 const std::string cps = code_point.to_string();
 if (cps.empty()) {
   std::cerr << "Info: " << msg << std::endl;
@@ -71,6 +112,64 @@ if (cps.empty()) {
 DefaultErrorHandler::DefaultErrorHandler():
   error_count(0), warning_count(0) {}
 
+AggregatingErrorHandler::AggregatingErrorHandler(ErrorHandler *t, size_t b):
+    target(t), batch(b ? b : 1) {}
+AggregatingErrorHandler::~AggregatingErrorHandler() { flush(); }
+
+void AggregatingErrorHandler::error(std::string_view err,
+                                    SourceLocation code_point) {
+  add(ERROR, err, 0, code_point);
+}
+void AggregatingErrorHandler::warning(std::string_view warn,
+                                      SourceLocation code_point) {
+  add(WARNING, warn, 0, code_point);
+}
+void AggregatingErrorHandler::info(std::string_view msg, int verbosity,
+                                   SourceLocation code_point) {
+  add(INFO, msg, verbosity, code_point);
+}
+
+void AggregatingErrorHandler::add(ErrorLevel level, std::string_view msg,
+                                  int verbosity, const SourceLocation &where) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto ins = seen.emplace(
+        key(level, where.file, where.line, where.pos, std::string(msg)),
+        messages.size());
+    if (!ins.second) {
+      const size_t i = ins.first->second;
+      if (!messages[i].repeats++ && i < passed) repeated.push_back(i);
+      return;
+    }
+    messages.push_back({level, std::string(msg), where, verbosity});
+    if (messages.size() - passed < batch) return;
+  }
+  flush();
+}
+
+void AggregatingErrorHandler::flush() {
+  std::lock_guard<std::mutex> guard(lock);
+  auto pass_repeats = [this](held &m) {
+    if (!m.repeats) return;
+    target->info("Repeated " + std::to_string(m.repeats) +
+                 (m.repeats == 1 ? " more time: " : " more times: ") +
+                 m.message, m.verbosity, m.where);
+    m.repeats = 0;
+  };
+  for (size_t i : repeated) pass_repeats(messages[i]);
+  repeated.clear();
+  for (; passed < messages.size(); ++passed) {
+    held &m = messages[passed];
+    switch (m.level) {
+      default:
+      case ERROR:   target->error(m.message, m.where); break;
+      case WARNING: target->warning(m.message, m.where); break;
+      case INFO:    target->info(m.message, m.verbosity, m.where); break;
+    }
+    pass_repeats(m);
+  }
+}
+
 /// The instance of `DefaultErrorHandler` to which `default_error_handler`
 /// will point.
 static DefaultErrorHandler deh_instance;
@@ -25,9 +25,15 @@
 #ifndef JDI_ERROR_REPORTING_h
 #define JDI_ERROR_REPORTING_h
 
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <sstream>
+#include <tuple>
+#include <vector>
 #include "General/strings.h"
 
 namespace jdi {
@@ -39,26 +45,53 @@ class ErrorStream;
 
 enum ErrorLevel { ERROR, WARNING, INFO };
 
+/// Numbers the names of source files, so that a location can be kept as a
+/// small ID rather than as a copy of the name. Names are kept for the life of
+/// the program; an ID, once given, always names the same file.
+class FileTable {
+ public:
+  /// The ID of "<no file>", given to tokens which come from nowhere.
+  static constexpr uint32_t kNoFile = 1;
+
+  /// Returns the ID of the file by the given name, numbering it if it has no
+  /// ID yet. The empty name is always ID zero.
+  static uint32_t id_of(std::string_view name);
+  /// Returns the name of the file with the given ID.
+  static const std::string &name_of(uint32_t id);
+};
+
+/// A point in the source, as the file's \c FileTable ID and a line and
+/// position. Copying one costs nothing; the file's name is only looked up
+/// when a message is formatted.
 struct SourceLocation {
   static constexpr size_t npos = (size_t) -1;
-  std::string filename;
+  uint32_t file; ///< The \c FileTable ID of the file.
   size_t line;
   size_t pos;
 
   template<typename T,
-           typename e = decltype(std::declval<T>().get_filename()),
+           typename e = decltype(std::declval<T>().get_file_id()),
            typename e2 = decltype(std::declval<T>().get_line_number()),
            typename e3 = decltype(std::declval<T>().get_line_position())>
   SourceLocation(const T &code_point):
-      filename(code_point.get_filename()),
+      file(code_point.get_file_id()),
       line(code_point.get_line_number()),
       pos(code_point.get_line_position()) {}
-  SourceLocation(std::string_view file, size_t l, size_t p):
-      filename(file), line(l), pos(p) {}
+  SourceLocation(std::string_view filename, size_t l, size_t p):
+      file(FileTable::id_of(filename)), line(l), pos(p) {}
+
+  /// Returns the name of the file.
+  const std::string &filename() const { return FileTable::name_of(file); }
 
   std::string to_string() const;
 };
 
+/// A stretch of source code, from where one token begins to where another does.
+struct SourceRange {
+  SourceLocation begin; ///< Where the first token of the stretch begins.
+  SourceLocation end;   ///< Where the last token of the stretch begins.
+};
+
 /// Abstract class for error handling and warning reporting.
 /// Implement this class yourself, or use \c default_error_handler.
 class ErrorHandler {
@@ -76,14 +109,19 @@ class ErrorHandler {
   virtual void info(std::string_view err, int verbosity,
                     SourceLocation code_point) = 0;
 
+  /// Returns whether a message of the given level would be used. This is
+  /// asked before a message is formatted; messages a handler doesn't want
+  /// are dropped without being built. By default, every message is wanted.
+  virtual bool wants(ErrorLevel) const { return true; }
+
   // Formatting helpers.
   template<typename... Args>
   void error(const SourceLocation &sl, std::string_view msg, Args... args) {
-    return error(format(msg, args...), sl);
+    if (wants(ERROR)) error(format(msg, args...), sl);
   }
   template<typename... Args>
   void warning(const SourceLocation &sl, std::string_view msg, Args... args) {
-    return warning(format(msg, args...), sl);
+    if (wants(WARNING)) warning(format(msg, args...), sl);
   }
 
   /// Bind to a SourceLocation, creating an ErrorContext.
@@ -103,9 +141,15 @@ class ErrorContext {
   SourceLocation sloc_;
 
  public:
-  void error(std::string_view err) const { herr_->error(err, sloc_); }
-  void warning(std::string err) const { herr_->warning(err, sloc_); }
-  void info(int v, std::string err) const { herr_->info(err, v, sloc_); }
+  void error(std::string_view err) const {
+    if (herr_->wants(ERROR)) herr_->error(err, sloc_);
+  }
+  void warning(std::string err) const {
+    if (herr_->wants(WARNING)) herr_->warning(err, sloc_);
+  }
+  void info(int v, std::string err) const {
+    if (herr_->wants(INFO)) herr_->info(err, v, sloc_);
+  }
   ErrorHandler *get_herr()  const { return herr_; }
   SourceLocation get_source_location() const { return sloc_; }
 
@@ -123,17 +167,19 @@ class ErrorStream {
   SourceLocation sloc_;
   std::stringstream message_;
   ErrorLevel level_;
+  bool wanted_; ///< Whether the handler wants this message; if not, we build nothing.
 
  public:
   explicit ErrorStream(ErrorHandler *herr, const SourceLocation &loc,
                        ErrorLevel level):
-      herr_(herr), sloc_(loc), level_(level) {}
+      herr_(herr), sloc_(loc), level_(level), wanted_(herr->wants(level)) {}
   template<typename T>
   ErrorStream &operator<<(const T &x) {
-    string_detection::put(message_, x);
+    if (wanted_) string_detection::put(message_, x);
     return *this;
   }
   ~ErrorStream() {
+    if (!wanted_) return;
     switch (level_) {
       default:
       case ERROR:   herr_->  error(message_.str(), sloc_); return;
@@ -170,7 +216,14 @@ ErrorStream ErrorContext::info() const {
 /// Default class for error handling and warning reporting.
 /// Prints all errors and warnings to stderr alike. No other action is taken.
 struct DefaultErrorHandler: ErrorHandler {
-  unsigned error_count, warning_count;
+  std::atomic<unsigned> error_count, warning_count;
+  /// The least severe level of message to print; by default, all of them.
+  ErrorLevel least_severe = INFO;
+  /// The most errors and warnings to print, after which no more messages
+  /// are built, printed or counted. Zero, the default, prints them all.
+  unsigned max_count = 0;
+  /// Wants messages of \c least_severe or worse, until \c max_count.
+  bool wants(ErrorLevel level) const override;
   /// Prints the error to stderr, in the format
   /// `ERROR[(<file>[:<line>[:<pos>]])]: <error string>`
   virtual void error(std::string_view msg, SourceLocation code_point);
@@ -187,5 +240,53 @@ struct DefaultErrorHandler: ErrorHandler {
 /// A pointer to an instance of \c DefaultErrorHandler, for use wherever.
 extern DefaultErrorHandler *default_error_handler;
 
+/** Collapses repeated messages before passing them on to another handler.
+    Messages are repeats when they have the same level, text and location,
+    as happens when one macro expands to the same bad code many times. The
+    first of each is held, then passed on with the others held with it in
+    a batch; repeats are only counted, and their number passed on as info
+    with the next batch.
+**/
+class AggregatingErrorHandler: public ErrorHandler {
+ public:
+  void error(std::string_view err, SourceLocation code_point) override;
+  void warning(std::string_view err, SourceLocation code_point) override;
+  void info(std::string_view err, int verbosity,
+            SourceLocation code_point) override;
+  /// Wants whatever the handler we pass messages to wants.
+  bool wants(ErrorLevel level) const override { return target->wants(level); }
+
+  /// Pass on the held messages, and the counts of any new repeats.
+  void flush();
+
+  /// Construct, passing messages to the given handler in batches of the
+  /// given number of distinct messages.
+  explicit AggregatingErrorHandler(ErrorHandler *target, size_t batch = 64);
+  /// Flushes any held messages.
+  ~AggregatingErrorHandler() override;
+
+ private:
+  struct held {
+    ErrorLevel level;
+    std::string message;
+    SourceLocation where;
+    int verbosity;
+    size_t repeats = 0; ///< Repeats seen since this was last passed on.
+  };
+  /// Identifies repeated messages: level, location and text.
+  using key = std::tuple<int, uint32_t, size_t, size_t, std::string>;
+
+  void add(ErrorLevel level, std::string_view msg, int verbosity,
+           const SourceLocation &where);
+
+  ErrorHandler *target; ///< The handler to which we pass messages.
+  size_t batch;         ///< The number of new messages we hold at most.
+  std::mutex lock;      ///< Guards everything below.
+  std::map<key, size_t> seen;  ///< Every distinct message, by its index in \c messages.
+  std::vector<held> messages;  ///< Every distinct message, in order.
+  size_t passed = 0;    ///< The number of \c messages passed on.
+  std::vector<size_t> repeated; ///< Messages passed on, then repeated since.
+};
+
 }  // namespace
 #endif  // JDI_ERROR_REPORTING_h
@@ -0,0 +1,156 @@
+/**
+ * @file  incremental.cpp
+ * @brief Source implementing incremental reparsing of a translation unit.
+ *
+ * See the header documentation for details on behavior and usage.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "incremental.h"
+#include <System/builtins.h>
+#include <System/lex_cpp.h>
+
+using namespace jdi;
+using std::filesystem::path;
+
+namespace {
+
+/// Swallows the errors of our prescan; the parse proper will report them.
+struct QuietErrorHandler: ErrorHandler {
+  void error(std::string_view, SourceLocation) override {}
+  void warning(std::string_view, SourceLocation) override {}
+  void info(std::string_view, int, SourceLocation) override {}
+};
+
+/// Canonicalize a path for comparison, keeping it as-is if that fails.
+path canonical_or_same(const path &p) {
+  std::error_code ec;
+  path res = std::filesystem::weakly_canonical(p, ec);
+  return ec ? p : res;
+}
+
+}  // namespace
+
+/// Finds where the main file may be split: the start of each line holding an
+/// #include made at file scope and outside any conditional. This reads raw
+/// tokens only; a macro which expands to a brace will throw it off, but the
+/// worst that can do is put a split where the parse can't resume cleanly.
+static void find_pieces(const string &text, const string &name,
+                        vector<IncrementalParse::Piece> &pieces) {
+  QuietErrorHandler quiet;
+  llreader read(name, text, false);
+  pieces.push_back({0, llreader::kFirstLine, {}, nullptr});
+
+  size_t braces = 0, conditionals = 0;
+  for (token_t tok; (tok = read_token(read, &quiet)).type != TT_ENDOFCODE; ) {
+    if (tok.type == TT_LEFTBRACE) ++braces;
+    else if (tok.type == TT_RIGHTBRACE) braces -= braces > 0;
+    if (tok.type != TTM_TOSTRING) continue;
+
+    const size_t offset = read.lpos, line = read.lnum;
+    token_t directive;
+    do directive = read_token(read, &quiet);
+    while (directive.type == TTM_WHITESPACE);
+    string_view dname;
+    if (directive.type == TT_IDENTIFIER) dname = directive.content.view();
+
+    if (dname == "if" || dname == "ifdef" || dname == "ifndef") {
+      ++conditionals;
+    } else if (dname == "endif") {
+      conditionals -= conditionals > 0;
+    } else if (dname == "include" && !braces && !conditionals && offset) {
+      pieces.push_back({offset, line, {}, nullptr});
+    }
+
+    // Skip the rest of the directive, including escaped newlines.
+    while (!read.eof() && !read.at_newline()) {
+      if (read.at() == '\\' && read.advance() && read.at_newline())
+        read.take_newline();
+      else
+        read.advance();
+    }
+  }
+}
+
+IncrementalParse::IncrementalParse(path main_file_, ErrorHandler *herr_,
+                                   Context *base_):
+    main_file(std::move(main_file_)), herr(herr_),
+    base(base_? base_ : &builtin_context()) {}
+
+const Context &IncrementalParse::context() const {
+  return pieces_.empty() || !pieces_.back().context
+      ? *base : *pieces_.back().context;
+}
+
+int IncrementalParse::parse() {
+  // Each piece's context is layered over the last; drop them last to first.
+  while (!pieces_.empty()) pieces_.pop_back();
+  reparsed_from_ = 0;
+  base->freeze();
+
+  llreader file(main_file);
+  if (!file.is_open()) {
+    herr->error({main_file.string(), SourceLocation::npos, SourceLocation::npos})
+        << "Could not open file for parsing";
+    return -1;
+  }
+  text.assign(file.data, file.length);
+  find_pieces(text, main_file.string(), pieces_);
+  return parse_from(0);
+}
+
+int IncrementalParse::reparse(const path &changed) {
+  const path target = canonical_or_same(changed);
+  if (pieces_.empty() || target == canonical_or_same(main_file))
+    return parse();
+  for (size_t i = 0; i < pieces_.size(); ++i)
+    if (pieces_[i].files.count(target))
+      return parse_from(i);
+  reparsed_from_ = pieces_.size();
+  return 0;
+}
+
+int IncrementalParse::parse_from(size_t first) {
+  for (size_t i = pieces_.size(); i-- > first; ) {
+    pieces_[i].context.reset();
+    pieces_[i].files.clear();
+  }
+  reparsed_from_ = first;
+
+  int res = 0;
+  for (size_t i = first; i < pieces_.size(); ++i) {
+    Piece &piece = pieces_[i];
+    piece.context = std::make_unique<Context>(
+        i ? *pieces_[i - 1].context : *base, herr);
+
+    llreader read(main_file.string(), text, false);
+    read.pos = read.lpos = piece.offset;
+    read.lnum = piece.line;
+    if (i + 1 < pieces_.size())
+      read.length = pieces_[i + 1].offset;
+    if (int err = piece.context->parse_stream(read))
+      res = err;
+
+    // The next piece reads this one's definitions and instantiations as a
+    // checkpoint, so nothing after may change them.
+    piece.context->freeze();
+    for (const string &file : piece.context->get_included_files())
+      if (!file.empty()) piece.files.insert(canonical_or_same(file));
+  }
+  return res;
+}
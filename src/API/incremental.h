@@ -0,0 +1,113 @@
+/**
+ * @file incremental.h
+ * @brief Header declaring a means of reparsing a translation unit in part.
+ *
+ * An editor which wants up-to-date definitions while the user works can't
+ * afford to parse the whole translation unit over each time a header changes.
+ * Instead, the main file is parsed in pieces, split at the \c #include
+ * directives it makes at file scope. Each piece is parsed into a context
+ * layered over that of the piece before it, which is then frozen; each frozen
+ * context is thus a checkpoint, holding the macros and declarations as of the
+ * include which starts the next piece. When a file changes, the pieces from
+ * the first one to include it onward are dropped and parsed again, over the
+ * checkpoint before them.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _JDI_INCREMENTAL__H
+#define _JDI_INCREMENTAL__H
+
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <API/context.h>
+
+namespace jdi {
+
+/**
+  A translation unit parsed so that it can be cheaply reparsed after one of
+  the files it includes changes.
+
+  The main file is only split where it is at file scope and outside any
+  conditional; includes within a namespace, an \c extern "C" block, or an
+  \c #if (including a whole-file include guard) stay within one piece.
+  Because each piece is parsed over its frozen predecessor, it behaves as a
+  layered context does: it may not complete a class declared incomplete by an
+  earlier piece, nor add overloads to its functions; it declares its own.
+**/
+class IncrementalParse {
+ public:
+  /** One stretch of the main file, parsed into a context of its own. */
+  struct Piece {
+    size_t offset; ///< Where this piece begins in the main file.
+    size_t line;   ///< The line on which this piece begins.
+    /// The files this piece included, by canonical path.
+    std::set<std::filesystem::path> files;
+    /// The context this piece was parsed into; frozen once parsed.
+    std::unique_ptr<Context> context;
+  };
+
+  /** Set up to parse the given file; nothing is read until \c parse().
+      @param main_file  The file to parse, which #includes the rest.
+      @param herr       The error handler given to each piece's context.
+      @param base       The context to parse over, or null to use the builtin
+                        context. It is frozen by \c parse().
+  **/
+  IncrementalParse(std::filesystem::path main_file,
+                   ErrorHandler *herr = default_error_handler,
+                   Context *base = nullptr);
+
+  /** Read and split the main file, then parse every piece of it.
+      @return Nonzero if any piece failed to parse, as \c parse_stream. */
+  int parse();
+
+  /** Bring the definitions up to date after a file has changed. If it is the
+      main file, everything is parsed again; otherwise, only the pieces from
+      the first to include it. If no piece included it, nothing is done.
+      @param changed  The path of the file which changed.
+      @return Nonzero if any piece failed to parse, as \c parse_stream. */
+  int reparse(const std::filesystem::path &changed);
+
+  /// Get the context holding the definitions of the whole translation unit;
+  /// that of the last piece, which is frozen like the rest.
+  const Context &context() const;
+  /// Get the pieces the main file was split into, in order.
+  const std::vector<Piece> &pieces() const { return pieces_; }
+  /// Get the index of the first piece parsed by the last call to \c parse()
+  /// or \c reparse(); equal to the number of pieces if none was parsed.
+  size_t reparsed_from() const { return reparsed_from_; }
+
+ private:
+  std::filesystem::path main_file;
+  ErrorHandler *herr;
+  Context *base;
+  /// The text of the main file, which each piece's reader aliases.
+  std::string text;
+  std::vector<Piece> pieces_;
+  size_t reparsed_from_ = 0;
+
+  /// Drop the pieces from the given index onward, then parse them again.
+  int parse_from(size_t first);
+};
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * @file  parse_stats.cpp
+ * @brief Source implementing the record of where the time of a parse goes.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "parse_stats.h"
+
+#include <sstream>
+
+namespace jdi {
+
+static thread_local ParseStats *current_stats = nullptr;
+
+ParseStats::duration ParseStats::total() const {
+  duration res {};
+  for (const duration &t : time) res += t;
+  return res;
+}
+
+const char *ParseStats::phase_name(Phase phase) {
+  switch (phase) {
+    case LEXING:        return "lexing";
+    case DIRECTIVES:    return "directives";
+    case MACROS:        return "macros";
+    case PARSING:       return "parsing";
+    case INSTANTIATION: return "instantiation";
+    case EVALUATION:    return "evaluation";
+    case PHASE_COUNT: default: return "unknown";
+  }
+}
+
+std::string ParseStats::to_json() const {
+  using seconds = std::chrono::duration<double>;
+  std::ostringstream res;
+  res.precision(9);
+  res << std::fixed << "{\"seconds\": {";
+  for (int i = 0; i < PHASE_COUNT; ++i) {
+    res << '"' << phase_name(Phase(i)) << "\": "
+        << seconds(time[i]).count() << ", ";
+  }
+  res << "\"total\": " << seconds(total()).count() << "}"
+      << ", \"files_opened\": " << files_opened
+      << ", \"bytes_mapped\": " << bytes_mapped
+      << ", \"tokens\": " << tokens
+      << ", \"macros_expanded\": " << macros_expanded
+      << ", \"lookups\": " << lookups
+      << ", \"instantiations\": " << instantiations << "}";
+  return res.str();
+}
+
+ParseStats *ParseStats::current() {
+  return current_stats;
+}
+ParseStats::use::use(ParseStats *stats): previous(current_stats) {
+  current_stats = stats;
+}
+ParseStats::use::~use() {
+  current_stats = previous;
+}
+
+int ParseStats::enter(int next) {
+  const auto now = std::chrono::steady_clock::now();
+  if (phase >= 0) time[phase] += now - since;
+  since = now;
+  const int prev = phase;
+  phase = next;
+  return prev;
+}
+
+ParseStats::timer::timer(Phase phase): stats(current_stats), outer(-1) {
+  if (stats) outer = stats->enter(phase);
+}
+ParseStats::timer::~timer() {
+  if (stats) stats->enter(outer);
+}
+
+}  // namespace jdi
@@ -0,0 +1,122 @@
+/**
+ * @file  parse_stats.h
+ * @brief Header declaring a record of where the time of a parse goes.
+ *
+ * A parse of a large header set spends its time in a handful of places: the
+ * lexer, the preprocessor, the parser proper, template instantiation, and the
+ * evaluation of constant expressions. Finding out which of these regressed
+ * shouldn't take a profiling build. A context given a \c ParseStats fills it
+ * in as it parses, with the time spent in each of those places and counts of
+ * the work done there.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _JDI_PARSE_STATS__H
+#define _JDI_PARSE_STATS__H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace jdi {
+
+/**
+  Timings and counters collected while parsing. Set one on a context with
+  \c Context::set_stats(); each call to \c Context::parse_stream() then adds
+  to it. Assign a default-constructed \c ParseStats to start over.
+
+  Time is charged to the innermost phase running, so that a macro expanded
+  while a template argument is evaluated counts only toward \c MACROS, and the
+  phase times add up to the time spent in \c parse_stream(). A \c ParseStats
+  may only be filled by one parse at a time.
+**/
+struct ParseStats {
+  /// The places a parse spends its time.
+  enum Phase {
+    LEXING,        ///< Reading raw tokens from source, in \c read_token().
+    DIRECTIVES,    ///< Handling preprocessor directives, but not their tokens.
+    MACROS,        ///< Finding and expanding macros.
+    PARSING,       ///< Parsing declarations; anything not charged elsewhere.
+    INSTANTIATION, ///< Instantiating templates.
+    EVALUATION,    ///< Evaluating stored expressions, such as enum values.
+    PHASE_COUNT    ///< The number of phases above.
+  };
+  using duration = std::chrono::steady_clock::duration;
+
+  /// The time spent in each phase, indexed by \c Phase.
+  std::array<duration, PHASE_COUNT> time {};
+
+  size_t files_opened = 0;    ///< Files read, including the one parsed.
+  size_t bytes_mapped = 0;    ///< The total size of those files.
+  size_t tokens = 0;          ///< Raw tokens read from source.
+  size_t macros_expanded = 0; ///< Macros and macro functions expanded.
+  size_t lookups = 0;         ///< Names the parser looked up in scopes.
+  size_t instantiations = 0;  ///< Templates newly instantiated.
+
+  /// Returns the sum of the phase times.
+  duration total() const;
+  /// Returns the name of the given phase, as used in \c to_json().
+  static const char *phase_name(Phase phase);
+  /// Returns these statistics as a JSON object, with times in seconds.
+  std::string to_json() const;
+
+  /// Returns the statistics being filled on the calling thread, or null.
+  static ParseStats *current();
+  /// Adds \p n to the given counter of the statistics being filled on the
+  /// calling thread, if any.
+  static void count(size_t ParseStats::*counter, size_t n = 1) {
+    if (ParseStats *stats = current()) stats->*counter += n;
+  }
+
+  /// Directs the calling thread to fill the given statistics, which may be
+  /// null, for the lifetime of this object.
+  class use {
+    ParseStats *previous;
+   public:
+    use(ParseStats *stats);
+    ~use();
+    use(const use&) = delete;
+  };
+
+  /// Charges the time from its construction to its destruction to the given
+  /// phase of the statistics being filled on the calling thread, if any.
+  /// Timers nest; an inner timer pauses the one outside it.
+  class timer {
+    ParseStats *stats;
+    int outer;
+   public:
+    timer(Phase phase);
+    ~timer();
+    timer(const timer&) = delete;
+  };
+
+ private:
+  /// The phase being timed, or -1 if none.
+  int phase = -1;
+  /// When time was last charged to a phase.
+  std::chrono::steady_clock::time_point since;
+
+  /// Charge the time since \c since to the current phase, then switch to the
+  /// given one. Returns the phase switched from.
+  int enter(int next);
+};
+
+}  // namespace jdi
+
+#endif  // _JDI_PARSE_STATS__H
@@ -0,0 +1,138 @@
+/**
+ * @file  parse_trace.cpp
+ * @brief Source implementing the timeline of a parse, for trace viewers.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "parse_trace.h"
+
+#include <cstdio>
+#include <sstream>
+
+namespace jdi {
+
+static thread_local ParseTrace *current_trace = nullptr;
+
+ParseTrace::ParseTrace(): origin(clock::now()) {}
+
+const char *ParseTrace::category_name(Category category) {
+  switch (category) {
+    case SOURCE_FILE:   return "file";
+    case DECLARATION:   return "declaration";
+    case INSTANTIATION: return "instantiation";
+    default:            return "unknown";
+  }
+}
+
+size_t ParseTrace::begin(Category category, std::string name, bool named) {
+  Event &ev = events_.emplace_back();
+  ev.name = std::move(name);
+  ev.category = category;
+  ev.begin = clock::now() - origin;
+  ev.named = named;
+  open_.push_back(events_.size() - 1);
+  return events_.size() - 1;
+}
+
+void ParseTrace::end(size_t index) {
+  Event &ev = events_[index];
+  ev.length = clock::now() - origin - ev.begin;
+  ev.ended = true;
+  for (size_t i = open_.size(); i--; ) {
+    if (open_[i] == index) {
+      open_.erase(open_.begin() + i);
+      break;
+    }
+  }
+}
+
+void ParseTrace::name_open(Category category, const std::string &name) {
+  for (size_t i = open_.size(); i--; ) {
+    Event &ev = events_[open_[i]];
+    if (ev.category != category) continue;
+    if (!ev.named) ev.name = name, ev.named = true;
+    return;
+  }
+}
+
+/// Writes the given string as a JSON string literal.
+static void write_string(std::ostream &out, const std::string &str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if ((unsigned char) c < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out << esc;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+void ParseTrace::write_json(std::ostream &out) const {
+  using micros = std::chrono::duration<double, std::micro>;
+  const std::ios_base::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision(3);
+  out << std::fixed << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  bool first = true;
+  for (const Event &ev : events_) {
+    out << (first ? "\n" : ",\n") << "{\"name\": ";
+    first = false;
+    write_string(out, ev.name);
+    out << ", \"cat\": \"" << category_name(ev.category) << "\", \"ph\": \""
+        << (ev.ended ? 'X' : 'B') << "\", \"ts\": " << micros(ev.begin).count();
+    if (ev.ended) out << ", \"dur\": " << micros(ev.length).count();
+    out << ", \"pid\": 1, \"tid\": 1}";
+  }
+  out << "\n]}\n";
+  out.flags(flags);
+  out.precision(precision);
+}
+
+std::string ParseTrace::to_json() const {
+  std::ostringstream res;
+  write_json(res);
+  return res.str();
+}
+
+ParseTrace *ParseTrace::current() {
+  return current_trace;
+}
+ParseTrace::use::use(ParseTrace *trace): previous(current_trace) {
+  current_trace = trace;
+}
+ParseTrace::use::~use() {
+  current_trace = previous;
+}
+
+void ParseTrace::span::open(ParseTrace *trace_, Category category,
+                            std::string name, bool named) {
+  if (!trace_ || trace) return;
+  trace = trace_;
+  index = trace->begin(category, std::move(name), named);
+}
+void ParseTrace::span::close() {
+  if (!trace) return;
+  trace->end(index);
+  trace = nullptr;
+}
+
+}  // namespace jdi
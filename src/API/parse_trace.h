@@ -0,0 +1,129 @@
+/**
+ * @file  parse_trace.h
+ * @brief Header declaring a timeline of a parse, for trace viewers.
+ *
+ * Knowing that a parse spent its time instantiating templates doesn't say
+ * which templates, nor which headers brought them in. A context given a
+ * \c ParseTrace records a span for each file it reads, each declaration it
+ * parses at namespace scope, and each template it instantiates, nested as
+ * they happened. The result is written in the Chrome \c trace_event format,
+ * which Perfetto and \c chrome://tracing open as a flame chart showing the
+ * inclusive and self time of every header and instantiation.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _JDI_PARSE_TRACE__H
+#define _JDI_PARSE_TRACE__H
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace jdi {
+
+/**
+  Spans of time recorded while parsing. Set one on a context with
+  \c Context::set_trace(); each call to \c Context::parse_stream() then adds
+  its spans to it. A \c ParseTrace may only be filled by one parse at a time.
+**/
+class ParseTrace {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  /// The kinds of span recorded by the parser.
+  enum Category {
+    SOURCE_FILE,   ///< A file being read, from when it is entered until left.
+    DECLARATION,   ///< A declaration at namespace scope.
+    INSTANTIATION  ///< A template being instantiated.
+  };
+  /// Returns the name of the given category, as written to JSON.
+  static const char *category_name(Category category);
+
+  /// One span of time.
+  struct Event {
+    std::string name;     ///< What was being done, such as a file name.
+    Category category;    ///< What kind of span this is.
+    clock::duration begin;  ///< When the span began, after the trace did.
+    clock::duration length; ///< How long it lasted, if it has ended.
+    bool ended = false;   ///< Whether the span has ended.
+    bool named = true;    ///< False until a provisional name is replaced.
+  };
+
+  /// Begin a trace; event times are kept relative to this call.
+  ParseTrace();
+
+  /// Begin a span, returning its index among the events. A span named
+  /// provisionally, with \p named false, may be renamed by \c name_open().
+  size_t begin(Category category, std::string name, bool named = true);
+  /// End the span with the given index, returned by \c begin().
+  void end(size_t index);
+  /// Gives the innermost unended span of the given category the given name,
+  /// if its name is provisional.
+  void name_open(Category category, const std::string &name);
+
+  /// Returns the recorded spans, in the order they began.
+  const std::vector<Event> &events() const { return events_; }
+
+  /// Writes the spans in the Chrome trace_event JSON format. Spans which
+  /// never ended, as when a parse is abandoned, are written as begun only.
+  void write_json(std::ostream &out) const;
+  /// Returns the spans in the Chrome trace_event JSON format.
+  std::string to_json() const;
+
+  /// Returns the trace being filled on the calling thread, or null.
+  static ParseTrace *current();
+
+  /// Directs the calling thread to fill the given trace, which may be null,
+  /// for the lifetime of this object.
+  class use {
+    ParseTrace *previous;
+   public:
+    use(ParseTrace *trace);
+    ~use();
+    use(const use&) = delete;
+  };
+
+  /// A span ended when this object is closed or destroyed.
+  class span {
+    ParseTrace *trace = nullptr;
+    size_t index = 0;
+   public:
+    span() = default;
+    /// Begin a span in the given trace, if it is not null and this span
+    /// is not already open.
+    void open(ParseTrace *trace_, Category category, std::string name,
+              bool named = true);
+    /// End the span, if it is open.
+    void close();
+    /// Returns whether the span is open.
+    bool is_open() const { return trace != nullptr; }
+    ~span() { close(); }
+    span(const span&) = delete;
+  };
+
+ private:
+  clock::time_point origin;  ///< When this trace began.
+  std::vector<Event> events_; ///< The spans, in the order they began.
+  std::vector<size_t> open_;  ///< Indices of the unended spans, in order.
+};
+
+}  // namespace jdi
+
+#endif  // _JDI_PARSE_TRACE__H
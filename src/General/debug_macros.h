@@ -62,7 +62,7 @@ class RecursionHelper {
 #define MACROCAT(x, y) SUPERMACROCAT(x, y)
 #define SET_MAXIMUM_RECURSIONS(k)                                              \
   constexpr size_t MACROCAT(max_recursions_, __LINE__) = (k);                  \
-  static size_t MACROCAT(current_recursions_, __LINE__) = 0;                   \
+  static thread_local size_t MACROCAT(current_recursions_, __LINE__) = 0;      \
   jdi_debug::RecursionHelper MACROCAT(recursion_helper_, __LINE__)(            \
       MACROCAT(current_recursions_, __LINE__),                                 \
       MACROCAT(max_recursions_, __LINE__))
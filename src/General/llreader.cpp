@@ -25,6 +25,7 @@
 **/
 
 #include "llreader.h"
+#include <API/error_reporting.h>
 
 #include <cstdio>
 #include <cstring>
@@ -254,6 +255,14 @@ bool llreader::is_open() const {
   return mode != FT_CLOSED;
 }
 
+uint32_t llreader::get_file_id() const {
+  if (name != id_name) {
+    id = jdi::FileTable::id_of(name);
+    id_name = name;
+  }
+  return id;
+}
+
 void llreader::skip_whitespace() {
   while (pos < length) switch (data[pos]) {
     case '\r': {
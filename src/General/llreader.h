@@ -38,6 +38,7 @@
 #ifndef _LLREADER__H
 #define _LLREADER__H
 
+#include <cstdint>
 #include <string>
 #include <filesystem>
 
@@ -59,11 +60,17 @@ class llreader {
 # endif
 
   const std::string &get_filename() const { return name; }
+  /// Returns the ID of \c name in \c jdi::FileTable, numbering it if needed.
+  uint32_t get_file_id() const;
   size_t get_line_number() const { return lnum; }
   size_t get_line_position() const { return pos - lpos; }
 
  private:
   int mode; ///< What kind of stream we have open
+  /// The name whose ID was last looked up, and that ID; lets tokens be given
+  /// an ID without hashing the name each time.
+  mutable std::string id_name;
+  mutable uint32_t id = 0;
 
  public:
   /**
@@ -0,0 +1,68 @@
+/**
+ * @file  quickarena.h
+ * @brief A file implementing a simple region allocator.
+ *
+ * @section License
+ *
+ * Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef _QUICKARENA__H
+#define _QUICKARENA__H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace quick {
+  /** A region allocator. Memory is handed out in order from a few large
+      blocks, and is only given back all at once, when the arena is destroyed.
+      Nothing allocated here is destructed by the arena.
+  **/
+  class arena {
+    std::vector<std::unique_ptr<char[]>> blocks; ///< Every block we allocated.
+    char *top = nullptr; ///< The next free byte in the newest block.
+    size_t left = 0;     ///< The number of free bytes after \c top.
+    size_t next_size;    ///< The size of the next block to allocate.
+    /// Blocks stop growing once they reach this size.
+    static constexpr size_t max_block = 16384;
+
+   public:
+    /// Every allocation is aligned to this boundary.
+    static constexpr size_t alignment = alignof(std::max_align_t);
+
+    /** Allocate the given number of bytes, aligned to \c alignment. **/
+    void *allocate(size_t size) {
+      size = (size + alignment - 1) & ~(alignment - 1);
+      if (size > left) {
+        const size_t bsize = size > next_size ? size : next_size;
+        blocks.emplace_back(new char[bsize]);
+        top = blocks.back().get();
+        left = bsize;
+        if (next_size < max_block) next_size *= 2;
+      }
+      void *res = top;
+      top += size, left -= size;
+      return res;
+    }
+
+    /** Construct, giving the size of the first block to allocate; each block
+        after it is twice the size of the last, up to a limit. **/
+    arena(size_t first_block = 256): next_size(first_block) {}
+    arena(const arena&) = delete;
+  };
+}
+
+#endif
@@ -223,7 +223,7 @@ template<class OS, typename T> std::ostream &put(OS &os, const T &x) {
 // =============================================================================
 
 template<typename T> struct PrettyQuote {
-  const T &obj;
+  T obj;
   operator std::string() {
     return "`" + string_detection::to_string(obj) + "`";
   }
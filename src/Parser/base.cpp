@@ -48,8 +48,24 @@ int jdi::Context::parse_stream(llreader &cfile) {
   if (!herr)
     herr = default_error_handler;
   
+  if (frozen) {
+    herr->error(cfile) << "Attempted to parse into a frozen context";
+    return -1;
+  }
+  
   int res;
   {
+    // Templates in a frozen base instantiate into our store, not the thread's.
+    frozen_instantiations::use use_ours(*instances);
+    ParseStats::use use_stats(stats);
+    ParseStats::timer parsing(ParseStats::PARSING);
+    ParseTrace::use use_trace(trace);
+    ParseTrace::span file;
+    file.open(trace, ParseTrace::SOURCE_FILE, cfile.name);
+    if (stats && cfile.is_open()) {
+      ++stats->files_opened;
+      stats->bytes_mapped += cfile.length;
+    }
     context_parser cp(this, cfile);
     token_t eoc; // An invalid token to appease the parameter chain.
     res = cp.handle_scope(global.get(), eoc);
@@ -72,6 +88,8 @@ int jdi::Context::parse_stream(llreader &cfile) {
         cp.handle_scope(global.get(), eoc);
       #endif
     }
+    const set<string> &visited = cp.get_lex()->get_visited_files();
+    included_files.insert(visited.begin(), visited.end());
   }
   
   return res;
@@ -28,6 +28,8 @@
 # error Define def_kind and DEF_FLAG to use this header.
 #else
 
+#include <atomic>
+
 #define stringify(x) #x
 #define sewtogether(x, y) x ## y
 #define gcchax_cat(x, y) sewtogether(x, y)
@@ -54,7 +56,7 @@ static inline definition_name* insnew(definition_scope *scope, int inherited_fla
 }
 
 
-static unsigned anon_count = 1;
+static std::atomic<unsigned> anon_count(1);
 static inline int get_location(definition_name* &nclass, bool &will_redeclare, bool &already_complete, token_t &token, string &classname, definition_scope *scope, context_parser * const cp, ErrorHandler *const herr) {
   if (token.type == TT_IDENTIFIER) {
     classname = token.content.toString();
@@ -82,6 +84,7 @@ static inline int get_location(definition_name* &nclass, bool &will_redeclare, b
   }
 
   for (definition_scope *s = scope; s; s = s->parent) {
+    s->undefer();
     definition_scope::defiter it = s->c_structs.find(classname);
     if (it != s->c_structs.end()) {
       if (it->second->flags & DEF_FLAG) {
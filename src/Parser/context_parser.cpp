@@ -21,14 +21,16 @@
 
 #include "context_parser.h"
 #include <API/AST.h>
+#include <API/parse_trace.h>
 
 #include <iostream>
 using std::cerr; using std::endl;
 
 namespace jdi {
   context_parser::context_parser(Context *ctex_, llreader &cfile):
-      ctex(ctex_), lex(new lexer(cfile, ctex_->macros, ctex_->herr)),
-      herr(ctex_->herr), astbuilder(new AST_Builder(this)) {
+      ctex(ctex_), lex(new lexer(cfile, ctex_->macros, ctex_->herr, ctex_)),
+      herr(ctex_->herr), astbuilder(new AST_Builder(this)),
+      observer(ctex_->observer), filter(ctex_->filter) {
     if (ctex->parse_open) {
       cerr << "Another parser is already active on this context." << endl;
       abort();
@@ -38,7 +40,8 @@ namespace jdi {
   }
   context_parser::context_parser(Context *ctex_, lexer *lex_):
       ctex(ctex_), lex(lex_),
-      herr(lex_->get_error_handler()), astbuilder(new AST_Builder(this)) {
+      herr(lex_->get_error_handler()), astbuilder(new AST_Builder(this)),
+      observer(ctex_->observer), filter(ctex_->filter) {
     if (ctex->parse_open) {
       cerr << "Another parser is already active on this context." << endl;
       abort();
@@ -57,4 +60,85 @@ namespace jdi {
       }
     }
   }
+
+  SourceLocation context_parser::mark(const token_t &token) const {
+    if (!observer && !filter) return SourceLocation({}, 0, 0);
+    return SourceLocation(token);
+  }
+  /// If the parse is being traced and the given definition belongs to a
+  /// namespace, names the span of the declaration being parsed for it; see
+  /// handle_scope().
+  static void name_traced(const definition *def) {
+    ParseTrace *trace = ParseTrace::current();
+    if (trace && def->parent && !(def->parent->flags & (DEF_CLASS | DEF_UNION)))
+      trace->name_open(ParseTrace::DECLARATION, def->qualified_id());
+  }
+  void context_parser::declared(definition *def, const SourceLocation &begin,
+                                const token_t &end) {
+    if (!def) return;
+    name_traced(def);
+    if (!observer && !filter) return;
+    const SourceRange range{begin, end};
+    if (observer) observer->declared(def, range);
+    if (!filter) return;
+
+    // Only functions can go. Overload resolution in a later sizeof or
+    // decltype will no longer see them; see DeclarationFilter.
+    const definition *ovr = def;
+    if ((def->flags & DEF_TEMPLATE) && ((definition_template*) def)->def)
+      ovr = ((definition_template*) def)->def.get();
+    if (!(ovr->flags & DEF_OVERLOAD) || filter->keeps(def, range)) return;
+    for (const definition *redec : redeclarations)
+      if (redec == def) return;
+    filtered.push_back({ovr->parent, ovr->name, def});
+  }
+  /// Finds the given name in a scope of a base context which the given scope
+  /// overlays, directly or through the overlays of other bases.
+  static definition *find_hidden(definition_scope *scope,
+                                 const string &name) {
+    for (definition_scope *used : scope->using_scopes) {
+      if (used->name != scope->name) continue;
+      if (definition *found = used->find_local(name)) return found;
+      if (definition *found = find_hidden(used, name)) return found;
+    }
+    return nullptr;
+  }
+  void context_parser::inherit_overloads(definition_scope *scope,
+                                         definition_function *func,
+                                         const token_t &token) {
+    if (!ctex->get_base()) return;
+    definition *hidden = find_hidden(scope, func->name);
+    if (hidden && (hidden->flags & DEF_FUNCTION) && !ctex->owns(hidden))
+      func->inherit((definition_function*) hidden, herr->at(token));
+  }
+  void context_parser::declared_before_body(
+      definition *def, const SourceLocation &begin, const token_t &end) {
+    body_owner = nullptr;
+    if (end.type != TT_LEFTBRACE && end.type != TT_ASM)
+      return declared(def, begin, end);
+    if (def) name_traced(def);
+    if (!observer && !filter) return;
+    body_owner = def;
+    body_begin = begin;
+  }
+  void context_parser::body_skipped(const token_t &end) {
+    definition *const def = body_owner;
+    body_owner = nullptr;
+    if (end.type == TT_RIGHTBRACE || end.type == TT_SEMICOLON)
+      declared(def, body_begin, end);
+  }
+  void context_parser::redeclared(const definition *ovr, bool created) {
+    if (filter && ovr && !created) redeclarations.push_back(ovr);
+  }
+  void context_parser::discard_filtered(definition_scope *scope) {
+    for (const filtered_declaration &fd : filtered) {
+      if (fd.scope != scope) continue;
+      definition_scope::defiter it = scope->members.find(fd.name);
+      if (it != scope->members.end() && it->second &&
+          (it->second->flags & DEF_FUNCTION))
+        ((definition_function*) it->second.get())->discard(fd.def);
+    }
+    filtered.clear();
+    redeclarations.clear();
+  }
 }
@@ -95,6 +95,25 @@ class context_parser {
   lexer *lex;  ///< The lexer which all methods and all calls therefrom will poll for tokens.
   ErrorHandler *herr;  ///< The error handler to which errors and warnings will be reported.
   AST_Builder *astbuilder;  ///< Used to build ASTs at any time during parse.
+  DeclarationObserver *observer;  ///< Told of each completed declaration, if set.
+  const DeclarationFilter *filter;  ///< Decides which declarations to keep, if set.
+  /// A declaration the filter rejected, to be discarded from its function
+  /// once the statement declaring it has been parsed.
+  struct filtered_declaration {
+    definition_scope *scope;  ///< The scope declaring the function.
+    string name;              ///< The name of the function.
+    definition *def;          ///< The overload or template to discard.
+  };
+  /// Declarations the filter rejected in the statement being parsed.
+  vector<filtered_declaration> filtered;
+  /// Overloads the statement being parsed declares again; the filter never
+  /// discards these, as an earlier declaration may have kept them.
+  vector<const definition*> redeclarations;
+  /// A declaration followed by a function body, which is reported once the
+  /// body has been skipped; see \c declared_before_body().
+  definition *body_owner = nullptr;
+  /// Where the declaration in \c body_owner began.
+  SourceLocation body_begin{{}, 0, 0};
   friend class jdi::AST_Builder;
 
  public:
@@ -102,6 +121,36 @@ class context_parser {
   inline AST_Builder *get_AST_builder() const { return astbuilder; }
   inline ErrorHandler *get_herr() const { return herr; }
 
+  /// Returns where the given token begins if declarations are being observed
+  /// or filtered; otherwise, returns an empty location, to spare copying the
+  /// file name.
+  SourceLocation mark(const token_t &token) const;
+  /// Tells the observer, if any, that the given declaration is complete, and
+  /// notes it to be discarded if it is a function the filter rejects.
+  /// @param def    The declared definition; if null, nothing is reported.
+  /// @param begin  Where the declaration began, as returned by \c mark().
+  /// @param end    The token closing the declaration.
+  void declared(definition *def, const SourceLocation &begin,
+                const token_t &end);
+  /// As \c declared(), unless \p end opens a function body; the declaration
+  /// is then reported by \c body_skipped(), so that its range spans the body.
+  void declared_before_body(definition *def, const SourceLocation &begin,
+                            const token_t &end);
+  /// Reports the declaration whose body was just skipped, if any, ending it
+  /// at the given token.
+  void body_skipped(const token_t &end);
+  /// Copies into a function just declared in the given scope the overloads
+  /// it hides in the scope of a base context which that scope overlays.
+  void inherit_overloads(definition_scope *scope, definition_function *func,
+                         const token_t &token);
+  /// Notes that the statement being parsed declared the given overload
+  /// again, unless it was just created; see \c redeclarations.
+  void redeclared(const definition *ovr, bool created);
+  /// Discards the declarations the filter rejected from the given scope; to
+  /// be called between statements, once nothing refers to them.
+  /// Rejected declarations from any other scope are kept.
+  void discard_filtered(definition_scope *scope);
+
   /// Constructs, temporarily consuming a context. Do not use the input
   /// context while this parser is active.
   context_parser(Context* ctex, llreader &cfile);
@@ -384,12 +433,15 @@ class context_parser {
                    toasted if a comma is encountered. [in-out]
     @param inherited_flags Flags to assign to each declared definition.
     @param res     A pointer to receive the last definition declared. [out]
+    @param begin   Where the declaration began, as returned by \c mark(), to
+                   report to the observer; if null, where \p token does. [in]
 
     @return Zero if no error occurred, a non-zero exit status otherwise.
   **/
   int handle_declarators(definition_scope *scope, token_t& token,
                          full_type& type, unsigned inherited_flags,
-                         definition* &res = dangling_pointer);
+                         definition* &res = dangling_pointer,
+                         const SourceLocation *begin = nullptr);
 
   /**
     Parse a namespace definition.
@@ -84,6 +84,7 @@ int jdi::context_parser::handle_class_inheritance(definition_scope *scope, token
 
 jdi::definition_class* jdi::context_parser::handle_class(definition_scope *scope, token_t& token, int inherited_flags)
 {
+  const SourceLocation begin = mark(token);
   unsigned protection = 0;
   if (token.type == TT_CLASS)
      protection = DEF_PRIVATE;
@@ -111,6 +112,7 @@ jdi::definition_class* jdi::context_parser::handle_class(definition_scope *scope
   if (get_location(nclass, will_redeclare, already_complete, token, classname, scope, this, herr))
     return nullptr;
 
+  const bool created = !nclass;
   if (!nclass)
     if (not(nclass = insnew(scope,inherited_flags,classname,token,herr)))
       return nullptr;
@@ -151,6 +153,7 @@ jdi::definition_class* jdi::context_parser::handle_class(definition_scope *scope
       token.report_error(herr, "Expected closing brace to class `" + classname + "'");
       FATAL_RETURN(nullptr);
     }
+    declared(nclass, begin, token);
     token = read_next_token(scope);
   }
   else // Sometimes, it isn't okay to not specify a structure body.
@@ -160,6 +163,7 @@ jdi::definition_class* jdi::context_parser::handle_class(definition_scope *scope
     }
 
   nclass->flags |= incomplete;
+  if (created && incomplete) declared(nclass, begin, token);
   return nclass;
 }
 
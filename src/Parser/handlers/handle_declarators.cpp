@@ -32,6 +32,7 @@
 #include <System/builtins.h>
 #include <API/compile_settings.h>
 #include <API/AST.h>
+#include <atomic>
 #include <cstdio>
 
 #include "handle_function_impl.h"
@@ -39,7 +40,7 @@
 using namespace jdi;
 using std::make_unique;
 
-static unsigned anon_count = 0;
+static std::atomic<unsigned> anon_count(0);
 namespace jdi {
 
 definition *dangling_pointer = nullptr;
@@ -47,6 +48,8 @@ definition *dangling_pointer = nullptr;
 int context_parser::handle_declarators(definition_scope *scope, token_t& token,
                                        unsigned inherited_flags,
                                        definition* &res) {
+  const SourceLocation begin = mark(token);
+  body_owner = nullptr;
   // Skip destructor tildes; log if we are a destructor
   bool dtor = token.type == TT_TILDE;
   const bool is_inline = token.type == TT_DECFLAG && token.content.view() == "inline";
@@ -86,8 +89,11 @@ int context_parser::handle_declarators(definition_scope *scope, token_t& token,
       full_type ft = read_operatorkw_cast_type(token, scope);
       if (!ft.def)
         return 1;
+      bool created = false;
       res = scope->overload_function("(cast)", ft, inherited_flags,
-                                     herr->at(token));
+                                     herr->at(token), &created);
+      redeclared(res, created);
+      declared_before_body(res, begin, token);
       return !res;
     }
     else if (is_inline && token.type == TT_NAMESPACE) {
@@ -103,12 +109,14 @@ int context_parser::handle_declarators(definition_scope *scope, token_t& token,
     }
   }
 
-  return handle_declarators(scope, token, tp, inherited_flags, res);
+  return handle_declarators(scope, token, tp, inherited_flags, res, &begin);
 }
 
 int context_parser::handle_declarators(
     definition_scope *scope, token_t& token, full_type &tp,
-    unsigned inherited_flags, definition* &res) {
+    unsigned inherited_flags, definition* &res, const SourceLocation *begin) {
+  const SourceLocation here = begin ? SourceLocation({}, 0, 0) : mark(token);
+  if (!begin) begin = &here;
   // Make sure we do indeed find ourselves at an identifier to declare.
   if (tp.refs.name.empty()) {
     const bool potentialc = is_potential_constructor(scope, tp);
@@ -122,7 +130,7 @@ int context_parser::handle_declarators(
     else if (token.type == TT_COLON) {
       if (scope->flags & DEF_CLASS) {
         char anonname[32];
-        sprintf(anonname,"<anonymousField%010d>",anon_count);
+        sprintf(anonname,"<anonymousField%010d>",anon_count.load());
         tp.refs.name = anonname;
       }
       else
@@ -189,6 +197,7 @@ int context_parser::handle_declarators(
         auto fun = make_unique<definition_function>(tp.refs.name, scope,
                                                     inherited_flags);
         res = fun->overload(tp, inherited_flags, herr->at(token));
+        inherit_overloads(scope, fun.get(), token);
         ins.def = std::move(fun);
       } else {
         ins.def = make_unique<definition_typed>(tp.refs.name, scope,
@@ -219,7 +228,9 @@ int context_parser::handle_declarators(
           return 4;
         }
         definition_function* func = (definition_function*) ins.def.get();
-        res = func->overload(tp, inherited_flags, herr->at(token));
+        bool created = false;
+        res = func->overload(tp, inherited_flags, herr->at(token), &created);
+        redeclared(res, created);
       }
       // More function overloading
       else if (!(ins.def->flags & DEF_TYPED)) {
@@ -257,7 +268,9 @@ int context_parser::handle_declarators(
         return 4;
       }
       definition_function* func = (definition_function*)res;
-      res = func->overload(tp, inherited_flags, herr->at(token));
+      bool created = false;
+      res = func->overload(tp, inherited_flags, herr->at(token), &created);
+      redeclared(res, created);
     }
     // cout << "Implementing " << res->name << std::endl;
   }
@@ -274,6 +287,7 @@ int context_parser::handle_declarators(
       }
       case GTT_OPERATORMISC:
         if (token.type == TT_COMMA) {
+          declared(res, *begin, token);
           // Move past this comma
           token = read_next_token(scope);
 
@@ -281,7 +295,8 @@ int context_parser::handle_declarators(
           read_referencers(tp.refs, tp, token, scope);
 
           // Just hop into the error checking above and pass through the definition addition again.
-          return handle_declarators(scope, token, tp, inherited_flags, res);
+          return handle_declarators(scope, token, tp, inherited_flags, res,
+                                    begin);
         } else if (token.type == TT_COLON) {
           definition *root = tp.def;
           while (root->flags & DEF_TYPED && (root = ((definition_typed*)root)->type));
@@ -312,6 +327,7 @@ int context_parser::handle_declarators(
       case GTT_TEMPLATE: case GTT_USING: case GTT_ARITHMETIC: case GTT_RELATIVE_ASSIGN:
       case GTT_ANGLE: case GTT_ENDOFCODE: case GTT_INVALID: case GTT_CONTROL:
       default:
+        declared_before_body(res, *begin, token);
         return 0;
       }
   }
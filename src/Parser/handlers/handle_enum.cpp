@@ -22,6 +22,7 @@
 #include <cstdio>
 #include <API/AST.h>
 #include <Parser/context_parser.h>
+#include <Storage/value_funcs.h>
 #include <System/builtins.h>
 #include <General/debug_macros.h>
 #include <API/compile_settings.h>
@@ -35,6 +36,7 @@ using namespace jdi;
 definition_enum* context_parser::handle_enum(definition_scope *scope,
                                              token_t& token,
                                              int inherited_flags) {
+  const SourceLocation begin = mark(token);
   dbg_assert(token.type == TT_ENUM);
 
   token = read_next_token(scope);
@@ -50,6 +52,7 @@ definition_enum* context_parser::handle_enum(definition_scope *scope,
     return nullptr;
   }
 
+  const bool created = !nenum;
   if (!nenum && !(nenum = insnew(scope, inherited_flags, classname, token, herr))) {
     return nullptr;
   }
@@ -73,6 +76,7 @@ definition_enum* context_parser::handle_enum(definition_scope *scope,
   else nenum->type = builtin_type__int;
 
   if (token.type != TT_LEFTBRACE) {
+    if (created) declared(nenum, begin, token);
     return nenum;
   }
 
@@ -107,6 +111,7 @@ definition_enum* context_parser::handle_enum(definition_scope *scope,
         continue;
       }
       render_ast(*ast, "enum_values");
+      ast->compile();  // Kept, and evaluated again when remapped.
       value v = ast->eval(ErrorContext(herr, token));
       if (v.type != VT_INTEGER && v.type != VT_DEPENDENT) {
         #ifdef DEBUG_MODE
@@ -114,7 +119,7 @@ definition_enum* context_parser::handle_enum(definition_scope *scope,
         #else
           token.report_error(herr, "Expected integer result from expression; " + string(v.type == VT_DOUBLE? "floating point": v.type == VT_STRING? "string": "invalid") + " type given");
         #endif
-        this_value = value(++this_value.real);
+        this_value = value((long) this_value + 1);
       } else {
         this_value = std::move(v);
       }
@@ -133,7 +138,7 @@ definition_enum* context_parser::handle_enum(definition_scope *scope,
     else
       token.report_error(herr, "Redeclatation of constant `" + classname + "' in enumeration");
 
-    ++this_value.real;
+    this_value = value_unary_increment(this_value);
 
     if (token.type == TT_COMMA)
       token = read_next_token(scope);
@@ -143,6 +148,7 @@ definition_enum* context_parser::handle_enum(definition_scope *scope,
       break;
     }
   }
+  declared(nenum, begin, token);
   token = read_next_token(scope);
 
   nenum->flags |= incomplete;
@@ -28,17 +28,11 @@
 #include "handle_function_impl.h"
 using namespace jdi;
 
-static void* code_ignorer(lexer *lex, token_t &token, definition_scope *, ErrorHandler *herr) {
+static void* code_ignorer(lexer *lex, token_t &token, definition_scope *, ErrorHandler *) {
   if (token.type == TT_LEFTBRACE) {
-    for (size_t bc = 0;;) {
-      if (token.type == TT_LEFTBRACE) ++bc;
-      else if (token.type == TT_RIGHTBRACE and !--bc) return nullptr;
-      token = lex->get_token();
-      if (token.type == TT_ENDOFCODE) {
-        token.report_errorf(herr, "Expected closing brace to code before %s");
-        return nullptr;
-      }
-    }
+    // Keep where the body lies, that it may be lexed later.
+    SkippedBody body = lex->skip_body(token);
+    if (body.has_range()) return new SkippedBody(std::move(body));
   }
   else if (token.type == TT_ASM) {
     do token = lex->get_token();
@@ -58,8 +52,9 @@ static void *initializer_ignorer(lexer *lex, token_t &token, definition_scope *s
   return nullptr;
 }
 static void do_nothing(void*) {}
+static void forget_body(void *impl) { delete (SkippedBody*) impl; }
 
 void* (*handle_function_implementation)(lexer *lex, token_t &token, definition_scope *scope, ErrorHandler *herr) = code_ignorer;
 void* (*handle_constructor_initializers)(lexer *lex, token_t &token, definition_scope *scope, ErrorHandler *herr) = initializer_ignorer;
-void  (*delete_function_implementation)(void* impl) = do_nothing;
+void  (*delete_function_implementation)(void* impl) = forget_body;
 void  (*delete_constructor_initializers)(void* impl) = do_nothing;
@@ -37,6 +37,9 @@
   In the former case, this function will be invoked with token.type = TT_LEFTBRACE;
   in the latter case, the function will be invoked with token.type = TT_ASM.
   
+  By default, a body is skipped, and a new SkippedBody giving where it lies is
+  returned, if it lies within one file; otherwise, null is returned.
+  
   @param lex    The lexer to use to poll for further tokens.
   @param token  The initial token which invoked this function call.
   @param scope  The scope from which definitions can be read.
@@ -58,6 +61,7 @@ extern void* (*handle_constructor_initializers)(jdi::lexer *lex, jdi::token_t &t
 /**
   Function pointer to handle freeing function code content as allocated by a corresponding
   call to handle_function_implementation. Invoked on destruct of the owning function definition.
+  By default, deletes the SkippedBody given.
   
   @param impl  The implementation data, as returned by handle_function_implementation.
 */
@@ -23,13 +23,34 @@
 
 using std::make_unique;
 
+/// Reopening a namespace that lives in a context we are layered over declares
+/// an overlay namespace here instead, through which the original is still used.
+static jdi::definition_scope *overlay_namespace(jdi::definition_scope *scope,
+                                                jdi::definition_scope *base_ns) {
+  using namespace jdi;
+  decpair dins = scope->declare(base_ns->name);
+  if (dins.inserted) {
+    auto uscope = make_unique<definition_scope>(base_ns->name, scope, DEF_NAMESPACE);
+    uscope->use_namespace(base_ns);
+    dins.def = std::move(uscope);
+  } else if (!(dins.def->flags & DEF_NAMESPACE)) {
+    return nullptr;
+  }
+  return (definition_scope*) dins.def.get();
+}
+
 jdi::definition_scope *jdi::context_parser::handle_namespace(definition_scope *scope, token_t& token)
 {
+  const SourceLocation begin = mark(token);
   definition_scope *nscope;
   token = read_next_token( scope);
   if (token.type != TT_IDENTIFIER) {
     if (token.type == TT_DEFINITION and (token.def->flags & DEF_NAMESPACE)) {
       nscope = (definition_scope*) token.def;
+      if (!ctex->owns(nscope) && !(nscope = overlay_namespace(scope, nscope))) {
+        token.report_error(herr, "Attempting to redeclare `" + token.def->name + "' as a namespace");
+        return nullptr;
+      }
       token = read_next_token(scope);
     } else {
       token.report_error(herr, "Expected namespace name here.");
@@ -65,5 +86,6 @@ jdi::definition_scope *jdi::context_parser::handle_namespace(definition_scope *s
     token.report_errorf(herr, "Expected closing brace to namespace `" + nscope->name + "' before %s");
     return nullptr;
   }
+  declared(nscope, begin, token);
   return nscope;
 }
@@ -24,6 +24,7 @@
 #include <Parser/context_parser.h>
 #include <API/AST.h>
 #include <API/compile_settings.h>
+#include <API/parse_trace.h>
 #include <System/builtins.h>
 #include <Parser/handlers/handle_function_impl.h>
 #include <cstdio>
@@ -31,8 +32,18 @@
 int jdi::context_parser::handle_scope(definition_scope *scope, token_t& token, unsigned inherited_flags)
 {
   definition* decl;
+  // When tracing, each declaration at namespace scope gets a span, named for
+  // its first token until it reports what it declares.
+  ParseTrace *const trace = scope->flags & (DEF_CLASS | DEF_UNION)
+                          ? nullptr : ParseTrace::current();
+  ParseTrace::span statement;
   token = read_next_token(scope);
   for (;;) {
+    if (trace && !statement.is_open() &&
+        token.type != TT_ENDOFCODE && token.type != TT_RIGHTBRACE) {
+      statement.open(trace, ParseTrace::DECLARATION,
+                     token.content.toString(), false);
+    }
     switch (token.type) {
       case TT_TYPENAME: case TT_INLINE: case TT_ATTRIBUTE: case TT_TYPEOF:
       case TT_DECFLAG: case TT_DECLTYPE: case TT_DECLARATOR: case_TT_DECLARATOR:
@@ -50,7 +61,8 @@ int jdi::context_parser::handle_scope(definition_scope *scope, token_t& token, u
               if (!(decl and decl->flags & DEF_OVERLOAD)) {
                 token.report_error(herr, "Unexpected opening brace here; declaration is not a function");
                 FATAL_RETURN(1);
-                handle_function_implementation(lex,token,scope,herr);
+                delete_function_implementation(
+                    handle_function_implementation(lex,token,scope,herr));
               }
               else {
                 definition_overload *ovr = ((definition_overload*)decl);
@@ -60,6 +72,7 @@ int jdi::context_parser::handle_scope(definition_scope *scope, token_t& token, u
                 }
                 ovr->implementation = handle_function_implementation(lex,token,scope,herr);
               }
+              body_skipped(token);
               if (token.type != TT_RIGHTBRACE && token.type != TT_SEMICOLON) {
                 token.report_error(herr, "Expected closing symbol to function");
                 continue;
@@ -140,7 +153,9 @@ int jdi::context_parser::handle_scope(definition_scope *scope, token_t& token, u
       case TT_RIGHTPARENTH: token.report_error(herr, "Stray closing parenthesis."); return 1;
       case TT_LEFTBRACKET:  token.report_error(herr, "Stray opening bracket."); return 1;
       case TT_RIGHTBRACKET: token.report_error(herr, "Stray closing bracket."); return 1;
-      case TT_RIGHTBRACE:   return 0;
+      case TT_RIGHTBRACE:
+          if (filter) discard_filtered(scope);
+        return 0;
       case TT_LEFTBRACE: {
           token.report_error(herr, "Expected scope declaration before opening brace.");
           #if FATAL_ERRORS
@@ -264,13 +279,17 @@ int jdi::context_parser::handle_scope(definition_scope *scope, token_t& token, u
         break;
 
       case TT_OPERATORKW: {
+          const SourceLocation begin = mark(token);
           full_type ft = read_operatorkw_cast_type(token, scope);
           if (!ft.def)
             return 1;
+          bool created = false;
           if (!(decl = scope->overload_function("(cast)", ft, inherited_flags,
-                                                herr->at(token)))) {
+                                                herr->at(token), &created))) {
             return 1;
           }
+          redeclared(decl, created);
+          declared_before_body(decl, begin, token);
           goto handled_declarator_block;
       } break;
 
@@ -301,8 +320,12 @@ int jdi::context_parser::handle_scope(definition_scope *scope, token_t& token, u
         break;
 
       case TT_ENDOFCODE:
+          if (filter) discard_filtered(scope);
         return 0;
     }
+    if (filter) discard_filtered(scope);
+    // End the span before the next token can enter or leave a file.
+    statement.close();
     token = read_next_token(scope);
   }
 }
@@ -31,6 +31,17 @@ namespace jdi {
 
 using std::make_unique;
 
+/// Returns whether the given scope is the target scope or reopens it from a
+/// context layered over the target's; see \c Context::owns().
+static bool same_or_overlay(const definition_scope *scope,
+                            const definition_scope *target) {
+  if (scope == target) return true;
+  for (const definition_scope *used : scope->using_scopes)
+    if (used->name == scope->name && same_or_overlay(used, target))
+      return true;
+  return false;
+}
+
 #if FATAL_ERRORS
 #define ERROR_CODE 1
 #else
@@ -128,6 +139,7 @@ int context_parser::read_specialization_parameters(
 
 int context_parser::handle_template(definition_scope *scope, token_t& token,
                                     unsigned inherited_flags) {
+  const SourceLocation begin = mark(token);
   token = read_next_token(scope);
   if (token.type != TT_LESSTHAN) {
     herr->error(token) << "Expected opening angle bracket following "
@@ -171,6 +183,7 @@ int context_parser::handle_template(definition_scope *scope, token_t& token,
       ast->set_use_for_templates(true);
       astbuilder->parse_expression(ast.get(), token, temp.get(),
                                    precedence::comma + 1);
+      ast->compile();  // Evaluated again for each instantiation.
     }
     if (auto dtn = make_unique<definition_tempparam>(
                        pname, temp.get(), std::move(ast), dtpflags)) {
@@ -221,6 +234,7 @@ int context_parser::handle_template(definition_scope *scope, token_t& token,
       if (token.type != TT_LEFTBRACE) {
         if (token.type == TT_SEMICOLON) {
           tclass->flags |= DEF_INCOMPLETE;
+          declared(tclass->parent, begin, token);
           return 0;
         }
         herr->error(token)
@@ -237,10 +251,12 @@ int context_parser::handle_template(definition_scope *scope, token_t& token,
         FATAL_RETURN(1);
       }
 
+      declared(tclass->parent, begin, token);
       return 0;
     }
     else if (token.type == TT_DEFINITION) {
-      if (token.def->parent != scope)
+      if (token.def->parent != scope &&
+          (ctex->owns(token.def) || !same_or_overlay(scope, token.def->parent)))
         goto regular_identifier;
 
       if (!((token.def->flags & DEF_TEMPLATE) &&
@@ -314,7 +330,11 @@ int context_parser::handle_template(definition_scope *scope, token_t& token,
       read_specialization_parameters(argk, basetemp, spec.get(), token);
 
       spec->filter = argk;
-      definition_template::speclist &slist = basetemp->specializations;
+      // A frozen template can't take new specializations; if we're parsing
+      // over its context, they belong to ours.
+      definition_template::speclist &slist = basetemp->flags & DEF_FROZEN
+          ? frozen_instantiations::current().specializations_of(basetemp)
+          : basetemp->specializations;
 
       definition_template *extemp = nullptr;
       definition_template::specialization *exspec = nullptr;
@@ -473,6 +493,7 @@ int context_parser::handle_template(definition_scope *scope, token_t& token,
     if (!func) {
       auto nfun = make_unique<definition_function>(funcname, scope);
       func = nfun.get();
+      inherit_overloads(scope, func, token);
       scope->declare(funcname, std::move(nfun));
     }
     definition_scope *tscope = temp.get();
@@ -492,6 +513,7 @@ int context_parser::handle_template(definition_scope *scope, token_t& token,
           << "Expected template function body or semicolon before" << token;
       FATAL_RETURN(1);
     }
+    declared(tscope, begin, token);
     return 0;
   }
   else if (token.type == TT_OPERATORKW) {
@@ -563,7 +585,8 @@ int context_parser::handle_template(definition_scope *scope, token_t& token,
         continue;
       }
       if (token.type == TT_LEFTBRACE) {
-        handle_function_implementation(lex, token, scope, herr);
+        delete_function_implementation(
+            handle_function_implementation(lex, token, scope, herr));
         break;
       }
       if (token.type == TT_SEMICOLON) break;
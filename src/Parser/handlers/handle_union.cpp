@@ -34,6 +34,7 @@ using namespace jdi;
 
 definition_union* context_parser::handle_union(
     definition_scope *scope, token_t& token, int inherited_flags) {
+  const SourceLocation begin = mark(token);
   #ifdef DEBUG_MODE
   if (token.type != TT_UNION)
     token.report_error(herr, "PARSE ERROR: handle_union invoked with non-union token.");
@@ -50,6 +51,7 @@ definition_union* context_parser::handle_union(
   if (get_location(nunion, will_redeclare, already_complete, token, classname, scope, this, herr))
   return nullptr;
 
+  const bool created = !nunion;
   if (!nunion)
     if (not(nunion = insnew(scope,inherited_flags,classname,token,herr)))
       return nullptr;
@@ -77,9 +79,11 @@ definition_union* context_parser::handle_union(
       token.report_error(herr, "Expected closing brace to union `" + classname + "'");
       FATAL_RETURN(nullptr);
     }
+    declared(nunion, begin, token);
     token = read_next_token(scope);
   }
 
   nunion->flags |= incomplete;
+  if (created && incomplete) declared(nunion, begin, token);
   return nunion;
 }
@@ -53,7 +53,7 @@ definition* jdi::context_parser::read_qualified_definition(token_t &token, defin
     #ifdef DEBUG_MODE
     if (!token.def) {
       for (const auto &sl : lex->detailed_position())
-        std::cerr << "In " << sl.filename << ":" << sl.line << ":" << sl.pos << ":\n";
+        std::cerr << "In " << sl.filename() << ":" << sl.line << ":" << sl.pos << ":\n";
       herr->error(token)
           << "jdi::read_qualified_definition invoked with non-type token "
           << token;
@@ -117,6 +117,7 @@ definition* jdi::context_parser::read_qualified_definition(token_t &token, defin
       token = lex->get_token();
       if (token.type != TT_IDENTIFIER) {
         if (token.type == TT_OPERATORKW) {
+          ParseStats::count(&ParseStats::lookups);
           res = token.def = as->look_up(read_operatorkw_name(token, scope));
           if (!token.def)
             return FATAL_TERNARY(nullptr,res);
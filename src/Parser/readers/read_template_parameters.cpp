@@ -39,7 +39,7 @@ int context_parser::read_template_parameter(
   {
     AST a;
     a.set_use_for_templates(true);
-    static int iv = 0; ++iv;
+    static thread_local int iv = 0; ++iv;
     astbuilder->parse_expression(&a, token, scope, precedence::comma+1);
     if (argnum < temp->params.size())
     {
@@ -94,12 +94,14 @@ int check_read_template_parameters(arg_key &argk, size_t args_given,
 
     for (size_t i = args_given; i < temp->params.size(); ++i) {
       if (temp->params[i]->default_assignment) {
-        AST nast(*temp->params[i]->default_assignment, true);
-        nast.remap(n, errc);
-        if (temp->params[i]->flags & DEF_TYPENAME)
+        const AST &def = *temp->params[i]->default_assignment;
+        if (temp->params[i]->flags & DEF_TYPENAME) {
+          AST nast(def, true);
+          nast.remap(n, errc);
           argk.put_type(i, nast.coerce(errc));
-        else
-          argk.put_value(i, nast.eval(errc));
+        } else {
+          argk.put_value(i, def.eval(errc, n));
+        }
       } else {
         errc.error() << "Parameter " << i << " is not defaulted";
       }
@@ -289,7 +289,7 @@ public:
 int jdi::context_parser::read_referencers(ref_stack &refs, const full_type& ft, token_t &token, definition_scope *scope)
 {
   #ifdef DEBUG_MODE
-  static int number_of_times_GDB_dropped_its_ass = 0;
+  static thread_local int number_of_times_GDB_dropped_its_ass = 0;
   number_of_times_GDB_dropped_its_ass++;
   #endif
 
@@ -386,6 +386,7 @@ int jdi::context_parser::read_referencers(ref_stack &refs, const full_type& ft,
 
       case TT_OPERATORKW: {
           refs.name = read_operatorkw_name(token, scope);
+          ParseStats::count(&ParseStats::lookups);
           refs.ndef = scope->look_up(refs.name);
           ref_stack appme; int res = read_referencers_post(appme, token, scope);
           refs.append_c(appme); return res;
@@ -450,7 +451,7 @@ int jdi::context_parser::read_referencers(ref_stack &refs, const full_type& ft,
 int jdi::context_parser::read_referencers_post(ref_stack &refs, token_t &token, definition_scope *scope)
 {
   #ifdef DEBUG_MODE
-  static int number_of_times_GDB_dropped_its_ass = 0;
+  static thread_local int number_of_times_GDB_dropped_its_ass = 0;
   number_of_times_GDB_dropped_its_ass++;
   #endif
 
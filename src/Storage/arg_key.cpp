@@ -150,9 +150,15 @@ namespace jdi {
   }
   bool arg_key::matches(const arg_key &k) const {
     for (const node *n1 = values, *n2 = k.values; n1 != endv and n2 != k.endv; ++n1, ++n2) {
-      if (n1->is_abstract()) continue;
+      if (n1->is_abstract()) {
+        // An abstract type may still pin down a shape, as in `T*'.
+        if (n1->type == AKT_FULLTYPE && !n1->ft().refs.empty())
+          if (n2->type != AKT_FULLTYPE || !n2->ft().refs.ends_with(n1->ft().refs)) return false;
+        continue;
+      }
       if (n1->type != n2->type) return false;
-      if (n1->type == AKT_FULLTYPE && n1->ft().def != n2->ft().def) return false;
+      if (n1->type == AKT_FULLTYPE && (n1->ft().def != n2->ft().def || n1->ft().refs != n2->ft().refs)) return false;
+      if (n1->type == AKT_VALUE && n2->val().type != VT_DEPENDENT && n1->val() != n2->val()) return false;
     }
     return true;
   }
@@ -206,7 +212,7 @@ namespace jdi {
     type = other.type;
     if (type == AKT_FULLTYPE)
       new(&data) full_type(other.ft());
-    else
+    else if (type == AKT_VALUE)
       new(&data) aug_value(other.av());
     return *this;
   }
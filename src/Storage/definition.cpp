@@ -26,16 +26,22 @@
 #include <iostream>
 #include <cstdio>
 #include <typeinfo>
+#include <algorithm>
+#include <atomic>
 #include <System/builtins.h>
 #include <Parser/handlers/handle_function_impl.h>
 #include <API/compile_settings.h>
+#include <API/parse_stats.h>
+#include <API/parse_trace.h>
+#include <General/utils.h>
 #include <Parser/context_parser.h>
 #include <Parser/is_potential_constructor.h>
 using namespace std;
 
 namespace jdi {
 
-definition::definition(string n,definition* p,unsigned int f): flags(f), name(n), parent((definition_scope*)p) {}
+// Copies of frozen definitions are not themselves frozen.
+definition::definition(string n,definition* p,unsigned int f): flags(f & ~DEF_FROZEN), name(n), parent((definition_scope*)p) {}
 definition::definition(): flags(0), name(), parent(nullptr) {}
 
 ptrdiff_t definition::defcmp(definition *d1, definition *d2) {
@@ -76,20 +82,25 @@ definition_function::definition_function(string n, definition* p, int flgs):
 
 definition_overload::definition_overload(string n, definition *p, definition* tp, const ref_stack &rf, unsigned int typeflags, int flgs):
   definition_typed(n, p, tp, rf, typeflags, (flgs & ~(DEF_FUNCTION)) | DEF_OVERLOAD), implementation(nullptr) {}
+definition_overload::~definition_overload() {
+  if (implementation) delete_function_implementation(implementation);
+}
 
 definition_overload *definition_function::overload(
     definition *tp, const ref_stack &rf, unsigned int typeflags,
-    unsigned int addflags, void *implementation, ErrorContext errc) {
+    unsigned int addflags, void *implementation, ErrorContext errc,
+    bool *created) {
   arg_key key(rf);
   pair<overload_iter, bool> ins = overloads.insert(pair<arg_key,definition_overload*>(key, nullptr));
+  if (created) *created = ins.second;
   if (!ins.second) {
     if (implementation) {
       if (ins.first->second->implementation) {
         errc.error(
             "Reimplementation of function; old implementation discarded");
         delete_function_implementation(ins.first->second->implementation);
-        FATAL_RETURN(nullptr);
         ins.first->second->implementation = implementation;
+        FATAL_RETURN(nullptr);
       }
       ins.first->second->implementation = implementation;
     }
@@ -97,13 +108,15 @@ definition_overload *definition_function::overload(
   else {
     ins.first->second = make_unique<definition_overload>(
                            name, parent, tp, rf, typeflags, flags | addflags);
+    ins.first->second->implementation = implementation;
   }
   return ins.first->second.get();
 }
 
 definition_overload *definition_function::overload(
-    const full_type &ft, unsigned int addflags, ErrorContext errc) {
-  return overload(ft.def, ft.refs, ft.flags, addflags, nullptr, errc);
+    const full_type &ft, unsigned int addflags, ErrorContext errc,
+    bool *created) {
+  return overload(ft.def, ft.refs, ft.flags, addflags, nullptr, errc, created);
 }
 
 void definition_function::overload(unique_ptr<definition_template> ovrl,
@@ -114,8 +127,45 @@ void definition_function::overload(unique_ptr<definition_template> ovrl,
   template_overloads.push_back(std::move(ovrl));
 }
 
+void definition_function::inherit(const definition_function *hidden,
+                                  ErrorContext errc) {
+  remap_set n;
+  for (const auto &ovr : hidden->overloads) {
+    if (overloads.find(ovr.first) != overloads.end()) continue;
+    auto dup = cast_unique<definition_overload>(ovr.second->duplicate(n));
+    dup->parent = parent;
+    overloads.insert({ovr.first, std::move(dup)});
+  }
+  const size_t first = template_overloads.size();
+  for (const auto &temp : hidden->template_overloads) {
+    auto dup = cast_unique<definition_template>(temp->duplicate(n));
+    dup->parent = parent;
+    template_overloads.push_back(std::move(dup));
+  }
+  for (size_t i = first; i < template_overloads.size(); ++i)
+    template_overloads[i]->remap(n, errc);
+}
+
+bool definition_function::discard(const definition *ovr) {
+  for (overload_iter it = overloads.begin(); it != overloads.end(); ++it) {
+    if (it->second.get() == ovr) {
+      overloads.erase(it);
+      return true;
+    }
+  }
+  for (auto it = template_overloads.begin(); it != template_overloads.end();
+       ++it) {
+    if (it->get() == ovr) {
+      template_overloads.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
 definition_overload* definition_scope::overload_function(
-      string fname, full_type &ft, unsigned inflags, ErrorContext errc) {
+      string fname, full_type &ft, unsigned inflags, ErrorContext errc,
+      bool *created) {
   definition_function *df;
   definition_overload *dov;
   decpair dp = declare(fname, nullptr);
@@ -133,7 +183,7 @@ definition_overload* definition_scope::overload_function(
     }
   }
 
-  dov = df->overload(ft, inflags, errc);
+  dov = df->overload(ft, inflags, errc, created);
   return dov;
 }
 
@@ -162,6 +212,7 @@ definition_function* definition_scope::overload_function(
 
 decpair definition_scope::declare_c_struct(string n,
                                            unique_ptr<definition> def) {
+  undefer();
   pair<defiter, bool> insp = c_structs.insert(std::make_pair(n, std::move(def)));
   dec_order.push_back(insp.first);
   return decpair(insp.first->second, insp.second);
@@ -173,6 +224,8 @@ definition *definition_scope::look_up(string sname) {
   return nullptr;
 }
 definition *definition_class::look_up(string sname) {
+  undefer();
+  materialize(sname);
   if (defiter it = members.find(sname); it != members.end())
     return it->second.get();
   if (auto it = using_general.find(sname); it != using_general.end())
@@ -189,6 +242,7 @@ definition *definition_class::look_up(string sname) {
   return parent->look_up(sname);
 }
 definition *definition_scope::find_local(string sname) {
+  undefer();
   if (defiter it = members.find(sname); it != members.end())
     return it->second.get();
   if (auto it = using_general.find(sname); it != using_general.end())
@@ -204,6 +258,7 @@ definition *definition_scope::find_local(string sname) {
   return nullptr;
 }
 definition *definition_class::find_local(string sname) {
+  materialize(sname);
   definition *res = definition_scope::find_local(sname);
   if (res) return res;
   for (vector<ancestor>::iterator ait = ancestors.begin(); ait != ancestors.end(); ++ait)
@@ -213,7 +268,8 @@ definition *definition_class::find_local(string sname) {
 }
 
 definition *definition_tempparam::look_up(string sname) {
-  must_be_class = true;
+  if (!(flags & DEF_FROZEN))
+    must_be_class = true;
   return definition_class::look_up(sname);
 }
 decpair definition_tempparam::declare(string sname,
@@ -225,7 +281,11 @@ definition *definition_scope::get_local(string n) {
   return find_local(n);
 }
 definition *definition_tempparam::get_local(string sname) {
+  // A frozen parameter has already made every member it will have.
+  if (flags & DEF_FROZEN)
+    return definition_scope::find_local(sname);
   must_be_class = true;
+  undefer();
   pair<defmap::iterator, bool> insp = members.insert(defmap::value_type(sname, nullptr));
   if (insp.second) {
     insp.first->second = std::make_unique<definition_tempparam>(sname, this);
@@ -234,9 +294,11 @@ definition *definition_tempparam::get_local(string sname) {
 }
 definition *definition_class::get_local(string sname) {
   definition *res = definition_scope::get_local(sname);
-  if (!res && (sname == name || (instance_of && sname == instance_of->name)))
+  if (!res && (sname == name || (instance_of && sname == instance_of->name))) {
+    materialize(constructor_name);
     if (defiter it = members.find(constructor_name); it != members.end())
       res = it->second.get();
+  }
   return res;
 }
 definition *definition_hypothetical::get_local(string sname) {
@@ -247,6 +309,13 @@ definition *definition_hypothetical::get_local(string sname) {
              : nullptr;
 }
 
+bool definition_scope::decode_deferred() {
+  // Take ownership first, so that lookups made while decoding don't recurse.
+  unique_ptr<deferred_members> pending = std::move(deferred);
+  pending->decode(this);
+  return true;
+}
+
 void definition_scope::use_namespace(definition_scope *ns) {
   using_scopes.push_back(ns);
 }
@@ -290,7 +359,8 @@ definition_valued::definition_valued(string vname, definition *parnt,
 
 definition_enum::definition_enum(string classname, definition_scope* parnt,
                                  unsigned flgs):
-    definition_class(classname, parnt, flgs | DEF_ENUM) {}
+    definition_class(classname, parnt, flgs | DEF_ENUM), type(nullptr),
+    modifiers(0) {}
 
 definition_template::definition_template(string n, definition *p, unsigned f):
     definition_scope(n, p, f | DEF_TEMPLATE), def(nullptr)  {}
@@ -298,14 +368,146 @@ definition_template::definition_template(string n, definition *p, unsigned f):
 definition_tempparam::definition_tempparam(
       string p_name, definition_scope* p_parent, unsigned p_flags):
     definition_class(p_name, p_parent, p_flags | DEF_TEMPPARAM | DEF_DEPENDENT),
-    default_assignment(nullptr) {}
+    default_assignment(nullptr), must_be_class(false) {}
 definition_tempparam::definition_tempparam(
       string p_name, definition_scope* p_parent, unique_ptr<AST> defval,
       unsigned p_flags):
     definition_class(p_name, p_parent, p_flags | DEF_TEMPPARAM | DEF_DEPENDENT),
-    default_assignment(std::move(defval)) {}
+    default_assignment(std::move(defval)), must_be_class(false) {}
+
+/// Returns whether instantiations of the given pattern can defer copying its
+/// members until they are looked up; see definition_class::lazy_instance.
+static bool is_lazy_instantiable(const definition *pattern) {
+  return (pattern->flags & DEF_CLASS) && !(pattern->flags &
+      (DEF_ENUM | DEF_UNION | DEF_TEMPPARAM | DEF_HYPOTHETICAL | DEF_INCOMPLETE));
+}
+
+/// Create the memberless instantiation of a class pattern; its members are
+/// materialized later, as they are looked up.
+static unique_ptr<definition> make_instance_shell(const definition_class *pattern,
+                                                  remap_set &n) {
+  auto res = make_unique<definition_class>(pattern->name, pattern->parent, pattern->flags);
+  res->ancestors = pattern->ancestors;
+  res->using_scopes = pattern->using_scopes;
+  res->using_general = pattern->using_general;
+  n[pattern] = res.get();
+  return res;
+}
 
-static int nest_count = 0;
+/// Fill a freshly-inserted instantiation slot with an instance of the given
+/// template. The slot is filled before the instance is remapped, so that the
+/// instance may refer to itself.
+static definition *instantiate_into(definition_template *temp, const arg_key &key,
+    unique_ptr<definition_template::instantiation> &slot, const ErrorContext &errc) {
+  //cout << "Instantiating new " << temp->name << "<" << key.toString() << "> (abstract: " << key.is_abstract() << ")" << endl;
+  remap_set n;
+  size_t ind = 0;
+  const bool lazy = is_lazy_instantiable(temp->def.get());
+  unique_ptr<definition> ntemp = lazy? make_instance_shell((definition_class*) temp->def.get(), n)
+                                     : temp->def->duplicate(n);
+  ntemp->name += "<" + key.toString() + ">";
+  if (ntemp->flags & DEF_CLASS)
+    ((definition_class*) ntemp.get())->instance_of = temp;
+  else
+    cerr << "Not a class lol" << endl;
+  definition *remap_me = ntemp.get();
+  slot = make_unique<definition_template::instantiation>();
+  slot->def = std::move(ntemp);
+  for (auto it = temp->params.begin(); it != temp->params.end(); ++it) {
+    unique_ptr<definition> ndef = key.make_definition(ind++, (*it)->name, temp);
+    n[it->get()] = ndef.get();
+    slot->parameter_defs.push_back(std::move(ndef));
+  }
+  size_t keyc = key.size();
+  if (keyc != temp->params.size()) {
+    errc.error() << "Attempt to instantiate template with an incorrect number of parameters; "
+                 << "passed " << (key.end() - key.begin())
+                 <<  ", required " << temp->params.size();
+    FATAL_RETURN(nullptr);
+  }
+
+  remap_me->remap(n, errc);
+  if (lazy) {
+    ((definition_class*) remap_me)->lazy = make_unique<definition_class::lazy_instance>(
+        (definition_class*) temp->def.get(), std::move(n), errc);
+  }
+  return remap_me;
+}
+
+static thread_local frozen_instantiations thread_instantiations;
+static thread_local frozen_instantiations *current_instantiations = nullptr;
+
+frozen_instantiations::entry &frozen_instantiations::get(const definition_template *temp) {
+  // A stale entry belongs to a freed template which happened to share the
+  // address of this one.
+  entry &e = entries[temp];
+  if (e.serial != temp->frozen_serial) {
+    e.instantiations.clear();
+    e.specializations.clear();
+    e.serial = temp->frozen_serial;
+  }
+  return e;
+}
+const frozen_instantiations::entry *frozen_instantiations::find(const definition_template *temp) const {
+  auto it = entries.find(temp);
+  if (it == entries.end() || it->second.serial != temp->frozen_serial)
+    return nullptr;
+  return &it->second;
+}
+definition_template::instmap &frozen_instantiations::of(const definition_template *temp) {
+  return get(temp).instantiations;
+}
+definition_template::speclist &frozen_instantiations::specializations_of(const definition_template *temp) {
+  return get(temp).specializations;
+}
+definition *frozen_instantiations::find_instantiation(const definition_template *temp, const arg_key &key) const {
+  for (const frozen_instantiations *store = this; store; store = store->base) {
+    if (const entry *e = store->find(temp)) {
+      auto it = e->instantiations.find(key);
+      if (it != e->instantiations.end())
+        return it->second->def.get();
+    }
+  }
+  return nullptr;
+}
+const arg_key *frozen_instantiations::key_of(const definition_template *temp, const definition *inst) const {
+  for (const frozen_instantiations *store = this; store; store = store->base) {
+    if (const entry *e = store->find(temp)) {
+      for (const auto &i : e->instantiations)
+        if (i.second && i.second->def.get() == inst)
+          return &i.first;
+    }
+  }
+  return nullptr;
+}
+void frozen_instantiations::find_specialization(const definition_template *temp, const arg_key &key,
+    definition_template::specialization *&spec, int &merit) const {
+  for (const frozen_instantiations *store = this; store; store = store->base) {
+    if (const entry *e = store->find(temp)) {
+      for (const auto &cand : e->specializations) {
+        if (!cand->filter.matches(key))
+          continue;
+        int m = cand->key.merit(key);
+        if (m > merit) {
+          spec = cand.get();
+          merit = m;
+        }
+      }
+    }
+  }
+}
+frozen_instantiations &frozen_instantiations::current() {
+  return current_instantiations? *current_instantiations : thread_instantiations;
+}
+frozen_instantiations::use::use(frozen_instantiations &store):
+    previous(current_instantiations) {
+  current_instantiations = &store;
+}
+frozen_instantiations::use::~use() {
+  current_instantiations = previous;
+}
+
+static thread_local int nest_count = 0;
 struct nest_ { nest_() { ++nest_count; } ~nest_() { --nest_count; } };
 definition* definition_template::instantiate(const arg_key& key, const ErrorContext &errc) {
   if (nest_count >= 128) {
@@ -313,6 +515,7 @@ definition* definition_template::instantiate(const arg_key& key, const ErrorCont
     return nullptr;
   }
   nest_ this_nest;
+  ParseStats::timer instantiating(ParseStats::INSTANTIATION);
 
   // TODO: Move this specialization search into the not-found if (ins.second) below, then add the specialization to the instantiation map.
   // TODO: Be careful not to double free those specializations. You may need to keep a separate map for regular instantiations to free.
@@ -322,57 +525,148 @@ definition* definition_template::instantiate(const arg_key& key, const ErrorCont
     return spec->spec_temp->instantiate(speckey, errc);
   }
 
-  pair<institer, bool> ins = instantiations.insert(pair<arg_key, instantiation*>(key, nullptr));
+  instmap *dest = &instantiations;
+  if (flags & DEF_FROZEN) {
+    institer it = instantiations.find(key);
+    if (it != instantiations.end())
+      return it->second->def.get();
+    // Other threads may be reading our map; work in one of our own.
+    frozen_instantiations &store = frozen_instantiations::current();
+    if (definition *found = store.find_instantiation(this, key))
+      return found;
+    dest = &store.of(this);
+  }
+
+  pair<institer, bool> ins = dest->insert(pair<arg_key, instantiation*>(key, nullptr));
   if (ins.second) {
-    //cout << "Instantiating new " << name << "<" << key.toString() << "> (abstract: " << key.is_abstract() << ")" << endl;
-    remap_set n;
-    size_t ind = 0;
-    unique_ptr<definition> ntemp = def->duplicate(n);
-    ntemp->name += "<" + key.toString() + ">";
-    if (ntemp->flags & DEF_CLASS)
-      ((definition_class*) ntemp.get())->instance_of = this;
-    else
-      cerr << "Not a class lol" << endl;
-    definition *remap_me = ntemp.get();
-    ins.first->second = make_unique<instantiation>();
-    ins.first->second->def = std::move(ntemp);
-    for (piterator it = params.begin(); it != params.end(); ++it) {
-      unique_ptr<definition> ndef = key.make_definition(ind++, (*it)->name, this);
-      n[it->get()] = ndef.get();
-      ins.first->second->parameter_defs.push_back(std::move(ndef));
-    }
-    size_t keyc = key.size();
-    if (keyc != params.size()) {
-      errc.error() << "Attempt to instantiate template with an incorrect number of parameters; "
-                   << "passed " << (key.end() - key.begin())
-                   <<  ", required " << params.size();
-      FATAL_RETURN(nullptr);
+    ParseStats::count(&ParseStats::instantiations);
+    ParseTrace::span traced;
+    if (ParseTrace *trace = ParseTrace::current()) {
+      traced.open(trace, ParseTrace::INSTANTIATION,
+                  qualified_id() + "<" + key.toString() + ">");
     }
-
-    remap_me->remap(n, errc);
+    return instantiate_into(this, key, ins.first->second, errc);
   }
-
   return ins.first->second->def.get();
 }
 
 definition_template::specialization *definition_template::find_specialization(const arg_key &key) const
 {
+  specialization_index &index = specialization_lookup;
+  if (!(flags & DEF_FROZEN))
+    index.update(specializations);
+
+  const bool memoize = !key.is_abstract();
+  if (memoize) {
+    auto memo = index.memo.find(key);
+    if (memo != index.memo.end())
+      return memo->second;
+  }
+
+  specialization_index::bucket candidates;
+  index.candidates(key, candidates);
+
   specialization *spec = nullptr;
   int merit = 0;
 
-  for (speclist::const_iterator i = specializations.begin(); i != specializations.end(); ++i) {
-    if (!(*i)->filter.matches(key))
+  for (unsigned i : candidates) {
+    const unique_ptr<specialization> &cand = specializations[i];
+    if (!cand->filter.matches(key))
       continue;
-    int m = (*i)->key.merit(key);
+    int m = cand->key.merit(key);
     if (m > merit) {
-      spec = i->get();
+      spec = cand.get();
       merit = m;
     }
   }
 
+  if (flags & DEF_FROZEN) {
+    frozen_instantiations::current().find_specialization(this, key, spec, merit);
+    return spec;
+  }
+  if (memoize)
+    index.memo.emplace(key, spec);
   return spec;
 }
 
+/// Returns whether a value can be filed under its numeric value; template
+/// arguments are integral, so these compare exactly.
+static bool is_indexable_value(const value &v) {
+  return v.type == VT_INTEGER || v.type == VT_DOUBLE;
+}
+
+void definition_template::specialization_index::update(const speclist &specs) {
+  if (indexed == specs.size())
+    return;
+  memo.clear();
+  for (; indexed < specs.size(); ++indexed) {
+    const arg_key &filter = specs[indexed]->filter;
+    if (by_type.size() < filter.size()) {
+      by_type.resize(filter.size());
+      by_shape.resize(filter.size());
+      by_value.resize(filter.size());
+    }
+    bucket *b = &generic;
+    for (size_t i = 0; i < filter.size(); ++i) {
+      const arg_key::node &n = filter[i];
+      if (n.type == arg_key::AKT_FULLTYPE && n.is_abstract()) {
+        if (n.ft().refs.empty()) continue;
+        b = &by_shape[i][n.ft().refs.top().type];
+        break;
+      }
+      if (n.is_abstract()) continue;
+      if (n.type == arg_key::AKT_FULLTYPE) {
+        b = &by_type[i][n.ft().def];
+        break;
+      }
+      if (n.type == arg_key::AKT_VALUE && is_indexable_value(n.val())) {
+        b = &by_value[i][n.val().as_long_double()];
+        break;
+      }
+    }
+    b->push_back(indexed);
+  }
+}
+
+void definition_template::specialization_index::candidates(
+    const arg_key &key, bucket &out) const {
+  out = generic;
+  const size_t positions = std::min(key.size(), by_type.size());
+  for (size_t i = 0; i < positions; ++i) {
+    const arg_key::node &n = key[i];
+    if (n.type == arg_key::AKT_FULLTYPE) {
+      auto it = by_type[i].find(n.ft().def);
+      if (it != by_type[i].end())
+        out.insert(out.end(), it->second.begin(), it->second.end());
+      if (!n.ft().refs.empty()) {
+        auto sit = by_shape[i].find(n.ft().refs.top().type);
+        if (sit != by_shape[i].end())
+          out.insert(out.end(), sit->second.begin(), sit->second.end());
+      }
+    } else if (n.type == arg_key::AKT_VALUE) {
+      if (is_indexable_value(n.val())) {
+        auto it = by_value[i].find(n.val().as_long_double());
+        if (it != by_value[i].end())
+          out.insert(out.end(), it->second.begin(), it->second.end());
+      } else {
+        // A dependent (or otherwise unfiled) argument may match any literal.
+        for (const auto &vb : by_value[i])
+          out.insert(out.end(), vb.second.begin(), vb.second.end());
+      }
+    }
+  }
+  std::sort(out.begin(), out.end());
+}
+
+void definition_template::specialization_index::clear() {
+  indexed = 0;
+  generic.clear();
+  by_type.clear();
+  by_shape.clear();
+  by_value.clear();
+  memo.clear();
+}
+
 arg_key spec_key::get_key(const arg_key &src_key)
 {
   arg_key res(ind_count);
@@ -443,11 +737,11 @@ definition_atomic::definition_atomic(string n, definition* p, unsigned int f,
 definition_hypothetical::definition_hypothetical(string n, definition_scope *p,
                                                  unsigned f, unique_ptr<AST> d):
     definition_class(n, p, f | DEF_HYPOTHETICAL | DEF_DEPENDENT),
-    def(std::move(d)) {}
+    def(std::move(d)), required_flags(0) {}
 definition_hypothetical::definition_hypothetical(string n, definition_scope *p,
                                                  unique_ptr<AST> d):
     definition_class(n, p, DEF_HYPOTHETICAL | DEF_DEPENDENT),
-    def(std::move(d)) {}
+    def(std::move(d)), required_flags(0) {}
 
 using_scope::using_scope(string n, definition_scope* u): definition_scope(n, u, DEF_NAMESPACE) {}
 using_scope::~using_scope() { parent->unuse_namespace(this); }
@@ -457,11 +751,13 @@ using_scope::~using_scope() { parent->unuse_namespace(this); }
 //========================================================================================================
 
 decpair definition_scope::declare(string n, unique_ptr<definition> def) {
+  undefer();
   inspair insp = members.insert(entry(n, std::move(def)));
   dec_order.push_back(insp.first);
   return decpair(insp.first->second, insp.second);
 }
 decpair definition_class::declare(string n, unique_ptr<definition> def) {
+  materialize(n);
   return definition_scope::declare(n, std::move(def));
 }
 
@@ -475,6 +771,8 @@ value definition::size_of(const ErrorContext &errc) {
 }
 
 value definition_class::size_of(const ErrorContext &errc) {
+  undefer();
+  materialize_all();
   value sz = 0L;
   for (defiter it = members.begin(); it != members.end(); ++it)
     if (not(it->second->flags & DEF_TYPENAME))
@@ -508,6 +806,7 @@ value definition_function::size_of(const ErrorContext &errc) {
 }
 
 value definition_scope::size_of(const ErrorContext &errc) {
+  undefer();
   size_t sz = 0;
   for (defiter it = members.begin(); it != members.end(); ++it)
     if (not(it->second->flags & DEF_TYPENAME)) {
@@ -528,6 +827,7 @@ value definition_typed::size_of(const ErrorContext &errc) {
 }
 
 value definition_union::size_of(const ErrorContext &errc) {
+  undefer();
   size_t sz = 0;
   for (defiter it = members.begin(); it != members.end(); ++it)
     if (not(it->second->flags & DEF_TYPENAME))
@@ -543,6 +843,79 @@ value definition_hypothetical::size_of(const ErrorContext &) {
   return VT_DEPENDENT;
 }
 
+//========================================================================================================
+//======: Freeze functions :==============================================================================
+//========================================================================================================
+
+bool definition::freeze(bool seal) {
+  if (seal)
+    flags |= DEF_FROZEN;
+  return false;
+}
+
+bool definition_function::freeze(bool seal) {
+  bool res = definition::freeze(seal);
+  for (auto it = overloads.begin(); it != overloads.end(); ++it)
+    res |= it->second->freeze(seal);
+  for (const unique_ptr<definition_template> &temp : template_overloads)
+    res |= temp->freeze(seal);
+  return res;
+}
+
+bool definition_scope::freeze(bool seal) {
+  bool res = definition::freeze(seal);
+  if (!seal) res |= undefer();
+  for (defiter it = members.begin(); it != members.end(); ++it)
+    if (it->second) res |= it->second->freeze(seal);
+  for (defiter it = c_structs.begin(); it != c_structs.end(); ++it)
+    if (it->second) res |= it->second->freeze(seal);
+  return res;
+}
+
+bool definition_class::freeze(bool seal) {
+  bool res = false;
+  if (!seal && lazy) {
+    materialize_all();
+    res = true;
+  }
+  return definition_scope::freeze(seal) | res;
+}
+
+bool definition_template::freeze(bool seal) {
+  static std::atomic<unsigned long> serials(0);
+  bool res = definition_scope::freeze(seal);
+  if (seal) {
+    specialization_lookup.update(specializations);
+    frozen_serial = ++serials;
+  }
+  if (def) res |= def->freeze(seal);
+  for (const unique_ptr<definition_tempparam> &param : params)
+    res |= param->freeze(seal);
+  for (const unique_ptr<specialization> &spec : specializations)
+    res |= spec->spec_temp->freeze(seal);
+  for (institer it = instantiations.begin(); it != instantiations.end(); ++it) {
+    res |= it->second->def->freeze(seal);
+    for (const unique_ptr<definition> &pdef : it->second->parameter_defs)
+      res |= pdef->freeze(seal);
+  }
+  for (const unique_ptr<definition_hypothetical> &dep : dependents)
+    res |= dep->freeze(seal);
+  return res;
+}
+bool frozen_instantiations::freeze(bool seal) {
+  bool res = false;
+  for (auto &e : entries) {
+    for (const auto &spec : e.second.specializations)
+      res |= spec->spec_temp->freeze(seal);
+    for (auto &inst : e.second.instantiations) {
+      res |= inst.second->def->freeze(seal);
+      for (const unique_ptr<definition> &pdef : inst.second->parameter_defs)
+        res |= pdef->freeze(seal);
+    }
+  }
+  return res;
+}
+
 //========================================================================================================
 //======: String printers :===============================================================================
 //========================================================================================================
@@ -566,8 +939,10 @@ string definition_class::toString(unsigned levels, unsigned indent) const {
       res += it->def->name + " ";
     }
   }
-  if (levels and not(flags & DEF_INCOMPLETE))
+  if (levels and not(flags & DEF_INCOMPLETE)) {
+    const_cast<definition_class*>(this)->materialize_all();
     res += "\n", res += definition_scope::toString(dl(levels), indent);
+  }
   return res;
 }
 string definition_enum::toString(unsigned levels, unsigned indent) const {
@@ -607,6 +982,7 @@ string definition_scope::toString(unsigned levels, unsigned indent) const {
   if (flags & DEF_NAMESPACE)
     res += name.empty()? "namespace " : "namespace " + name + " ";
   if (levels) {
+    const_cast<definition_scope*>(this)->undefer();
     res += "{\n";
     for (auto it : dec_order) {
       if (it->second) res += it->second->toString(levels-1, indent+2) + "\n";
@@ -680,9 +1056,9 @@ string definition_typed::kind() const     { return "object"; }
 string definition_union::kind() const     { return "union"; }
 string definition_valued::kind() const    { return "constant"; }
 
-static map<int, string> flagnamemap;
-string flagnames(unsigned flags) {
-  if (flagnamemap.empty()) {
+static map<int, string> build_flagnamemap() {
+  map<int, string> flagnamemap;
+  {
     unsigned d = DEF_TYPENAME;
     switch (d) {
       case DEF_TYPENAME:     flagnamemap[DEF_TYPENAME]     = "DEF_TYPENAME";     // Fallthrough
@@ -704,14 +1080,22 @@ string flagnames(unsigned flags) {
       case DEF_PROTECTED:    flagnamemap[DEF_PROTECTED]    = "DEF_PROTECTED";    // Fallthrough
       case DEF_INCOMPLETE:   flagnamemap[DEF_INCOMPLETE]   = "DEF_INCOMPLETE";   // Fallthrough
       case DEF_ATOMIC:       flagnamemap[DEF_ATOMIC]       = "DEF_ATOMIC";       // Fallthrough
+      case DEF_FROZEN:       flagnamemap[DEF_FROZEN]       = "DEF_FROZEN";       // Fallthrough
       default: ;
     }
   }
+  return flagnamemap;
+}
+string flagnames(unsigned flags) {
+  // Built once, on first use; safe to read from several threads.
+  static const map<int, string> flagnamemap = build_flagnamemap();
   string res;
   bool hadone = false;
   for (int i = 1; i < (1 << 30); i <<= 1)
-    if (flags & i)
-      res += (hadone? " | " : "") + flagnamemap[i], hadone = true;
+    if (flags & i) {
+      auto it = flagnamemap.find(i);
+      res += (hadone? " | " : "") + (it != flagnamemap.end()? it->second : string()), hadone = true;
+    }
   return res;
 }
 
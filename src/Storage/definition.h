@@ -84,6 +84,14 @@ struct definition {
   /// Returns the size of this definition, as returned by the sizeof operator.
   virtual value size_of(const ErrorContext &errc);
 
+  /** Prepare this definition and everything it owns for concurrent readers.
+  Freezing happens in two sweeps. The first, with \p seal false, materializes
+  any state that would otherwise be built lazily on lookup; it is repeated
+  until it finds nothing left to do. The second marks everything DEF_FROZEN.
+  @param seal  False to materialize pending state, true to mark frozen.
+  @return Whether anything was materialized by this sweep. */
+  virtual bool freeze(bool seal);
+
   /** Compare two definitions, returning a comparison sign.
   @param d1  The first definition to compare.
   @param d2  The second definition to compare.
@@ -215,7 +223,8 @@ struct definition_overload: definition_typed {
   string toString(unsigned levels = unsigned(-1), unsigned indent = 0) const override;
 
   definition_overload(string name, definition* p, definition* tp, const ref_stack &rf, unsigned int typeflags, int flags = DEF_FUNCTION);
-  ~definition_overload() override = default;
+  /// Frees the implementation with \c delete_function_implementation.
+  ~definition_overload() override;
 };
 
 /// A piece of a definition specifically for functions.
@@ -237,6 +246,7 @@ struct definition_function: definition {
   unique_ptr<definition> duplicate(remap_set &n) const override;
   virtual void remap(remap_set &n, const ErrorContext &errc);
   virtual value size_of(const ErrorContext &errc);
+  bool freeze(bool seal) override;
   string toString(unsigned levels = unsigned(-1), unsigned indent = 0) const override;
 
   /** Function to add the given definition as an overload if no such overload
@@ -244,13 +254,15 @@ struct definition_function: definition {
       @param tp        The full_type giving the return type and parameters.
       @param addflags  Any additional flags to be assigned to the overload.
       @param herr      Error handler to report problems to.
+      @param created   If given, set to whether a new overload was created.
       @return Returns the final definition for the requested overload.
   */
   definition_overload *overload(const full_type &tp, unsigned addflags,
-                                ErrorContext errc);
+                                ErrorContext errc, bool *created = nullptr);
   definition_overload *overload(definition* tp, const ref_stack &rf,
                                 unsigned int typeflags, unsigned addflags,
-                                void *implementation, ErrorContext errc);
+                                void *implementation, ErrorContext errc,
+                                bool *created = nullptr);
 
   /** Function to add the given definition as a template overload
       exists, or to merge it in (handling any errors) otherwise.
@@ -260,6 +272,19 @@ struct definition_function: definition {
   */
   void overload(unique_ptr<definition_template> ovrl, ErrorContext errc);
 
+  /** Copy in the overloads of a function which this one hides, such as one
+      of the same name in the base of a layered context, so that both sets
+      are found here. Overloads this function already has are kept.
+      @param hidden  The function whose overloads to copy.
+      @param errc    Where to report problems remapping template overloads. */
+  void inherit(const definition_function *hidden, ErrorContext errc);
+
+  /** Free one overload or template overload of this function, leaving the
+      function itself in place, even if it is left without any.
+      @param ovr  The overload or template overload to free.
+      @return Returns whether the overload was found. */
+  bool discard(const definition *ovr);
+
   /// Create a function with one overload, created from the given ref_stack.
   definition_function(string name, definition* p, definition* tp,
                       const ref_stack &rf, unsigned int typeflags,
@@ -328,6 +353,19 @@ struct definition_scope: definition {
   /// A deque listing all declaraions (and dependent object references) in this scope, in order.
   /// May contain duplicates.
   ordeque dec_order;
+
+  /// Reads in the members of a scope the first time they are wanted.
+  /// See \c Context::load_mapped().
+  struct deferred_members {
+    /// Fill in the members, C structs, and declaration order of the given scope.
+    virtual void decode(definition_scope *into) = 0;
+    virtual ~deferred_members() = default;
+  };
+  /// The members of this scope which have not been read in yet, if any. While
+  /// this is set, \c members, \c c_structs, and \c dec_order are empty.
+  unique_ptr<deferred_members> deferred;
+  /// Read in any deferred members; returns whether there were any.
+  bool undefer() { return deferred && decode_deferred(); }
   /** Function to insert into c_structs by the rules of definition_scope::declare.
       @param name  The name of the definition to declare.
       @param def   Pointer to the definition being declared, if one is presently available.
@@ -394,10 +432,12 @@ struct definition_scope: definition {
                 or DEF_VIRTUAL.
   @param errtok A token referenced for error reporting purposes.
   @param herr   An error handler to receieve errors.
+  @param created If given, set to whether a new overload was created.
   @return Returns the definition_overload corresponding to the overload with the
           given parameters, or nullptr if an error occurred. */
   definition_overload *overload_function(string name, full_type &tp,
-                                         unsigned flags, ErrorContext errc);
+                                         unsigned flags, ErrorContext errc,
+                                         bool *created = nullptr);
   /** Function to add the given definition as a template overload of a function.
   @param name   The function name.
   @param ovrl   The template definition representing the new overload;
@@ -416,6 +456,7 @@ struct definition_scope: definition {
   unique_ptr<definition> duplicate(remap_set &n) const override;
   virtual void remap(remap_set &n, const ErrorContext &errc);
   virtual value size_of(const ErrorContext &errc);
+  bool freeze(bool seal) override;
   string toString(unsigned levels = unsigned(-1), unsigned indent = 0) const override;
 
   /// Default constructor. Only to be used for global!
@@ -427,6 +468,9 @@ struct definition_scope: definition {
   /// @param  flags  The type of this scope, such as DEF_NAMESPACE.
   definition_scope(string name, definition *parent, unsigned int flags);
   ~definition_scope() override = default;
+
+ private:
+  bool decode_deferred();
 };
 
 /// An extension of \c jdi::definition_scope for classes and structures,
@@ -448,10 +492,38 @@ struct definition_class: definition_scope {
   /// A collection of all our friends.
   set<definition*> friends;
 
+  /** State of a template instantiation whose members have not all been copied
+  out of the template's pattern class yet. Members are duplicated and remapped
+  as they are looked up, walking the pattern's declaration order, so that any
+  earlier member a declaration refers to is already mapped. */
+  struct lazy_instance {
+    /// The class being instantiated; owned by the template.
+    const definition_class *pattern;
+    /// Template parameters and the pattern members materialized so far.
+    remap_set remap;
+    /// Index of the next entry in the pattern's `dec_order` to materialize.
+    size_t next_ordered = 0;
+    /// Receives any problems met while materializing members.
+    ErrorContext errc;
+    /// Nesting depth of materialize calls in progress.
+    unsigned depth = 0;
+    lazy_instance(const definition_class *p, remap_set &&n, ErrorContext e):
+        pattern(p), remap(std::move(n)), errc(e) {}
+  };
+  /// Non-null while this instantiation still has members to materialize.
+  unique_ptr<lazy_instance> lazy;
+
+  /// If this is a lazy instantiation, materialize the member(s) of the given
+  /// name, along with anything declared before them.
+  void materialize(const string &name);
+  /// Materialize every remaining member of a lazy instantiation.
+  void materialize_all();
+
   virtual string kind() const;
   unique_ptr<definition> duplicate(remap_set &n) const override;
   virtual void remap(remap_set &n, const ErrorContext &errc);
   virtual value size_of(const ErrorContext &errc);
+  bool freeze(bool seal) override;
   string toString(unsigned levels = unsigned(-1), unsigned indent = 0) const override;
 
   virtual definition* look_up(string name); ///< Look up a definition in this class (including its ancestors).
@@ -564,6 +636,38 @@ struct definition_template: definition_scope {
   /// Constant map iterator type for specializations
   typedef speclist::const_iterator speciter_c;
 
+  /** Discrimination index over the specialization list, used to narrow the
+  candidates \c find_specialization must score. Each specialization is filed
+  under the first argument its filter pins down: a concrete definition, the
+  outermost referencer of an abstract type (the pointer in `T*`), or a literal
+  numeric value. Filters pinning nothing are kept aside as generic.
+  The index is brought up to date lazily, so specializations may still be
+  appended to \c specializations directly. Lookups on concrete keys are
+  memoized until another specialization is indexed. */
+  struct specialization_index {
+    /// Indices into `specializations`; kept ascending to preserve tie-breaks.
+    typedef vector<unsigned> bucket;
+    /// Number of specializations from the list which have been filed.
+    size_t indexed = 0;
+    /// Specializations whose filters are entirely abstract.
+    bucket generic;
+    /// Per argument position, specializations keyed by concrete definition.
+    vector<map<definition*, bucket>> by_type;
+    /// Per argument position, specializations keyed by referencer shape.
+    vector<map<ref_stack::ref_type, bucket>> by_shape;
+    /// Per argument position, specializations keyed by literal value.
+    vector<map<long double, bucket>> by_value;
+    /// Results of previous lookups on non-abstract keys.
+    map<arg_key, specialization*> memo;
+
+    /// File any specializations appended since the last call.
+    void update(const speclist &specs);
+    /// Gather the indices of specializations which may match the given key.
+    void candidates(const arg_key &key, bucket &out) const;
+    /// Discard everything; the next lookup re-files all specializations.
+    void clear();
+  };
+
   struct instantiation {
     unique_ptr<definition> def;
     vector<unique_ptr<definition>> parameter_defs;
@@ -581,14 +685,22 @@ struct definition_template: definition_scope {
 
   /// A map of all specializations.
   speclist specializations;
+  /// Lookup index over `specializations`; see \c specialization_index.
+  mutable specialization_index specialization_lookup;
   /// A map of all existing instantiations.
   instmap instantiations;
   /// A listing of all dependent members of this template. These are definitions
   /// that must be reinterpreted once all parameters are known.
   deplist dependents;
 
+  /// Nonzero once this template is frozen; tells its thread-private
+  /// instantiations apart from those of any template it was freed before.
+  unsigned long frozen_serial = 0;
+
   /// Instantiate this template with the values given in the passed key. If this
   /// template has been instantiated previously, that instantiation is returned.
+  /// A frozen template cannot record new instantiations; those it lacks are
+  /// filed in the calling thread's \c frozen_instantiations store.
   /// @param key   The \c arg_key structure containing the template parameter
   ///              values to use.
   /// @param errc  The \c ErrorContext to which any problems will be reported.
@@ -598,6 +710,7 @@ struct definition_template: definition_scope {
   unique_ptr<definition> duplicate(remap_set &n) const override;
   virtual void remap(remap_set &n, const ErrorContext &errc);
   virtual value size_of(const ErrorContext &errc);
+  bool freeze(bool seal) override;
   string toString(unsigned levels = unsigned(-1), unsigned indent = 0) const override;
 
   /** Construct with name, parent, and flags **/
@@ -606,6 +719,63 @@ struct definition_template: definition_scope {
   ~definition_template() override = default;
 };
 
+/** Instantiations of frozen templates, which cannot record new instantiations
+themselves. Each thread files them in the store it is currently using: by
+default, one of its own which lives until the thread exits. A context which
+parses over a frozen base uses a store of its own instead, so that anything
+it instantiates lives as long as it does. The same goes for specializations
+such a context declares of templates in its base. */
+class frozen_instantiations {
+  struct entry {
+    /// The \c frozen_serial of the template these were made for.
+    unsigned long serial = 0;
+    definition_template::instmap instantiations;
+    definition_template::speclist specializations;
+  };
+  map<const definition_template*, entry> entries;
+  /// Returns our entry for the given template, or null if we have none.
+  const entry *find(const definition_template *temp) const;
+  /// Returns our entry for the given template, discarding any stale one.
+  entry &get(const definition_template *temp);
+
+ public:
+  /// The store of the context ours is layered over, if any. Its contents are
+  /// visible through ours, read-only.
+  const frozen_instantiations *base = nullptr;
+
+  /// Return this store's instantiation map for the given frozen template.
+  definition_template::instmap &of(const definition_template *temp);
+  /// Return this store's list of added specializations of the given template.
+  definition_template::speclist &specializations_of(
+      const definition_template *temp);
+  /// Look up an instantiation of the given template here or in our bases.
+  definition *find_instantiation(const definition_template *temp,
+                                 const arg_key &key) const;
+  /// Look up the arguments with which the given instantiation, filed here or
+  /// in our bases, was made; null if it was not filed in any of them.
+  const arg_key *key_of(const definition_template *temp,
+                        const definition *inst) const;
+  /// Score the specializations of the given template filed here or in our
+  /// bases against the given key, keeping the best over \p merit.
+  void find_specialization(const definition_template *temp, const arg_key &key,
+                           definition_template::specialization *&spec,
+                           int &merit) const;
+  /// Freeze everything filed here, as \c definition::freeze().
+  bool freeze(bool seal);
+  /// Return the store the calling thread is currently using.
+  static frozen_instantiations &current();
+
+  /// Directs the calling thread's instantiations of frozen templates into the
+  /// given store for the lifetime of this object.
+  class use {
+    frozen_instantiations *previous;
+   public:
+    use(frozen_instantiations &store);
+    ~use();
+    use(const use&) = delete;
+  };
+};
+
 /// A definition inheriting from definition_class, which is meant to represent
 /// a template parameter. Definitions in this class are considered hypothetical;
 /// they must exist in the type speicified to the template (in standard speak,
@@ -656,6 +826,7 @@ struct definition_tempparam: definition_class {
   decpair declare(string name, unique_ptr<definition> = nullptr) override;
   /// Behaves identically to declare if the given name does not exist, or else
   /// returns it. In either case, the returned definition will be HYPOTHETICAL.
+  /// Once frozen, this only finds existing members.
   definition* get_local(string name) override;
 
   ~definition_tempparam() override = default;
@@ -24,6 +24,7 @@
 **/
 
 #include "definition.h"
+#include <API/parse_stats.h>
 #include <General/utils.h>
 #include <iostream>
 
@@ -35,6 +36,7 @@ using std::make_unique;
 namespace jdi {
 
 void definition_scope::copy(const definition_scope* from, remap_set &n) {
+  const_cast<definition_scope*>(from)->undefer();
   for (defiter_c it = from->members.begin(); it != from->members.end(); it++)
   #ifdef DEBUG_MODE
   if (it->second == nullptr) {
@@ -72,6 +74,68 @@ void definition_scope::copy(const definition_scope* from, remap_set &n) {
   using_general = from->using_general;
 }
 
+/// Duplicate one member of a lazy instance's pattern into the instance, then
+/// remap it with everything materialized so far. Mirrors what copy() and
+/// remap() would have done for that member alone.
+static void materialize_member(definition_class *inst, const string &name,
+                               const definition *def, bool is_c_struct) {
+  definition_class::lazy_instance &lazy = *inst->lazy;
+  if (!def || lazy.remap.find(def) != lazy.remap.end()) return;
+  if (!is_c_struct && (def->flags & (DEF_CLASS | DEF_ENUM | DEF_UNION))) return;
+  definition_scope::defmap &dest = is_c_struct? inst->c_structs : inst->members;
+  definition_scope::inspair ins = dest.insert(definition_scope::entry(name, nullptr));
+  if (!ins.second) return; // Declared on the instance itself; keep that one.
+  ParseStats::timer instantiating(ParseStats::INSTANTIATION);
+  ins.first->second = def->duplicate(lazy.remap);
+  inst->dec_order.push_back(ins.first);
+  ins.first->second->remap(lazy.remap, lazy.errc);
+}
+
+/// Materialize the next entry in the pattern's declaration order.
+static void materialize_next(definition_class *inst) {
+  definition_class::lazy_instance &lazy = *inst->lazy;
+  const definition_scope::defiter &it = lazy.pattern->dec_order[lazy.next_ordered++];
+  auto cs = lazy.pattern->c_structs.find(it->first);
+  bool is_c_struct = cs != lazy.pattern->c_structs.end() && cs->second == it->second;
+  materialize_member(inst, it->first, it->second.get(), is_c_struct);
+}
+
+void definition_class::materialize(const string &sname) {
+  if (!lazy || (flags & DEF_FROZEN)) return;
+  const definition_class *pat = lazy->pattern;
+  const definition *want[2] = { nullptr, nullptr };
+  if (auto it = pat->members.find(sname); it != pat->members.end())
+    want[0] = it->second.get();
+  if (auto it = pat->c_structs.find(sname); it != pat->c_structs.end())
+    want[1] = it->second.get();
+  auto pending = [this, &want](int i) {
+    return want[i] && lazy->remap.find(want[i]) == lazy->remap.end();
+  };
+  ++lazy->depth;
+  while ((pending(0) || pending(1)) && lazy->next_ordered < pat->dec_order.size())
+    materialize_next(this);
+  // Not everything is listed in the declaration order; fetch stragglers.
+  if (pending(0)) materialize_member(this, sname, want[0], false);
+  if (pending(1)) materialize_member(this, sname, want[1], true);
+  --lazy->depth;
+}
+
+void definition_class::materialize_all() {
+  if (!lazy || (flags & DEF_FROZEN)) return;
+  const definition_class *pat = lazy->pattern;
+  ++lazy->depth;
+  while (lazy->next_ordered < pat->dec_order.size())
+    materialize_next(this);
+  for (defiter_c it = pat->members.begin(); it != pat->members.end(); ++it)
+    materialize_member(this, it->first, it->second.get(), false);
+  for (defiter_c it = pat->c_structs.begin(); it != pat->c_structs.end(); ++it)
+    materialize_member(this, it->first, it->second.get(), true);
+  // A lookup made while remapping a member may have brought us here; leave
+  // the state to the outermost caller.
+  if (!--lazy->depth)
+    lazy = nullptr;
+}
+
 //========================================================================================================
 //======: Duplicators :===================================================================================
 //========================================================================================================
@@ -89,6 +153,8 @@ unique_ptr<definition> definition::duplicate(remap_set &n) const {
 }
 
 unique_ptr<definition> definition_class::duplicate(remap_set &n) const {
+  // Materializing only realizes members this instance already has.
+  const_cast<definition_class*>(this)->materialize_all();
   auto res = make_unique<definition_class>(name, parent, flags);
   res->definition_scope::copy(this, n);
   res->ancestors = ancestors;
@@ -235,6 +301,7 @@ void definition::remap(remap_set &n, const ErrorContext &) {
 
 void definition_scope::remap(remap_set &n, const ErrorContext &errc) {
   definition::remap(n, errc);
+  undefer();
   // cout << "Scope `" << name << "' has " << dec_order.size() << " ordered members" << endl;
   for (orditer it = dec_order.begin(); it != dec_order.end(); ++it) {
     definition *def = (*it)->second.get();
@@ -265,6 +332,7 @@ void definition_scope::remap(remap_set &n, const ErrorContext &errc) {
 }
 
 void definition_class::remap(remap_set &n, const ErrorContext &errc) {
+  materialize_all();
   definition_scope::remap(n, errc);
   for (vector<ancestor>::iterator it = ancestors.begin(); it != ancestors.end(); ++it) {
     ancestor& an = *it;
@@ -372,6 +440,7 @@ void definition_template::remap(remap_set &n, const ErrorContext &errc) {
     it->second->def->remap(n, errc);
   for (speciter it = specializations.begin(); it != specializations.end(); ++it)
     (*it)->spec_temp->remap(n, errc);
+  specialization_lookup.clear();
   if (def)
     def->remap(n, errc);
 }
@@ -443,7 +512,30 @@ void arg_key::remap(const remap_set &r, const ErrorContext &errc) {
 //========================================================================================================
 
 unique_ptr<AST> AST::duplicate() const {
-  return make_unique<AST>(root->duplicate());
+  return make_unique<AST>(*this, true);
+}
+AST::AST(const AST &ast, bool):
+    arena(ast.arena), root(ast.root), program(ast.program),
+    substitutions(ast.substitutions), tt_greater_is_op(ast.tt_greater_is_op),
+    treat_identifiers_as_zero(ast.treat_identifiers_as_zero) {}
+
+void AST::unshare(const ErrorContext &errc) {
+  program.reset();
+  if (!root || (root.use_count() == 1 && substitutions.empty())) return;
+  if (root.use_count() > 1) {
+    root = root->duplicate();
+    arena.reset();
+  }
+  if (!substitutions.empty()) {
+    root->remap(substitutions, errc);
+    substitutions.clear();
+  }
+}
+const AST &AST::substituted(AST &scratch, const ErrorContext &errc) const {
+  if (substitutions.empty()) return *this;
+  scratch.root = root->duplicate();
+  scratch.root->remap(substitutions, errc);
+  return scratch;
 }
 
 unique_ptr<AST_Node> AST_Node::duplicate() const {
@@ -462,6 +554,9 @@ unique_ptr<AST_Node> AST_Node_sizeof::duplicate() const {
 unique_ptr<AST_Node> AST_Node_Definition::duplicate() const {
   return make_unique<AST_Node_Definition>(def, content);
 }
+unique_ptr<AST_Node> AST_Node_Constant::duplicate() const {
+  return make_unique<AST_Node_Constant>(content, val, val_type);
+}
 unique_ptr<AST_Node> AST_Node_Type::duplicate() const {
   full_type dt(dec_type);
   return make_unique<AST_Node_Type>(dt);
@@ -542,8 +637,9 @@ void AST_Node_Definition::remap(const remap_set& n, ErrorContext) {
 void AST_Node_Type::remap(const remap_set& n, ErrorContext) {
   dec_type.def  = filter(dec_type.def,  n);
 }
-void AST_Node_Cast::remap(const remap_set& n, ErrorContext) {
+void AST_Node_Cast::remap(const remap_set& n, ErrorContext errc) {
   cast_type.def = filter(cast_type.def, n);
+  nremap(operand, n, errc);
 }
 void AST_Node_Binary::remap(const remap_set& n, ErrorContext errc) {
   nremap(left, n, errc);
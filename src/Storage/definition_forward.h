@@ -51,7 +51,8 @@ enum DEF_FLAGS {
   DEF_PRIVATE =      1 << 15, ///< This definition was declared as a private member.
   DEF_PROTECTED =    1 << 16, ///< This definition was declared as a protected member.
   DEF_INCOMPLETE =   1 << 17, ///< This definition was declared but not implemented.
-  DEF_ATOMIC =       1 << 18  ///< This is a global definition for objects of a fixed size, such as primitives.
+  DEF_ATOMIC =       1 << 18, ///< This is a global definition for objects of a fixed size, such as primitives.
+  DEF_FROZEN =       1 << 19  ///< This definition belongs to a frozen context and must not be modified.
 };
 
 struct definition;
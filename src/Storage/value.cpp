@@ -19,101 +19,134 @@
  * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
 **/
 
+
 #include "value.h"
 #include <cstdio>
-#include <cstring>
 #include <cfloat>
 #include <cmath>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
 
 namespace jdi {
-  value::value():                       real(),  str(),  type(VT_NONE) {}
-  value::value(float v):                real(v), str(),  type(VT_DOUBLE) {}
-  value::value(double v):               real(v), str(),  type(VT_DOUBLE) {}
-  value::value(long double v):          real(v), str(),  type(VT_DOUBLE) {}
-  value::value(signed v):               real(v), str(),  type(VT_INTEGER) {}
-  value::value(signed long v):          real(v), str(),  type(VT_INTEGER) {}
-  value::value(signed long long v):     real(v), str(),  type(VT_INTEGER) {}
-  value::value(unsigned v):             real(v), str(),  type(VT_INTEGER) {}
-  value::value(unsigned long v):        real(v), str(),  type(VT_INTEGER) {}
-  value::value(unsigned long long v):   real(v), str(),  type(VT_INTEGER) {}
-  value::value(const VT& t):            real(),  str(),  type(t) {}
-  value::value(std::string v):          real(),  str(v), type(VT_STRING) {}
-  value::value(const value& v): real(v.real), str(v.str), type(v.type) {}
-  
+  namespace {
+    /// Every string a value has held. Strings in values come from literals
+    /// in the code, so there are few of them, and they are kept for good.
+    struct StringPool {
+      std::mutex lock;
+      std::deque<std::string> strings;
+      std::unordered_map<std::string_view, const std::string*> index;
+    };
+    const std::string *intern(std::string_view text) {
+      static StringPool pool;
+      std::lock_guard<std::mutex> guard(pool.lock);
+      auto it = pool.index.find(text);
+      if (it != pool.index.end()) return it->second;
+      const std::string &res = pool.strings.emplace_back(text);
+      pool.index.emplace(res, &res);
+      return &res;
+    }
+
+    /// Orders two numbers as C++ would after the usual arithmetic
+    /// conversions. Doubles within DBL_EPSILON of each other are equal.
+    int compare_numbers(const value &x, const value &y) {
+      if (x.type == VT_DOUBLE || y.type == VT_DOUBLE) {
+        const double a = x.as_double(), b = y.as_double();
+        if (fabs(a - b) <= DBL_EPSILON) return 0;
+        return a < b ? -1 : 1;
+      }
+      if (x.is_unsigned || y.is_unsigned)
+        return x.uinteger < y.uinteger ? -1 : x.uinteger > y.uinteger;
+      return x.integer < y.integer ? -1 : x.integer > y.integer;
+    }
+  }
+
+  value::value():                     integer(0), type(VT_NONE),    is_unsigned(false) {}
+  value::value(float v):              real(v),    type(VT_DOUBLE),  is_unsigned(false) {}
+  value::value(double v):             real(v),    type(VT_DOUBLE),  is_unsigned(false) {}
+  value::value(long double v):        real(v),    type(VT_DOUBLE),  is_unsigned(false) {}
+  value::value(signed v):             integer(v), type(VT_INTEGER), is_unsigned(false) {}
+  value::value(signed long v):        integer(v), type(VT_INTEGER), is_unsigned(false) {}
+  value::value(signed long long v):   integer(v), type(VT_INTEGER), is_unsigned(false) {}
+  value::value(unsigned v):           uinteger(v), type(VT_INTEGER), is_unsigned(true) {}
+  value::value(unsigned long v):      uinteger(v), type(VT_INTEGER), is_unsigned(true) {}
+  value::value(unsigned long long v): uinteger(v), type(VT_INTEGER), is_unsigned(true) {}
+  value::value(const VT& t):          integer(0), type(t),          is_unsigned(false) {}
+  value::value(std::string_view v):   str(intern(v)), type(VT_STRING), is_unsigned(false) {}
+  value::value(const std::string &v): value(std::string_view(v)) {}
+  value::value(const char *v):        value(std::string_view(v)) {}
+
+  double value::as_double() const {
+    if (type == VT_DOUBLE) return real;
+    if (type == VT_INTEGER) return is_unsigned ? (double) uinteger : (double) integer;
+    return 0;
+  }
+  long long value::as_integer() const {
+    if (type == VT_INTEGER) return integer;
+    if (type == VT_DOUBLE) return (long long) real;
+    return 0;
+  }
+  long double value::as_long_double() const {
+    if (type == VT_DOUBLE) return real;
+    if (type == VT_INTEGER)
+      return is_unsigned ? (long double) uinteger : (long double) integer;
+    return 0;
+  }
+
   std::string value::toString() const {
     char buf[128];
     switch (type) {
-      case VT_DOUBLE:    sprintf(buf, "%.32g", (double) real);      return buf;
-      case VT_INTEGER:   sprintf(buf, "%ld", (unsigned long) real); return buf;
-      case VT_STRING:    return str;
+      case VT_DOUBLE:    snprintf(buf, sizeof buf, "%.32g", real); return buf;
+      case VT_INTEGER:   return is_unsigned ? std::to_string(uinteger)
+                                            : std::to_string(integer);
+      case VT_STRING:    return *str;
       case VT_DEPENDENT: return "(<dependent value>)";
       case VT_NONE:      return "<nothing>";
       default:           return "<ERROR!>";
     }
   }
-  
-  value &value::operator=(value &&other) {
-    type = other.type;
-    if (type == VT_STRING) str = other.str;
-    else real = other.real;
-    return *this;
-  }
-  
+
   bool value::operator==(const value& other) const {
-    if ((this->type == VT_DOUBLE || this->type == VT_INTEGER) &&
-        (other.type == VT_DOUBLE || other.type == VT_INTEGER)) {
-      return fabs(real - other.real) <= DBL_EPSILON;
-    }
+    if (is_number() && other.is_number()) return !compare_numbers(*this, other);
     if (type == VT_STRING && other.type == VT_STRING) return str == other.str;
     return false;
   }
   bool value::operator!=(const value& other) const {
-    if ((this->type == VT_DOUBLE || this->type == VT_INTEGER) &&
-        (other.type == VT_DOUBLE || other.type == VT_INTEGER)) {
-      return fabs(real - other.real) > DBL_EPSILON;
-    }
+    if (is_number() && other.is_number()) return compare_numbers(*this, other);
     if (type == VT_STRING && other.type == VT_STRING) return str != other.str;
     return true;
   }
   bool value::operator>(const value& other) const {
-    if ((this->type == VT_DOUBLE || this->type == VT_INTEGER) &&
-        (other.type == VT_DOUBLE || other.type == VT_INTEGER)) {
-      return real > other.real;
-    }
-    if (type == VT_STRING && other.type == VT_STRING) return str > other.str;
+    if (is_number() && other.is_number()) return compare_numbers(*this, other) > 0;
+    if (type == VT_STRING && other.type == VT_STRING) return *str > *other.str;
     return false;
   }
   bool value::operator<(const value& other) const {
-    if ((this->type == VT_DOUBLE || this->type == VT_INTEGER) &&
-        (other.type == VT_DOUBLE || other.type == VT_INTEGER)) {
-      return real < other.real;
-    }
-    if (type == VT_STRING && other.type == VT_STRING) return str < other.str;
+    if (is_number() && other.is_number()) return compare_numbers(*this, other) < 0;
+    if (type == VT_STRING && other.type == VT_STRING) return *str < *other.str;
     return false;
   }
   bool value::operator>=(const value& other) const {
-    if ((this->type == VT_DOUBLE || this->type == VT_INTEGER) &&
-        (other.type == VT_DOUBLE || other.type == VT_INTEGER)) {
-      return real + DBL_EPSILON >= other.real;
-    }
-    if (type == VT_STRING && other.type == VT_STRING) return str >= other.str;
+    if (is_number() && other.is_number()) return compare_numbers(*this, other) >= 0;
+    if (type == VT_STRING && other.type == VT_STRING) return *str >= *other.str;
     return false;
   }
   bool value::operator<=(const value& other) const {
-    if ((this->type == VT_DOUBLE || this->type == VT_INTEGER) &&
-        (other.type == VT_DOUBLE || other.type == VT_INTEGER)) {
-      return real - DBL_EPSILON <= other.real;
-    }
-    if (type == VT_STRING && other.type == VT_STRING) return str <= other.str;
+    if (is_number() && other.is_number()) return compare_numbers(*this, other) <= 0;
+    if (type == VT_STRING && other.type == VT_STRING) return *str <= *other.str;
+    return false;
+  }
+
+  value::operator int()    const { return (int) as_integer(); }
+  value::operator long()   const { return (long) as_integer(); }
+  value::operator double() const { return as_double(); }
+  value::operator bool()   const {
+    if (type == VT_INTEGER) return integer;
+    if (type == VT_DOUBLE) return real > DBL_EPSILON || real < -DBL_EPSILON;
     return false;
   }
-  
-  value::operator int()    const { if (type == VT_INTEGER || type == VT_DOUBLE) return (int) real; return 0; }
-  value::operator long()   const { if (type == VT_INTEGER || type == VT_DOUBLE) return (long) real; return 0; }
-  value::operator double() const { if (type == VT_INTEGER || type == VT_DOUBLE) return (double) real; return 0; }
-  value::operator bool()   const { if (type == VT_INTEGER || type == VT_DOUBLE) return real > DBL_EPSILON || real < -DBL_EPSILON; return 0; }
   value::operator std::string_view() const {
-    if (type == VT_STRING) return str;
+    if (type == VT_STRING) return *str;
     return "";
   }
 }
@@ -22,6 +22,7 @@
 #ifndef _VALUE__H
 #define _VALUE__H
 #include <string>
+#include <string_view>
 #include <ostream>
 
 namespace jdi {
@@ -40,14 +41,22 @@ namespace jdi {
   /**
     @struct jdi::value
     A structure for storing and communicating data of varying types.
-    This structure can contain any value defined in \enum VT.
+    This structure can contain any value defined in \enum VT. It is a tag and
+    a single word of storage, so it is cheap to copy; integers are kept as
+    integers, and strings are interned, so that equal strings share storage
+    for the life of the program.
   **/
   struct value {
-    long double real;  ///< Numeric values, including unsigned longs.
-    std::string str;  ///< String values.
-    
+    union {
+      long long integer;            ///< Integer values, if \c type is VT_INTEGER.
+      unsigned long long uinteger;  ///< The same, if \c is_unsigned is set.
+      double real;                  ///< Floating-point values, if \c type is VT_DOUBLE.
+      const std::string *str;       ///< Interned string values, if \c type is VT_STRING.
+    };
+
     VT type;
-    
+    bool is_unsigned; ///< True if this is an integer of unsigned type.
+
     bool operator==(const value& value) const; ///< Test for strict equality, including type.
     bool operator!=(const value& value) const; ///< Test against strict equality, including type.
     bool operator>=(const value& value) const; ///< Test a strict greater-than or equal inequality, including type.
@@ -69,19 +78,27 @@ namespace jdi {
     value(unsigned v);
     value(unsigned long v);
     value(unsigned long long v);
-    /// Construct a new value representing a copy of the passed string.
-    /// This operates in O(N).
-    value(std::string v);
-    /// Copy a value. Handles allocation issues.
-    value(const value& v);
+    /// Construct a new value representing the passed string. The string is
+    /// interned, which is O(N) the first time it is seen.
+    value(std::string_view v);
+    value(const std::string &v);
+    value(const char *v);
     /// Construct with the default value of the given type.
     value(const VT& t);
 
-    value &operator=(const value&) = delete;
-    value &operator=(value&&);
-    
+    /// Returns whether this is a number; an integer or a double.
+    bool is_number() const { return type == VT_INTEGER || type == VT_DOUBLE; }
+    /// Returns this number as a double, or zero if this is not a number.
+    double as_double() const;
+    /// Returns this number as an integer, truncating doubles, or zero if this
+    /// is not a number.
+    long long as_integer() const;
+    /// Returns this number as a long double, which holds any of our integers
+    /// exactly; zero if this is not a number.
+    long double as_long_double() const;
+
     std::string toString() const; ///< Convert to a string, whatever the value is
-    
+
     operator int() const; ///< Cast to an int, returning zero if no valid cast exists.
     operator long() const; ///< Cast to a long int, returning zero if no valid cast exists.
     operator double() const; ///< Cast to a double, returning zero if no valid cast exists.
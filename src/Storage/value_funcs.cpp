@@ -20,155 +20,121 @@
 **/
 
 #include "value_funcs.h"
-#include <cstring>
 #include <cfloat>
 #include <cmath>
 
-static inline jdi::value strdupcat(const char* s1, const char* s2) {
-  int l1 = strlen(s1), l2 = strlen(s2)+1;
-  char* res = new char[l1+l2];
-  memcpy(res,s1,l1), memcpy(res+l1,s2,l2);
-  return jdi::value(res);
-}
-static inline long fcomp(double x, double y) { return fabs(x - y) < DBL_EPSILON; }
-static inline long fcomp(double x, long y) { return fabs(x - y) < DBL_EPSILON; }
-
 namespace jdi {
-  value values_add(const value& x, const value& y) {
-    if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
-      return value(VT_DEPENDENT);
-    if (((x.type == VT_DOUBLE  || y.type == VT_DOUBLE) &&
-         (x.type == VT_INTEGER || y.type == VT_INTEGER)) ||
-        (x.type == VT_DOUBLE && y.type == VT_DOUBLE)) {
-      return value(x.real + y.real);
+  namespace {
+    /** Applies an arithmetic operation to two numbers. The kernel is chosen by
+        the pair of their types, as by C++'s usual arithmetic conversions: in
+        double if either is a double, otherwise unsigned if either is unsigned,
+        and otherwise signed. Signed results wrap instead of overflowing.
+    **/
+    template<class Op> value arithmetic(const value &x, const value &y, Op op) {
+      if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
+        return value(VT_DEPENDENT);
+      if (!x.is_number() || !y.is_number())
+        return value();
+      if (x.type == VT_DOUBLE || y.type == VT_DOUBLE)
+        return value(op(x.as_double(), y.as_double()));
+      const unsigned long long res = op(x.uinteger, y.uinteger);
+      if (x.is_unsigned || y.is_unsigned) return value(res);
+      return value((long long) res);
     }
-    if (x.type == VT_INTEGER && y.type == VT_INTEGER) {
-      // TODO: Type promotion / integer truncation.
-      return value((long long) x.real + (long long) y.real);
+
+    /// Returns the bits of an integer, or of a double truncated to one.
+    unsigned long long bits_of(const value &x) {
+      return x.type == VT_DOUBLE ? (unsigned long long) x.as_integer()
+                                 : x.uinteger;
     }
-    if ((x.type == VT_INTEGER || x.type == VT_DOUBLE) && y.type == VT_STRING) {
-      size_t n = (size_t) x.real;
-      if (n >= y.str.length()) return value("");
-      return value(y.str.substr(n));
+    /// Applies a bitwise operation to two numbers, truncating doubles.
+    template<class Op> value bitwise(const value &x, const value &y, Op op) {
+      if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
+        return value(VT_DEPENDENT);
+      if (!x.is_number() || !y.is_number())
+        return value();
+      const unsigned long long res = op(bits_of(x), bits_of(y));
+      if (x.is_unsigned || y.is_unsigned) return value(res);
+      return value((long long) res);
     }
-    if (x.type == VT_STRING && (y.type == VT_DOUBLE || y.type == VT_INTEGER)) {
-      size_t n = (size_t) y.real;
-      if (n >= x.str.length()) return value("");
-      return value(x.str.substr(n));
+
+    /// Returns the count by which an integer may be shifted, or -1 if the
+    /// shift would be undefined.
+    int shift_count(const value &y) {
+      if (y.type != VT_INTEGER) return -1;
+      if (y.is_unsigned) return y.uinteger < 64 ? (int) y.uinteger : -1;
+      return y.integer >= 0 && y.integer < 64 ? (int) y.integer : -1;
     }
-    return value();
   }
-  value values_subtract(const value& x, const value& y) {
-    if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
-      return value(VT_DEPENDENT);
-    if (((x.type == VT_DOUBLE  || y.type == VT_DOUBLE) &&
-         (x.type == VT_INTEGER || y.type == VT_INTEGER)) ||
-        (x.type == VT_DOUBLE && y.type == VT_DOUBLE)) {
-      return value(x.real - y.real);
+
+  value values_add(const value& x, const value& y) {
+    if (x.is_number() && y.type == VT_STRING) {
+      size_t n = (size_t) x.as_integer();
+      if (n >= y.str->length()) return value("");
+      return value(std::string_view(*y.str).substr(n));
     }
-    if (x.type == VT_INTEGER && y.type == VT_INTEGER) {
-      // TODO: Type promotion / integer truncation.
-      return value((long long) x.real - (long long) y.real);
+    if (x.type == VT_STRING && y.is_number()) {
+      size_t n = (size_t) y.as_integer();
+      if (n >= x.str->length()) return value("");
+      return value(std::string_view(*x.str).substr(n));
     }
-    return value();
+    return arithmetic(x, y, [](auto a, auto b) { return a + b; });
+  }
+  value values_subtract(const value& x, const value& y) {
+    return arithmetic(x, y, [](auto a, auto b) { return a - b; });
   }
   value values_multiply(const value& x, const value& y) {
-    if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
-      return value(VT_DEPENDENT);
-    if (((x.type == VT_DOUBLE  || y.type == VT_DOUBLE) &&
-         (x.type == VT_INTEGER || y.type == VT_INTEGER)) ||
-        (x.type == VT_DOUBLE && y.type == VT_DOUBLE)) {
-      return value(x.real * y.real);
-    }
-    if (x.type == VT_INTEGER && y.type == VT_INTEGER) {
-      // TODO: Type promotion / integer truncation.
-      return value((long long) x.real * (long long) y.real);
-    }
-    return value();
+    return arithmetic(x, y, [](auto a, auto b) { return a * b; });
   }
   value values_divide(const value& x, const value& y) {
     if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
       return value(VT_DEPENDENT);
-    if (((x.type == VT_DOUBLE  || y.type == VT_DOUBLE) &&
-         (x.type == VT_INTEGER || y.type == VT_INTEGER)) ||
-        (x.type == VT_DOUBLE && y.type == VT_DOUBLE)) {
-      return value(x.real / y.real);
-    }
-    if (x.type == VT_INTEGER && y.type == VT_INTEGER) {
-      // TODO: Type promotion / integer truncation.
-      return value((long long) x.real / (long long) y.real);
-    }
-    return value();
+    if (!x.is_number() || !y.is_number())
+      return value();
+    if (x.type == VT_DOUBLE || y.type == VT_DOUBLE)
+      return value(x.as_double() / y.as_double());
+    if (!y.integer) return value();
+    if (x.is_unsigned || y.is_unsigned) return value(x.uinteger / y.uinteger);
+    // The quotient of the least integer by -1 doesn't fit; wrap it instead.
+    if (y.integer == -1) return value((long long) (0 - x.uinteger));
+    return value(x.integer / y.integer);
   }
   value values_modulo(const value& x, const value& y) {
     if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
       return value(VT_DEPENDENT);
-    if (((x.type == VT_DOUBLE  || y.type == VT_DOUBLE) &&
-         (x.type == VT_INTEGER || y.type == VT_INTEGER)) ||
-        (x.type == VT_DOUBLE && y.type == VT_DOUBLE)) {
-      return value(fmod(x.real, y.real));
-    }
-    if (x.type == VT_INTEGER && y.type == VT_INTEGER) {
-      // TODO: Type promotion / integer truncation.
-      return value((long long) x.real % (long long) y.real);
-    }
-    return value();
+    if (!x.is_number() || !y.is_number())
+      return value();
+    if (x.type == VT_DOUBLE || y.type == VT_DOUBLE)
+      return value(fmod(x.as_double(), y.as_double()));
+    if (!y.integer) return value();
+    if (x.is_unsigned || y.is_unsigned) return value(x.uinteger % y.uinteger);
+    if (y.integer == -1) return value(0LL);
+    return value(x.integer % y.integer);
   }
   value values_lshift(const value& x, const value& y) {
     if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
       return value(VT_DEPENDENT);
-    if (((x.type == VT_DOUBLE  || y.type == VT_DOUBLE) &&
-         (x.type == VT_INTEGER || y.type == VT_INTEGER)) ||
-        (x.type == VT_DOUBLE && y.type == VT_DOUBLE)) {
-      return value(x.real / pow(2, y.real));
-    }
-    if (x.type == VT_INTEGER && y.type == VT_INTEGER) {
-      // TODO: Type promotion / integer truncation.
-      return value((long long) x.real << (long long) y.real);
-    }
-    return value();
+    const int n = shift_count(y);
+    if (x.type != VT_INTEGER || n < 0) return value();
+    if (x.is_unsigned) return value(x.uinteger << n);
+    return value((long long) (x.uinteger << n));
   }
   value values_rshift(const value& x, const value& y) {
     if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
       return value(VT_DEPENDENT);
-    if (((x.type == VT_DOUBLE  || y.type == VT_DOUBLE) &&
-         (x.type == VT_INTEGER || y.type == VT_INTEGER)) ||
-        (x.type == VT_DOUBLE && y.type == VT_DOUBLE)) {
-      return value(x.real * pow(2, y.real));
-    }
-    if (x.type == VT_INTEGER && y.type == VT_INTEGER) {
-      // TODO: Type promotion / integer truncation.
-      // TODO: Sign extension.
-      return value((long long) x.real >> (long long) y.real);
-    }
-    return value();
+    const int n = shift_count(y);
+    if (x.type != VT_INTEGER || n < 0) return value();
+    if (x.is_unsigned) return value(x.uinteger >> n);
+    return value(x.integer >> n);
   }
   value values_bitand(const value& x, const value& y) {
-    if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
-      return value(VT_DEPENDENT);
-    if ((x.type == VT_INTEGER || x.type == VT_DOUBLE) &&
-        (y.type == VT_INTEGER || y.type == VT_DOUBLE)) {
-      return value((long long) x.real & (long long) y.real);
-    }
-    return value();
+    return bitwise(x, y, [](auto a, auto b) { return a & b; });
   }
   value values_bitor(const value& x, const value& y) {
-    if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
-      return value(VT_DEPENDENT);
-    if ((x.type == VT_INTEGER || x.type == VT_DOUBLE) &&
-        (y.type == VT_INTEGER || y.type == VT_DOUBLE)) {
-      return value((long long) x.real | (long long) y.real);
-    }
-    return value();
+    return bitwise(x, y, [](auto a, auto b) { return a | b; });
   }
   value values_bitxor(const value& x, const value& y) {
-    if (x.type == VT_DEPENDENT || y.type == VT_DEPENDENT)
-      return value(VT_DEPENDENT);
-    if ((x.type == VT_INTEGER || x.type == VT_DOUBLE) &&
-        (y.type == VT_INTEGER || y.type == VT_DOUBLE)) {
-      return value((long long) x.real ^ (long long) y.real);
-    }
-    return value();
+    return bitwise(x, y, [](auto a, auto b) { return a ^ b; });
   }
   
   inline bool known(const value &x) { return x.type == VT_DOUBLE || x.type == VT_INTEGER || x.type == VT_STRING; }
@@ -239,30 +205,29 @@ namespace jdi {
 
   value value_unary_increment(const value& x) {
     if (x.type == VT_DOUBLE) return value(x.real + 1);
-    if (x.type == VT_INTEGER) return value((long long) x.real + 1);
+    if (x.type == VT_INTEGER) return values_add(x, value(1));
     if (x.type == VT_DEPENDENT) return value(VT_DEPENDENT);
     return value();
   }
   value value_unary_decrement(const value& x) {
     if (x.type == VT_DOUBLE) return value(x.real - 1);
-    if (x.type == VT_INTEGER) return value((long long) x.real - 1);
+    if (x.type == VT_INTEGER) return values_subtract(x, value(1));
     if (x.type == VT_DEPENDENT) return value(VT_DEPENDENT);
     return value();
   }
   value value_unary_positive(const value& x) {
-    if (x.type == VT_DOUBLE) return value(+x.real);
-    if (x.type == VT_INTEGER) return value(+(long long) x.real);
+    if (x.is_number()) return x;
     if (x.type == VT_DEPENDENT) return value(VT_DEPENDENT);
     return value();
   }
   value value_unary_negative(const value& x) {
     if (x.type == VT_DOUBLE) return value(-x.real);
-    if (x.type == VT_INTEGER) return value(-(long long) x.real);
+    if (x.type == VT_INTEGER) return values_subtract(value(0), x);
     if (x.type == VT_DEPENDENT) return value(VT_DEPENDENT);
     return value();
   }
   value value_unary_dereference(const value& x) {
-    if (x.type == VT_STRING) return value((long) (x.str.empty() ? 0 : x.str[0]));
+    if (x.type == VT_STRING) return value((long) (x.str->empty() ? 0 : (*x.str)[0]));
     if (x.type == VT_INTEGER) return value();
     if (x.type == VT_DEPENDENT) return value(VT_DEPENDENT);
     return value();
@@ -271,14 +236,14 @@ namespace jdi {
     return value();
   }
   value value_unary_negate(const value& x) {
-    if (x.type == VT_DOUBLE) return value(~(long long) x.real);
-    if (x.type == VT_INTEGER) return value(~(long long) x.real);
+    if (x.type == VT_DOUBLE) return value(~x.as_integer());
+    if (x.type == VT_INTEGER && x.is_unsigned) return value(~x.uinteger);
+    if (x.type == VT_INTEGER) return value(~x.integer);
     if (x.type == VT_DEPENDENT) return value(VT_DEPENDENT);
     return value();
   }
   value value_unary_not(const value& x) {
-    if (x.type == VT_DOUBLE) return value(!(bool) x);
-    if (x.type == VT_INTEGER) return value(!(bool) x);
+    if (x.is_number()) return value(!(bool) x);
     if (x.type == VT_DEPENDENT) return value(VT_DEPENDENT);
     return value();
   }
@@ -28,6 +28,8 @@
 #include <API/AST.h>
 #include <API/compile_settings.h>
 #include <API/context.h>
+#include <API/parse_stats.h>
+#include <API/parse_trace.h>
 #include <General/debug_macros.h>
 #include <General/parse_basics.h>
 #include <General/debug_macros.h>
@@ -164,6 +166,7 @@ static inline StringPrefixFlags parse_string_prefix(string_view pre) {
 }
 
 void lexer::enter_macro(const token_t &otk, const macro_type &macro) {
+  ParseStats::count(&ParseStats::macros_expanded);
   if (macro.optimized_value.empty()) return;
   push_buffer({macro.name, otk, &macro.optimized_value});
 }
@@ -232,9 +235,11 @@ static inline bool skip_rstring(llreader &cfile, ErrorHandler *herr) {
 
 token_t jdi::read_token(llreader &cfile, ErrorHandler *herr) {
   #ifdef DEBUG_MODE
-    static int number_of_times_GDB_has_dropped_its_ass = 0;
+    static thread_local int number_of_times_GDB_has_dropped_its_ass = 0;
     ++number_of_times_GDB_has_dropped_its_ass;
   #endif
+  ParseStats::timer lexing(ParseStats::LEXING);
+  ParseStats::count(&ParseStats::tokens);
 
   if (cfile.pos < cfile.length) { // Sanity check the stupid reader.
     if (cfile.pos < cfile.validated_pos) {
@@ -264,7 +269,7 @@ token_t jdi::read_token(llreader &cfile, ErrorHandler *herr) {
   // Dear C++ committee: do you know what would be exponentially more awesome
   // than this line? Just declaring a normal fucking function, please and thanks
   auto mktok = [&cfile](TOKEN_TYPE tp, size_t pos, int length) -> token_t {
-    return token_t(tp, cfile.name, cfile.lnum, pos - cfile.lpos,
+    return token_t(tp, cfile.get_file_id(), cfile.lnum, pos - cfile.lpos,
                    cfile + pos, length);
   };
 
@@ -468,7 +473,7 @@ token_t jdi::read_token(llreader &cfile, ErrorHandler *herr) {
           cfile.advance();
           return mktok(TT_XOR_ASSIGN, spos, 2);
         }
-        return mktok(TT_NOT, spos, 1);
+        return mktok(TT_CARET, spos, 1);
       case '>':
         if (cfile.at() == '>') {
           cfile.advance();
@@ -517,7 +522,7 @@ token_t jdi::read_token(llreader &cfile, ErrorHandler *herr) {
           }
           if (cfile.at() == '*') {
             cfile.advance();
-            return mktok(TT_DOT_STAR, spos, 1);
+            return mktok(TT_DOT_STAR, spos, 2);
           }
         return mktok(TT_DOT, spos, 1);
 
@@ -669,6 +674,7 @@ bool lexer::parse_macro_function(const token_t &otk, const macro_type &mf) {
 
   token_vector tokens = mf.substitute_and_unroll(args, evald, herr->at(otk));
   push_buffer({mf.name, otk, std::move(tokens)});
+  ParseStats::count(&ParseStats::macros_expanded);
   return true;
 }
 
@@ -825,6 +831,7 @@ kPreprocessorDirectives {
 };
 
 void lexer::handle_preprocessor() {
+  ParseStats::timer directives(ParseStats::DIRECTIVES);
   top:
   token_t tk = read_token(cfile, herr);
   while (tk.preprocesses_away()) tk = read_token(cfile, herr);
@@ -1101,12 +1108,19 @@ void lexer::handle_preprocessor() {
         }
 
         llreader incfile =
-            try_find_and_open(cfile, builtin, fnfind, chklocal, incnext);
+            try_find_and_open(cfile, includes, fnfind, chklocal, incnext);
         if (!incfile.is_open()) {
           herr->error(cfile, incnext ? "Could not find next %s"
                                      : "Could not find %s", fnfind);
         }
 
+        if (incfile.is_open()) {
+          ParseStats::count(&ParseStats::files_opened);
+          ParseStats::count(&ParseStats::bytes_mapped, incfile.length);
+        }
+        ParseTrace *const trace = ParseTrace::current();
+        file_spans.push_back(trace ? trace->begin(ParseTrace::SOURCE_FILE, incfile.name)
+                                   : size_t(-1));
         files.emplace_back(std::move(cfile));
         visited_files.insert(incfile.name).first;
         cfile.consume(incfile);
@@ -1231,6 +1245,7 @@ const map<string, long> kAttributeSupportDate {
 };
 
 bool lexer::handle_macro(token_t &identifier) {
+  ParseStats::timer expanding(ParseStats::MACROS);
   if (identifier.type != TT_IDENTIFIER) {
     herr->error(identifier, "Internal error: Not an identifier: %s",
                 identifier.to_string());
@@ -1261,7 +1276,8 @@ bool lexer::handle_macro(token_t &identifier) {
     case LexerKeyword::FILENAME: {
       // The current token was probably defined in a macro.
       // Prefer the name of the currently-open file.
-      identifier.content = quote(cfile.is_open() ? cfile.name : identifier.file);
+      identifier.content = quote(cfile.is_open() ? cfile.name
+                                                 : string(identifier.get_filename()));
       identifier.type = TT_STRINGLITERAL;
       return false;
     }
@@ -1335,7 +1351,7 @@ bool lexer::handle_macro(token_t &identifier) {
                          "`__has_include()` expression");
       }
       identifier.content =
-          try_find_and_open(cfile, builtin, fnfind, chklocal, incnext).is_open()
+          try_find_and_open(cfile, includes, fnfind, chklocal, incnext).is_open()
               ? "1" : "0";
       identifier.type = TT_DECLITERAL;
       return false;
@@ -1438,7 +1454,7 @@ token_t lexer::read_raw() {
   while (buffered_tokens) {
     if (buffer_pos >= buffered_tokens->size()) {
       if (!pop_buffer()) {
-        return token_t(TT_ENDOFCODE, cfile.name.c_str(), cfile.lnum,
+        return token_t(TT_ENDOFCODE, cfile.get_file_id(), cfile.lnum,
                        cfile.tell() - cfile.lpos, "", 0);
       }
       continue;
@@ -1460,7 +1476,7 @@ token_t lexer::preprocess_and_read_token() {
     if (buffered_tokens) {
       if (buffer_pos >= buffered_tokens->size()) {
         if (!pop_buffer()) {
-          return token_t(TT_ENDOFCODE, cfile.name.c_str(), cfile.lnum,
+          return token_t(TT_ENDOFCODE, cfile.get_file_id(), cfile.lnum,
                          cfile.tell() - cfile.lpos, "", 0);
         }
         continue;
@@ -1484,7 +1500,7 @@ token_t lexer::preprocess_and_read_token() {
       continue;
     } else if (res.type == TT_ENDOFCODE) {
       if (pop_file()) {
-        return token_t(TT_ENDOFCODE, cfile.name.c_str(), cfile.lnum,
+        return token_t(TT_ENDOFCODE, cfile.get_file_id(), cfile.lnum,
                        cfile.tell() - cfile.lpos, "", 0);
       }
       continue;
@@ -1494,28 +1510,144 @@ token_t lexer::preprocess_and_read_token() {
   }
 }
 
+token_t lexer::replay_token() {
+  history_last = history_pos;
+  token_t res = history[history_pos++];
+  trim_history();
+  return res;
+}
+
+void lexer::record_token(const token_t &token) {
+  if (!lookahead_depth) {
+    history_last = SourceLocation::npos;
+    return;
+  }
+  history_last = history.size();
+  history.push_back(token);
+  history_pos = history.size();
+}
+
+void lexer::trim_history() {
+  if (!lookahead_depth && history_pos == history.size()) {
+    history.clear();
+    history_pos = 0;
+    history_last = SourceLocation::npos;
+  }
+}
+
 token_t lexer::get_token() {
+  if (history_pos < history.size()) return replay_token();
   token_t token = preprocess_and_read_token();
   while (token.preprocesses_away()) token = preprocess_and_read_token();
-  if (lookahead_buffer) lookahead_buffer->push_back(token);
+  record_token(token);
   return token;
 }
 
 token_t lexer::get_token_in_scope(jdi::definition_scope *scope) {
-  token_t res = preprocess_and_read_token();
-  while (res.preprocesses_away()) res = preprocess_and_read_token();
+  const bool replayed = history_pos < history.size();
+  token_t res;
+  if (replayed) {
+    res = replay_token();
+  } else {
+    res = preprocess_and_read_token();
+    while (res.preprocesses_away()) res = preprocess_and_read_token();
+  }
 
   if (res.type == TT_IDENTIFIER) {
+    ParseStats::count(&ParseStats::lookups);
     definition *def = res.def = scope->look_up(res.content.toString());
     if (def) {
       res.type = (def->flags & DEF_TYPENAME) ? TT_DECLARATOR : TT_DEFINITION;
+      // Replay the token as it was found, as if it were recorded again.
+      if (replayed && history_last < history.size())
+        history[history_last] = res;
     }
   }
 
-  if (lookahead_buffer) lookahead_buffer->push_back(res);
+  if (!replayed) record_token(res);
   return res;
 }
 
+bool lexer::may_expand_to_brace(const token_t &identifier) const {
+  macro_iter_c mi = macros.find(identifier.content.view());
+  if (mi == macros.end()) return false;
+  // Look one level deep; any other macro named, or any paste which could
+  // name one, is assumed to produce a brace.
+  for (const token_t &tok : mi->second->raw_value) {
+    if (tok.type == TT_LEFTBRACE || tok.type == TT_RIGHTBRACE ||
+        tok.type == TTM_CONCAT)
+      return true;
+    if (tok.type == TT_IDENTIFIER && macros.find(tok.content.view()) != macros.end())
+      return true;
+  }
+  return false;
+}
+
+SkippedBody lexer::skip_body(token_t &token) {
+  SkippedBody res;
+  res.filename = cfile.name;
+  if (lookahead_depth || history_pos < history.size()) {
+    // Everything we read must be recorded for (or replayed from) history; read
+    // it normally.
+    for (size_t depth = 1; depth; ) {
+      token = get_token();
+      if (token.type == TT_LEFTBRACE) ++depth;
+      else if (token.type == TT_RIGHTBRACE) --depth;
+      else if (token.type == TT_ENDOFCODE) {
+        token.report_errorf(herr, "Expected closing brace to code before %s");
+        return res;
+      }
+    }
+    return res;
+  }
+
+  // The body only has a range if it opened and closed in the file itself.
+  const bool opened_in_file = !buffered_tokens;
+  const size_t begin = cfile.tell(), file_depth = files.size();
+  for (size_t depth = 1; ; ) {
+    token_t tok;
+    bool from_file = false;
+    // Return to the file as soon as expanded macros are used up.
+    while (buffered_tokens && buffer_pos >= buffered_tokens->size() && pop_buffer());
+    if (buffered_tokens) {
+      tok = preprocess_and_read_token();
+    } else {
+      tok = read_token(cfile, herr);
+      if (tok.type == TT_IDENTIFIER) {
+        if (may_expand_to_brace(tok)) handle_macro(tok);
+        continue;
+      } else if (tok.type == TTM_CONCAT) {
+        tok.report_error(herr, "Extraneous # ignored");
+        handle_preprocessor();
+        continue;
+      } else if (tok.type == TTM_TOSTRING) {
+        handle_preprocessor();
+        continue;
+      } else if (tok.type == TT_ENDOFCODE) {
+        if (!pop_file()) continue;
+      } else {
+        from_file = true;
+      }
+    }
+    if (tok.type == TT_LEFTBRACE) {
+      ++depth;
+    } else if (tok.type == TT_RIGHTBRACE) {
+      if (--depth) continue;
+      if (opened_in_file && from_file && files.size() == file_depth &&
+          cfile.name == res.filename) {
+        res.begin = begin;
+        res.end = cfile.tell() - tok.content.len;
+      }
+      token = tok;
+      return res;
+    } else if (tok.type == TT_ENDOFCODE) {
+      token = tok;
+      token.report_errorf(herr, "Expected closing brace to code before %s");
+      return res;
+    }
+  }
+}
+
 void lexer::push_buffer(OpenBuffer &&buf) {
   assert(open_buffers.empty() == !buffered_tokens);
   if (buffered_tokens) {
@@ -1602,6 +1734,11 @@ bool lexer::pop_file() {
   // Fetch data from top item and pop stack
   cfile.consume(files.back());
   files.pop_back();
+  if (file_spans.back() != size_t(-1)) {
+    if (ParseTrace *trace = ParseTrace::current())
+      trace->end(file_spans.back());
+  }
+  file_spans.pop_back();
 
   return false;
 }
@@ -1615,21 +1752,24 @@ std::vector<SourceLocation> lexer::detailed_position() const {
     res.emplace_back("File " + cfile.name, cfile.lnum, cfile.pos - cfile.lpos);
   for (const auto &ob : open_buffers) if (ob.macro_info) {
     res.emplace_back("Usage of macro `" + ob.macro_info->name + "` in "
-                                        + ob.macro_info->origin.file,
+                                        + string(ob.macro_info->origin.get_filename()),
                      ob.macro_info->origin.linenum, ob.macro_info->origin.pos);
   }
   return res;
 }
 
 lexer::lexer(macro_map &pmacros, ErrorHandler *err):
-    herr(err), macros(pmacros), builtin(&builtin_context()) {}
+    herr(err), macros(pmacros), builtin(&builtin_context()),
+    includes(builtin) {}
 
-lexer::lexer(llreader &input, macro_map &pmacros, ErrorHandler *err):
+lexer::lexer(llreader &input, macro_map &pmacros, ErrorHandler *err,
+             const Context *incl):
     lexer(pmacros, err) {
+  if (incl) includes = incl;
   cfile.consume(input);
 }
 
-static macro_map no_macros;
+static thread_local macro_map no_macros;
 lexer::lexer(token_vector &&tokens, const lexer &other):
     lexer(other.macros, other.herr) {
   push_buffer(std::move(tokens));
@@ -114,6 +114,19 @@ namespace jdi {
   */
   token_t read_token(llreader &cfile, ErrorHandler *herr);
 
+  /// The text of a brace-enclosed body passed over by \c lexer::skip_body.
+  struct SkippedBody {
+    /// The name of the file containing the body.
+    string filename;
+    /// Offset of the first byte after the opening brace, or npos if the body
+    /// does not lie within a single file, eg, because a macro opened it.
+    size_t begin = SourceLocation::npos;
+    /// Offset of the closing brace, or npos as above.
+    size_t end = SourceLocation::npos;
+    /// Returns whether the offsets above describe the body.
+    bool has_range() const { return begin != SourceLocation::npos; }
+  };
+
   /// Tokenizes a string with no preprocessing. All words are identifiers.
   /// Will return preprocessing tokens, except for whitespace tokens.
   token_vector tokenize(string fname, string_view str, ErrorHandler *herr);
@@ -138,23 +151,26 @@ namespace jdi {
   can attempt to evaluate the tree one way, then seamlessly give up and allow
   a later branch to attempt the same.
 
-  Thus, this lexer implementation has four layers of token source data:
+  Thus, this lexer implementation has three layers of token source data:
     1. The open file stack. Files or string buffers (managed by an llreader) are
        lexed for raw tokens.
     2. Macros used within a file are expanded into tokens, and these buffers of
        tokens are stacked. Per ISO, a macro may not appear twice in this stack.
-    3. Rewind operations produce queues of tokens. Each queue is stacked.
-    4. During normal lexing operations, minor lookahead may be required.
-       Tokens read during lookahead are queued at the top of this stack.d
+    3. While any lookahead is open, each token read is kept in a history.
+       Rewinding moves a cursor back within the history, and the tokens after
+       it are replayed before any more are read. The history is never copied;
+       nested lookaheads are merely marks within it.
 
-  The above stacks are treated in stack order. They are generally populated in
-  order from 1-4, but tokens are retrieved in order of 4-1.
+  Tokens are retrieved in order of 3-1.
   */
   class lexer {
     struct condition;
 
     llreader cfile;  ///< The current file being read.
     std::vector<llreader> files; ///< The files we have open, in the order we entered them.
+    /// For each of \c files, the \c ParseTrace span of the file entered over
+    /// it, or \c size_t(-1) if the parse was not being traced.
+    std::vector<size_t> file_spans;
     std::vector<OpenBuffer> open_buffers; ///< Buffers of tokens to consume.
     ErrorHandler *herr;  ///< Error handler for problems during lex.
 
@@ -167,8 +183,17 @@ namespace jdi {
     /// The position in the current token buffer.
     size_t buffer_pos;
 
-    /// Buffer to which tokens will be recorded for later re-parse, as needed.
-    token_vector *lookahead_buffer = nullptr;
+    /// Every token read while a \c look_ahead is open, in order, so they can be
+    /// read again. Emptied once no lookahead is open and all are replayed.
+    token_vector history;
+    /// Index in \c history of the next token to replay; past its end unless
+    /// rewound.
+    size_t history_pos = 0;
+    /// Index in \c history of the token last returned, or npos if that token
+    /// was not recorded.
+    size_t history_last = SourceLocation::npos;
+    /// The number of \c look_ahead instances open on this lexer.
+    size_t lookahead_depth = 0;
 
     macro_map &macros; ///< Reference to the \c jdi::macro_map which will be used to store and retrieve macros.
 
@@ -179,6 +204,8 @@ namespace jdi {
 
     /// Pointer to the context we're parsing definitions into.
     Context *const builtin;
+    /// The context whose search directories \c #include searches.
+    const Context *includes;
 
     /// Indicates whether Cpp.Cond expressions (eg, defined, __has_include) are
     /// to be evaluated. Otherwise, the tokens will be treated as normal
@@ -222,6 +249,9 @@ namespace jdi {
     bool parse_macro_function(const token_t &otk, const macro_type &mf);
     /// Check if we're currently inside a macro by the given name.
     bool inside_macro(string_view macro_name) const;
+    /// Check whether expanding the given identifier could produce a brace.
+    /// This errs toward yes; see \c skip_body.
+    bool may_expand_to_brace(const token_t &identifier) const;
 
     /// Pop the currently open file to return to the file that included it.
     /// @return Returns true if the buffer was successfully popped, and input remains.
@@ -259,6 +289,13 @@ namespace jdi {
     /// as reading tokens off the current buffer, if needed.
     token_t preprocess_and_read_token();
 
+    /// Returns the next token from \c history; call only while rewound.
+    token_t replay_token();
+    /// Keeps the given token in \c history, if any lookahead is open.
+    void record_token(const token_t &token);
+    /// Empties \c history if nothing can read it again.
+    void trim_history();
+
    public:
     /** Consumes an llreader and attaches a new \c lex_macro.
         @param input    The file from which to read definitions.
@@ -267,8 +304,12 @@ namespace jdi {
                         (and be probed for) macros.
         @param herr     An error handler that will receive lexing and
                         preprocessing errors.
+        @param includes The context whose search directories, and those of
+                        its bases, to search for included files; if null,
+                        those of the builtin context are searched.
     **/
-    lexer(llreader& input, macro_map &pmacros, ErrorHandler *herr);  // TODO: Have Lexer own pmacros.
+    lexer(llreader& input, macro_map &pmacros, ErrorHandler *herr,
+          const Context *includes = nullptr);  // TODO: Have Lexer own pmacros.
     /**
       Consumes a token_vector, processing only the tokens in the vector before
       returning END_OF_CODE. Does macro expansion using the macros in the given
@@ -307,44 +348,53 @@ namespace jdi {
     /// Read a C++ token, searching the given scope for names.
     token_t get_token_in_scope(definition_scope *scope);
 
-    /// RAII type for initiating unbounded lookahead.
+    /** Skip a brace-enclosed body, such as that of a function, without fully
+        lexing it. Braces are matched on raw tokens; only identifiers naming
+        macros which could expand to a brace are expanded, and preprocessing
+        directives are still obeyed. Under lookahead, each token is read
+        normally, so that the body can be rewound.
+        @param token  The opening brace, just read; receives the matching
+                      closing brace, or the end of code if there is none.
+        @return The location of the body's text, so it can be lexed later.
+    **/
+    SkippedBody skip_body(token_t &token);
+
+    /// RAII type for initiating unbounded lookahead. Only marks a place in the
+    /// lexer's token history; nothing is copied on rewind or destruction.
     class look_ahead {
-      token_vector buffer;
-      token_vector *prev_buffer;
       lexer *lex;
+      size_t mark; ///< Index in the lexer's history of the first token kept.
 
      public:
+      /// Make the token last read, which preceded this lookahead, the first
+      /// one replayed on rewind. Call before reading anything further.
       token_t &push(token_t token) {
-        buffer.push_back(token);
-        return buffer.back();
+        token_vector &history = lex->history;
+        size_t &last = lex->history_last;
+        if (last != SourceLocation::npos && last + 1 == mark) {
+          // The token is already in the history; move the mark back over it.
+          mark = last;
+        } else {
+          // It was read before any lookahead opened, so nothing follows it.
+          mark = last = history.size();
+          history.push_back(token);
+          lex->history_pos = history.size();
+        }
+        return history[mark] = token;
       }
 
-      look_ahead(lexer *lex_): prev_buffer(lex_->lookahead_buffer), lex(lex_) {
-        lex->lookahead_buffer = &buffer;
+      look_ahead(lexer *lex_): lex(lex_), mark(lex_->history_pos) {
+        ++lex->lookahead_depth;
       }
       ~look_ahead() {
-        if (lex->lookahead_buffer != &buffer) {
-          SourceLocation sloc("jdi::look_ahead::~look_ahead",
-                              SourceLocation::npos, SourceLocation::npos);
-          lex->herr->error(sloc, "LOGIC ERROR: lookahead buffer is not owned");
-          abort();
-        }
-        lex->lookahead_buffer = prev_buffer;
-        if (prev_buffer) {
-          if (prev_buffer->empty()) {
-            prev_buffer->swap(buffer);
-          } else {
-            prev_buffer->insert(prev_buffer->end(), buffer.begin(), buffer.end());
-          }
-        }
-      }
-      void rewind() {
-        if (buffer.empty()) return;
-        token_vector buf;
-        buf.swap(buffer);
-        lex->push_rewind_buffer(std::move(buf));
+        --lex->lookahead_depth;
+        lex->trim_history();
       }
-      size_t size() const { return buffer.size(); }
+      /// Return to the start of this lookahead; the tokens read since will be
+      /// read again.
+      void rewind() { lex->history_pos = mark; }
+      /// Returns the number of tokens read since the start of this lookahead.
+      size_t size() const { return lex->history_pos - mark; }
     };
 
     /// Push a buffer of tokens onto this lexer.
@@ -374,6 +424,8 @@ namespace jdi {
 
     /// Retrieve this lexer's error handler
     ErrorHandler *get_error_handler() { return herr; }
+    /// Retrieve the names of the files this lexer has opened via \c #include.
+    const std::set<string> &get_visited_files() const { return visited_files; }
   };
 }
 
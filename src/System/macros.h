@@ -171,7 +171,8 @@ namespace jdi {
   
   /** Map type used for storing macros. Sharing reduces copy times when cloning
       the base context. It also makes destruction automatic. */
-  typedef std::map<string, std::shared_ptr<const jdi::macro_type>> macro_map;
+  /// Map of macro names to macros; may be searched by string_view.
+  typedef std::map<string, std::shared_ptr<const jdi::macro_type>, std::less<>> macro_map;
   typedef macro_map::iterator macro_iter; ///< Iterator type for macro maps.
   typedef macro_map::const_iterator macro_iter_c; ///< Const iterator type for macro maps.
 }
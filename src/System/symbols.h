@@ -22,9 +22,11 @@
 #ifndef _SYMBOLS__H
 #define _SYMBOLS__H
 
+#include <array>
 #include <map>
 #include <string>
 #include <Storage/value.h>
+#include <System/token.h>
 
 namespace jdi {
   namespace precedence {
@@ -89,11 +91,112 @@ namespace jdi {
   };
   
   /// Our "own map type" to circumvent the lack of static code blocks in C++.
-  struct symbol_table: public std::map<std::string, symbol> {
+  struct symbol_table: public std::map<std::string, symbol, std::less<>> {
     symbol_table(); ///< Default constructor. Populates map.
   };
   extern symbol_table symbols; ///< The symbol table which will be searched while building ASTs.
   typedef symbol_table::iterator symbol_iter; ///< Convenience typedef to the iterator type of the symbol table.
+
+  /**
+    The usage and precedences of the operator a token represents, as in the
+    \c symbol table, but looked up by token type rather than by name.
+  **/
+  struct operator_info {
+    unsigned char type = 0; ///< Usage information, as declared in the \c symbol_type enum; zero for tokens which aren't operators.
+    unsigned char prec_binary = 0; ///< Precedence as a binary or ternary operator.
+    unsigned char prec_unary_pre = 0; ///< Precedence as a unary prefix operator.
+    unsigned char prec_unary_post = 0; ///< Precedence as a unary postfix operator.
+  };
+
+  /// The operator table, indexed by \c TOKEN_TYPE. Mirrors the entries of
+  /// \c symbols which have a token type of their own.
+  class operator_table {
+    std::array<operator_info, TT_INVALID + 1> ops {};
+
+    constexpr void add(TOKEN_TYPE tt, unsigned char t, unsigned char p) {
+      operator_info &op = ops[tt];
+      op.type |= t;
+      if (t & (ST_BINARY | ST_TERNARY)) op.prec_binary = p;
+      if (t & ST_UNARY_PRE) op.prec_unary_pre = p;
+      if (t & ST_UNARY_POST) op.prec_unary_post = p;
+    }
+
+   public:
+    constexpr operator_table() {
+      using namespace precedence;
+      add(TT_SCOPE, ST_BINARY, scope);
+
+      add(TT_INCREMENT, ST_UNARY_POST, unary_post);
+      add(TT_DECREMENT, ST_UNARY_POST, unary_post);
+      add(TT_LEFTPARENTH, ST_BINARY, unary_post);
+      add(TT_LEFTBRACKET, ST_BINARY, unary_post);
+      add(TT_DOT, ST_BINARY, unary_post);
+      add(TT_ARROW, ST_BINARY, unary_post);
+
+      add(TT_INCREMENT, ST_UNARY_PRE, unary_pre);
+      add(TT_DECREMENT, ST_UNARY_PRE, unary_pre);
+      add(TT_PLUS, ST_UNARY_PRE, unary_pre);
+      add(TT_MINUS, ST_UNARY_PRE, unary_pre);
+      add(TT_NOT, ST_UNARY_PRE, unary_pre);
+      add(TT_TILDE, ST_UNARY_PRE, unary_pre);
+      add(TT_STAR, ST_UNARY_PRE, unary_pre);
+      add(TT_AMPERSAND, ST_UNARY_PRE, unary_pre);
+      add(TT_SIZEOF, ST_UNARY_PRE, unary_pre);
+      add(TT_NEW, ST_UNARY_PRE, unary_pre);
+      add(TT_DELETE, ST_UNARY_PRE, unary_pre);
+
+      add(TT_DOT_STAR, ST_BINARY, ptr_member);
+      add(TT_ARROW_STAR, ST_BINARY, ptr_member);
+
+      add(TT_STAR, ST_BINARY, multiplication);
+      add(TT_SLASH, ST_BINARY, multiplication);
+      add(TT_MODULO, ST_BINARY, multiplication);
+
+      add(TT_PLUS, ST_BINARY, addition);
+      add(TT_MINUS, ST_BINARY, addition);
+
+      add(TT_LSHIFT, ST_BINARY, shift);
+      add(TT_RSHIFT, ST_BINARY, shift);
+
+      add(TT_LESSTHAN, ST_BINARY, comparison);
+      add(TT_GREATERTHAN, ST_BINARY, comparison);
+      add(TT_LESS_EQUAL, ST_BINARY, comparison);
+      add(TT_GREATER_EQUAL, ST_BINARY, comparison);
+
+      add(TT_EQUAL_TO, ST_BINARY, equivalence);
+      add(TT_NOT_EQUAL_TO, ST_BINARY, equivalence);
+
+      add(TT_AMPERSAND, ST_BINARY, bit_and);
+      add(TT_CARET, ST_BINARY, bit_xor);
+      add(TT_PIPE, ST_BINARY, bit_or);
+
+      add(TT_AMPERSANDS, ST_BINARY, logical_and);
+      add(TT_PIPES, ST_BINARY, logical_or);
+
+      add(TT_QUESTIONMARK, ST_TERNARY | ST_RTL_PARSED, ternary);
+
+      add(TT_EQUAL, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_ADD_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_SUBTRACT_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_MULTIPLY_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_MODULO_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_DIVIDE_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_AND_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_XOR_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_OR_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_LSHIFT_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+      add(TT_RSHIFT_ASSIGN, ST_BINARY | ST_RTL_PARSED, assign);
+
+      add(TT_COMMA, ST_BINARY, comma);
+    }
+
+    /// Look up the operator represented by the given token type.
+    constexpr const operator_info &operator[](TOKEN_TYPE tt) const {
+      return ops[tt];
+    }
+  };
+  /// The operators, by token type; see \c operator_table.
+  inline constexpr operator_table operators;
 }
 
 #endif
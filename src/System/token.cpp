@@ -198,6 +198,7 @@ void token_t::report_error(ErrorHandler *herr, std::string error) const {
 }
 
 void token_t::report_errorf(ErrorHandler *herr, std::string error) const {
+  if (herr && !herr->wants(ERROR)) return;
   string str = to_string();
   for (size_t f = 0; (f = error.find("%s", f)) != string::npos; f += str.length())
     error.replace(f, 2, str);
@@ -233,7 +234,7 @@ std::string token_t::get_name(TOKEN_TYPE tt) {
 }
 
 void token_t::validate() const {
-  if (file.empty() && type != TT_ENDOFCODE) throw std::range_error("You bastard!");
+  if (!file && type != TT_ENDOFCODE) throw std::range_error("You bastard!");
   if (content.toString().empty() && type != TT_ENDOFCODE && type != TTM_NEWLINE)
     throw std::range_error("You slut!");
 }
@@ -237,14 +237,15 @@ namespace jdi {
       return (GLOSS_TOKEN_TYPE) (type >> kGlossBits);
     }
 
-    /// Log the name of the file from which this token was read.
-    std::string file;
+    /// The \c FileTable ID of the file from which this token was read.
+    uint32_t file;
     /// Log the line on which this token was named in the file.
     size_t linenum;
     /// We are logging positions for precise error reporting.
     size_t pos;
 
-    std::string_view get_filename() const { return file; }
+    std::string_view get_filename() const { return FileTable::name_of(file); }
+    uint32_t get_file_id()          const { return file; }
     size_t get_line_number()        const { return linenum; }
     size_t get_line_position()      const { return pos; }
 
@@ -326,27 +327,32 @@ namespace jdi {
 
     /// Construct a new, invalid token.
     token_t():
-        type(TT_INVALID), file("<no file>"), linenum(0), pos(-1), def(nullptr),
+        type(TT_INVALID), file(FileTable::kNoFile), linenum(0), pos(-1), def(nullptr),
         content("default token") { validate(); }
+    /// Construct a token read from the file with the given \c FileTable ID.
+    token_t(TOKEN_TYPE t, uint32_t fid, size_t l, size_t p,
+            const char *content_data, size_t content_length):
+        type(t), file(fid), linenum(l), pos(p), def(nullptr),
+        content(content_data, content_length) { validate(); }
     /// Construct a token with extra information regarding its content.
     token_t(TOKEN_TYPE t, string_view fn, int l, int p,
             const char *content_data, size_t content_length):
-        type(t), file(fn), linenum(l), pos(p), def(nullptr),
+        type(t), file(FileTable::id_of(fn)), linenum(l), pos(p), def(nullptr),
         content(content_data, content_length) { validate(); }
     /// Construct a token with extra information regarding its content.
     token_t(TOKEN_TYPE t, string_view fn, int l, int p, string_view cntnt):
-        type(t), file(fn), linenum(l), pos(p), def(nullptr), content(cntnt) {
+        type(t), file(FileTable::id_of(fn)), linenum(l), pos(p), def(nullptr), content(cntnt) {
              validate(); }
     /// Construct a token with extra information regarding its definition.
     token_t(TOKEN_TYPE t, string_view fn, int l, int p,
             definition *d, string_view name):
-        type(t), file(fn), linenum(l), pos(p), def(d), content(name) {
+        type(t), file(FileTable::id_of(fn)), linenum(l), pos(p), def(d), content(name) {
             validate();
     }
     /// Construct a DECFLAG token with extra information about its meaning.
     token_t(TOKEN_TYPE t, string_view fn, int l, int p,
             typeflag *tf, string_view name):
-        type(t), file(fn), linenum(l), pos(p), tflag(tf), content(name) {
+        type(t), file(FileTable::id_of(fn)), linenum(l), pos(p), tflag(tf), content(name) {
             validate();
     }
 
@@ -0,0 +1,240 @@
+/* Copyright (C) 2011-2014 Josh Ventura
+ * This file is part of JustDefineIt.
+ *
+ * JustDefineIt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 3 of the License, or (at your option) any later version.
+ *
+ * JustDefineIt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * JustDefineIt. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times each stage of JDI over synthetic header corpora of growing size, so
+// that throughput and scaling can be compared between builds without ENIGMA,
+// a system compiler, or anything else outside this repository.
+//
+// Usage: JustDefineIt [--max-scale N] [--reps N] [--dir PATH] [--json]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <API/context.h>
+#include <API/parse_stats.h>
+#include <System/lex_cpp.h>
+
+#include "corpus.h"
+
+using namespace jdi;
+using namespace jdi_bench;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+namespace fs = std::filesystem;
+
+namespace {
+
+/// How one stage fared on one corpus: its best time, and the work it did.
+struct Stage {
+  double seconds = 0;
+  size_t count = 0;  ///< Tokens, declarations, or instantiations.
+};
+
+struct Row {
+  unsigned scale;
+  size_t files, bytes;
+  Stage lex, preprocess, parse, instantiate;
+  size_t declarations = 0;
+  unsigned errors = 0;
+};
+
+/// Counts what the parser reports declared.
+struct DeclarationCounter: DeclarationObserver {
+  size_t count = 0;
+  void declared(definition*, const SourceRange&) override { ++count; }
+};
+
+/// Runs the given function the given number of times, keeping the result of
+/// the fastest run.
+template<typename F> Stage best_of(unsigned reps, F run) {
+  Stage best;
+  for (unsigned r = 0; r < reps; ++r) {
+    Stage s = run();
+    if (!r || s.seconds < best.seconds) best = s;
+  }
+  return best;
+}
+
+double since(steady_clock::time_point start) {
+  return duration<double>(steady_clock::now() - start).count();
+}
+
+/// Raw tokens, read from each file on its own, as the lexer reads them.
+Stage lex_corpus(const Corpus &corpus, ErrorHandler *herr) {
+  Stage res;
+  const auto start = steady_clock::now();
+  for (const fs::path &file : corpus.files) {
+    llreader read(file);
+    for (token_t tok = read_token(read, herr); tok.type != TT_ENDOFCODE;
+         tok = read_token(read, herr)) {
+      if (!tok.preprocesses_away()) ++res.count;
+    }
+  }
+  res.seconds = since(start);
+  return res;
+}
+
+/// Preprocessed tokens: includes followed, directives run, macros expanded.
+Stage preprocess_corpus(const Corpus &corpus, ErrorHandler *herr) {
+  Context ctex(herr);
+  macro_map macros = ctex.get_macros();
+  llreader read(corpus.main);
+  Stage res;
+  const auto start = steady_clock::now();
+  lexer lex(read, macros, herr, &ctex);
+  while (lex.get_token().type != TT_ENDOFCODE) ++res.count;
+  res.seconds = since(start);
+  return res;
+}
+
+/// Splits a whole parse into the time spent instantiating templates and the
+/// time spent on everything else.
+std::pair<Stage, Stage> parse_corpus(const Corpus &corpus, ErrorHandler *herr) {
+  Context ctex(herr);
+  ParseStats stats;
+  ctex.set_stats(&stats);
+  llreader read(corpus.main);
+  ctex.parse_stream(read);
+  const auto instantiating = stats.time[ParseStats::INSTANTIATION];
+  Stage parse, instantiate;
+  parse.seconds = duration<double>(stats.total() - instantiating).count();
+  instantiate.seconds = duration<double>(instantiating).count();
+  instantiate.count = stats.instantiations;
+  return {parse, instantiate};
+}
+
+size_t count_declarations(const Corpus &corpus, ErrorHandler *herr) {
+  Context ctex(herr);
+  DeclarationCounter counter;
+  ctex.set_observer(&counter);
+  llreader read(corpus.main);
+  ctex.parse_stream(read);
+  return counter.count;
+}
+
+Row run(const fs::path &dir, unsigned scale, unsigned reps) {
+  DefaultErrorHandler herr;
+  herr.max_count = 10;
+  const Corpus corpus = generate_corpus(dir, CorpusShape::scaled(scale));
+
+  Row row {scale, corpus.files.size(), corpus.bytes, {}, {}, {}, {}};
+  row.lex = best_of(reps, [&] { return lex_corpus(corpus, &herr); });
+  row.preprocess = best_of(reps, [&] { return preprocess_corpus(corpus, &herr); });
+  Stage best_parse, best_instantiate;
+  for (unsigned r = 0; r < reps; ++r) {
+    auto [parse, instantiate] = parse_corpus(corpus, &herr);
+    if (!r || parse.seconds + instantiate.seconds <
+              best_parse.seconds + best_instantiate.seconds) {
+      best_parse = parse, best_instantiate = instantiate;
+    }
+  }
+  row.parse = best_parse;
+  row.instantiate = best_instantiate;
+  row.declarations = row.parse.count = count_declarations(corpus, &herr);
+  row.errors = herr.error_count + herr.warning_count;
+  for (const fs::path &file : corpus.files) fs::remove(file);
+  return row;
+}
+
+double per_second(double amount, double seconds) {
+  return seconds > 0 ? amount / seconds : 0;
+}
+
+void print_table(const std::vector<Row> &rows) {
+  printf("%5s %5s %8s %8s %7s %5s | %8s %7s %8s | %8s %7s %8s | "
+         "%8s %7s %9s | %8s %9s\n",
+         "scale", "files", "KiB", "tokens", "decls", "insts",
+         "lex ms", "MB/s", "tok/s", "pp ms", "MB/s", "tok/s",
+         "parse ms", "MB/s", "decl/s", "inst ms", "inst/s");
+  for (const Row &r : rows) {
+    const double mb = r.bytes / 1e6;
+    printf("%5u %5zu %8.1f %8zu %7zu %5zu | %8.2f %7.1f %8.3g | "
+           "%8.2f %7.1f %8.3g | %8.2f %7.1f %9.3g | %8.2f %9.3g%s\n",
+           r.scale, r.files, r.bytes / 1024.0, r.preprocess.count,
+           r.declarations, r.instantiate.count,
+           r.lex.seconds * 1e3, per_second(mb, r.lex.seconds),
+           per_second(r.lex.count, r.lex.seconds),
+           r.preprocess.seconds * 1e3, per_second(mb, r.preprocess.seconds),
+           per_second(r.preprocess.count, r.preprocess.seconds),
+           r.parse.seconds * 1e3, per_second(mb, r.parse.seconds),
+           per_second(r.declarations, r.parse.seconds),
+           r.instantiate.seconds * 1e3,
+           per_second(r.instantiate.count, r.instantiate.seconds),
+           r.errors ? "  (corpus had errors)" : "");
+  }
+}
+
+void print_json(const std::vector<Row> &rows) {
+  printf("[");
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const Row &r = rows[i];
+    printf("%s\n  {\"scale\": %u, \"files\": %zu, \"bytes\": %zu, "
+           "\"declarations\": %zu, \"errors\": %u", i ? "," : "",
+           r.scale, r.files, r.bytes, r.declarations, r.errors);
+    const std::pair<const char*, const Stage*> stages[] = {
+      {"lex", &r.lex}, {"preprocess", &r.preprocess},
+      {"parse", &r.parse}, {"instantiate", &r.instantiate}};
+    for (const auto &[name, stage] : stages) {
+      printf(", \"%s\": {\"seconds\": %.6f, \"count\": %zu, "
+             "\"bytes_per_second\": %.0f, \"count_per_second\": %.0f}",
+             name, stage->seconds, stage->count,
+             per_second(r.bytes, stage->seconds),
+             per_second(stage->count, stage->seconds));
+    }
+    printf("}");
+  }
+  printf("\n]\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned max_scale = 16, reps = 3;
+  bool json = false;
+  fs::path dir = fs::temp_directory_path() / "jdi_bench";
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--max-scale") && i + 1 < argc) {
+      max_scale = std::max(1, atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--reps") && i + 1 < argc) {
+      reps = std::max(1, atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--dir") && i + 1 < argc) {
+      dir = argv[++i];
+    } else if (!strcmp(argv[i], "--json")) {
+      json = true;
+    } else {
+      fprintf(stderr, "Usage: %s [--max-scale N] [--reps N] [--dir PATH] "
+                      "[--json]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Row> rows;
+  for (unsigned scale = 1; scale <= max_scale; scale *= 2) {
+    rows.push_back(run(dir, scale, reps));
+    if (!json) fprintf(stderr, "Scale %u of %u done.\n", scale, max_scale);
+  }
+  std::error_code ignored;
+  fs::remove(dir, ignored);
+
+  if (json) print_json(rows);
+  else print_table(rows);
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include "corpus.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace jdi_bench {
+
+namespace {
+
+std::string header_name(unsigned index) {
+  return "header_" + std::to_string(index) + ".h";
+}
+
+}  // namespace
+
+CorpusShape CorpusShape::scaled(unsigned scale) {
+  CorpusShape res;
+  res.classes *= scale;
+  res.enumerators *= scale;
+  res.macros *= scale;
+  // The parser gives up past 128 nested instantiations.
+  res.template_depth = std::min(res.template_depth * scale, 96u);
+  return res;
+}
+
+std::string generate_header(const CorpusShape &shape, unsigned index,
+                            const std::vector<unsigned> &includes) {
+  const std::string i = std::to_string(index);
+  std::string res;
+  res += "#ifndef BENCH_HEADER_" + i + "\n#define BENCH_HEADER_" + i + "\n";
+  for (unsigned inc : includes)
+    res += "#include \"" + header_name(inc) + "\"\n";
+
+  // Wrappers expanding to more wrappers, with pasted names.
+  res += "#define FIELD_" + i + "(type, name) type name;\n"
+         "#define METHOD_" + i + "(ret, name, arg) ret name(arg);\n"
+         "#define WRAP_" + i + "(k) FIELD_" + i + "(int, wrapped_##k) "
+         "METHOD_" + i + "(long, wrapped_fn_##k, const char *)\n\n";
+
+  for (unsigned n = 0; n < shape.namespaces; ++n)
+    res += "namespace ns_" + i + "_" + std::to_string(n) + " {\n";
+
+  // An enum whose values each depend on the last.
+  res += "enum enum_" + i + " {\n  enum_" + i + "_0 = 1";
+  for (unsigned e = 1; e < shape.enumerators; ++e) {
+    res += ",\n  enum_" + i + "_" + std::to_string(e) + " = enum_" + i + "_" +
+           std::to_string(e - 1) + " * 3 % 1021 + " + std::to_string(e);
+  }
+  res += "\n};\n\n";
+
+  for (unsigned c = 0; c < shape.classes; ++c) {
+    const std::string cls = "class_" + i + "_" + std::to_string(c);
+    res += "struct " + cls + " {\n";
+    for (unsigned m = 0; m < shape.members; ++m) {
+      const std::string mem = std::to_string(m);
+      if (m % 2) res += "  long method_" + mem + "(int a, " + cls + " *b) const;\n";
+      else res += "  unsigned int field_" + mem + "[" + std::to_string(m + 1) + "];\n";
+    }
+    res += "};\n";
+  }
+  res += "\n";
+
+  // A chain of templates, each derived from an instance of the last. JDI
+  // does not instantiate dependent bases, so each link is also instantiated
+  // by name.
+  if (shape.template_depth) {
+    const std::string chain = "chain_" + i + "_";
+    res += "template<typename T, int N> struct " + chain + "0 {\n"
+           "  T value;\n  enum { depth = N };\n};\n";
+    for (unsigned t = 1; t < shape.template_depth; ++t) {
+      const std::string link = std::to_string(t);
+      res += "template<typename T, int N> struct " + chain + link + ": " +
+             chain + std::to_string(t - 1) + "<T, N + 1> {\n"
+             "  enum { depth = N + " + link + " };\n};\n";
+    }
+    for (unsigned t = 0; t < shape.template_depth; ++t) {
+      const std::string link = std::to_string(t);
+      res += "typedef " + chain + link + "<int, 1> chain_type_" + i + "_" +
+             link + ";\n";
+    }
+    res += "\n";
+  }
+
+  for (unsigned k = 0; k < shape.macros; ++k)
+    res += "WRAP_" + i + "(h" + i + "_" + std::to_string(k) + ")\n";
+
+  for (unsigned n = 0; n < shape.namespaces; ++n) res += "}\n";
+  res += "#endif\n";
+  return res;
+}
+
+Corpus generate_corpus(const std::filesystem::path &dir, const CorpusShape &shape) {
+  std::filesystem::create_directories(dir);
+  Corpus res;
+  res.main = dir / "main.cc";
+
+  // Headers are numbered breadth-first: header n includes the fanout headers
+  // numbered from (n + 1) * fanout, and the main file counts as header -1.
+  unsigned count = 0;
+  for (unsigned level = 0, width = 1; level < shape.include_depth; ++level)
+    count += (width *= shape.include_fanout);
+  const auto children = [&](long parent) {
+    std::vector<unsigned> kids;
+    for (unsigned k = 0; k < shape.include_fanout; ++k) {
+      const long child = (parent + 1) * shape.include_fanout + k;
+      if (child < long(count)) kids.push_back(child);
+    }
+    return kids;
+  };
+
+  const auto write = [&res](const std::filesystem::path &path,
+                            const std::string &text) {
+    std::ofstream(path, std::ios::binary) << text;
+    res.files.push_back(path);
+    res.bytes += text.length();
+  };
+  std::string main_text;
+  for (unsigned inc : children(-1))
+    main_text += "#include \"" + header_name(inc) + "\"\n";
+  write(res.main, main_text);
+  for (unsigned n = 0; n < count; ++n)
+    write(dir / header_name(n), generate_header(shape, n, children(n)));
+  return res;
+}
+
+}  // namespace jdi_bench
@@ -0,0 +1,47 @@
+#ifndef JDI_BENCH_CORPUS_h
+#define JDI_BENCH_CORPUS_h
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace jdi_bench {
+
+/// The shape of a synthetic header corpus. Each header of the corpus holds
+/// the same mix of declarations, each under its own names, and includes the
+/// headers beneath it in a tree.
+struct CorpusShape {
+  unsigned namespaces = 3;      ///< Depth of the namespaces around each header's contents.
+  unsigned classes = 8;         ///< Classes per header.
+  unsigned members = 8;         ///< Members per class, alternating fields and methods.
+  unsigned template_depth = 8;  ///< Length of each header's chain of templates.
+  unsigned enumerators = 32;    ///< Enumerators in each header's enum.
+  unsigned macros = 8;          ///< Macro-wrapped declarations per header.
+  unsigned include_depth = 3;   ///< Levels of headers beneath the main file.
+  unsigned include_fanout = 2;  ///< Headers included by the main file and each header above the last level.
+
+  /// Returns a shape whose headers hold about \p scale times the
+  /// declarations of the default shape.
+  static CorpusShape scaled(unsigned scale);
+};
+
+/// A corpus written by \c generate_corpus().
+struct Corpus {
+  std::filesystem::path main;               ///< The file including the rest.
+  std::vector<std::filesystem::path> files; ///< Every file, the main one first.
+  size_t bytes = 0;                         ///< The total size of the files.
+};
+
+/// Writes a corpus of the given shape into the given directory, which is
+/// created if need be. The same shape always produces the same files.
+Corpus generate_corpus(const std::filesystem::path &dir, const CorpusShape &shape);
+
+/// Returns the text of one header of a corpus of the given shape; \p index
+/// distinguishes its names from those of the other headers.
+std::string generate_header(const CorpusShape &shape, unsigned index,
+                            const std::vector<unsigned> &includes);
+
+}  // namespace jdi_bench
+
+#endif  // JDI_BENCH_CORPUS_h
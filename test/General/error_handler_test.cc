@@ -59,4 +59,95 @@ TEST(ErrorHandlerTest, UniversalConversionHandling) {
   EXPECT_THAT(err_impl.errors[0], testing::Eq("Hello, world!"));
 }
 
+TEST(ErrorHandlerTest, FileTableNamesFilesOnce) {
+  const uint32_t header = jdi::FileTable::id_of("file_table_test.h");
+  EXPECT_NE(header, 0u);
+  EXPECT_EQ(jdi::FileTable::id_of(std::string("file_table_test.h")), header);
+  EXPECT_NE(jdi::FileTable::id_of("file_table_test.cc"), header);
+  EXPECT_EQ(jdi::FileTable::name_of(header), "file_table_test.h");
+  EXPECT_EQ(jdi::FileTable::id_of(""), 0u);
+  EXPECT_EQ(jdi::FileTable::name_of(0), "");
+}
+
+TEST(ErrorHandlerTest, SourceLocationsNameFilesById) {
+  struct CodePoint {
+    uint32_t get_file_id() const { return jdi::FileTable::id_of("point.h"); }
+    size_t get_line_number() const { return 12; }
+    size_t get_line_position() const { return 4; }
+  };
+  const jdi::SourceLocation at_point = CodePoint();
+  EXPECT_EQ(at_point.file, jdi::FileTable::id_of("point.h"));
+  EXPECT_EQ(at_point.filename(), "point.h");
+  EXPECT_EQ(at_point.to_string(), "point.h:12:4");
+
+  const jdi::SourceLocation named{"point.h", 12, 4};
+  EXPECT_EQ(named.file, at_point.file);
+  EXPECT_EQ(jdi::FileTable::name_of(jdi::FileTable::kNoFile), "<no file>");
+}
+
+struct Costly {
+  int *built;
+  std::string to_string() const { ++*built; return "costly"; }
+};
+
+struct ErrorsOnly : TestErrorHandler {
+  bool wants(jdi::ErrorLevel level) const override {
+    return level == jdi::ERROR;
+  }
+};
+
+TEST(ErrorHandlerTest, UnwantedMessagesAreNotBuilt) {
+  ErrorsOnly err_impl;
+  jdi::ErrorContext errc = err_impl.at({"hi", 0, 0});
+  int built = 0;
+  errc.warning() << Costly{&built};
+  errc.info() << Costly{&built};
+  jdi::ErrorHandler *err = &err_impl;
+  err->warning({"hi", 0, 0}, "unwanted %s", 12);
+  EXPECT_EQ(built, 0);
+  EXPECT_THAT(err_impl.warnings, SizeIs(0));
+  EXPECT_THAT(err_impl.infos, SizeIs(0));
+
+  errc.error() << Costly{&built};
+  EXPECT_EQ(built, 1);
+  ASSERT_THAT(err_impl.errors, SizeIs(1));
+  EXPECT_THAT(err_impl.errors[0], Eq("costly"));
+}
+
+TEST(ErrorHandlerTest, DefaultHandlerStopsAtItsLimit) {
+  jdi::DefaultErrorHandler herr_impl;
+  herr_impl.least_severe = jdi::ERROR;
+  herr_impl.max_count = 2;
+  jdi::ErrorHandler *herr = &herr_impl;
+  EXPECT_FALSE(herr->wants(jdi::WARNING));
+  EXPECT_TRUE(herr->wants(jdi::ERROR));
+  int built = 0;
+  for (int i = 0; i < 5; ++i)
+    herr->error({"limit_test", 1, 1}) << Costly{&built};
+  EXPECT_EQ(built, 2);
+  EXPECT_EQ(herr_impl.error_count, 2u);
+  EXPECT_FALSE(herr->wants(jdi::ERROR));
+}
+
+TEST(ErrorHandlerTest, AggregatingHandlerCollapsesRepeats) {
+  TestErrorHandler target;
+  {
+    jdi::AggregatingErrorHandler aggregator(&target, 2);
+    jdi::ErrorHandler *herr = &aggregator;
+    for (int i = 0; i < 3; ++i) herr->error({"macro.h", 4, 2}) << "bad token";
+    EXPECT_THAT(target.errors, SizeIs(0));  // Held for the batch.
+    herr->error({"macro.h", 4, 9}) << "bad token";
+    ASSERT_THAT(target.errors, SizeIs(2));
+    ASSERT_THAT(target.infos, SizeIs(1));
+    EXPECT_THAT(target.infos[0], Eq("Repeated 2 more times: bad token"));
+
+    herr->error({"macro.h", 4, 2}) << "bad token";
+    herr->warning({"macro.h", 4, 2}) << "bad token";
+  }
+  EXPECT_THAT(target.errors, SizeIs(2));
+  ASSERT_THAT(target.warnings, SizeIs(1));
+  ASSERT_THAT(target.infos, SizeIs(2));
+  EXPECT_THAT(target.infos[1], Eq("Repeated 1 more time: bad token"));
+}
+
 }  // namespace
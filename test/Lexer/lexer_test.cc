@@ -598,4 +598,79 @@ my_macro2( = 10  );
   EXPECT_THAT(lex.get_token(), HasType(TT_ENDOFCODE));
 }
 
+TEST(LexerTest, SkipBodyMatchesRawBraces) {
+  constexpr char kTestCase[] = R"cpp(
+#define OPEN {
+#define CLOSE }
+#define PLAIN 1 + 2
+void f() {
+  const char *s = "}"; char c = '{';  // }
+  /* } */
+#if 0
+  }
+#endif
+  if (PLAIN) { OPEN } CLOSE
+} after
+)cpp";
+
+  macro_map no_macros;
+  llreader read("test_input", kTestCase, false);
+  lexer lex(read, no_macros, error_constitutes_failure);
+
+  EXPECT_THAT(lex.get_token(), HasType(TT_DECLARATOR));    // void
+  EXPECT_THAT(lex.get_token(), HasType(TT_IDENTIFIER));    // f
+  EXPECT_THAT(lex.get_token(), HasType(TT_LEFTPARENTH));   // (
+  EXPECT_THAT(lex.get_token(), HasType(TT_RIGHTPARENTH));  // )
+  token_t token = lex.get_token();
+  ASSERT_THAT(token, HasType(TT_LEFTBRACE));               // {
+  SkippedBody body = lex.skip_body(token);
+  EXPECT_THAT(token, HasType(TT_RIGHTBRACE));              // }
+  EXPECT_THAT(lex.get_token(), HasType(TT_IDENTIFIER));    // after
+  EXPECT_THAT(lex.get_token(), HasType(TT_ENDOFCODE));
+
+  const string_view text = kTestCase;
+  const size_t open = text.find("() {") + 4, close = text.rfind("} after");
+  ASSERT_TRUE(body.has_range());
+  EXPECT_EQ(body.filename, "test_input");
+  EXPECT_EQ(body.begin, open);
+  EXPECT_EQ(body.end, close);
+}
+
+TEST(LexerTest, NestedLookAheadRewinds) {
+  macro_map no_macros;
+  llreader read("test_input", "a b c d e", false);
+  lexer lex(read, no_macros, error_constitutes_failure);
+  auto next = [&lex]() { return lex.get_token().content.toString(); };
+
+  token_t token = lex.get_token();
+  {
+    lexer::look_ahead outer(&lex);
+    outer.push(token);
+    EXPECT_EQ(next(), "b");
+    {
+      lexer::look_ahead inner(&lex);
+      EXPECT_EQ(next(), "c");
+      EXPECT_EQ(next(), "d");
+      inner.rewind();
+      EXPECT_EQ(inner.size(), 0u);
+      EXPECT_EQ(next(), "c");
+    }
+    EXPECT_EQ(next(), "d");
+    EXPECT_EQ(next(), "e");
+    EXPECT_EQ(outer.size(), 5u);
+    outer.rewind();
+  }
+  EXPECT_EQ(next(), "a");
+  {
+    lexer::look_ahead again(&lex);
+    EXPECT_EQ(next(), "b");
+    again.rewind();
+  }
+  EXPECT_EQ(next(), "b");
+  EXPECT_EQ(next(), "c");
+  EXPECT_EQ(next(), "d");
+  EXPECT_EQ(next(), "e");
+  EXPECT_THAT(lex.get_token(), HasType(TT_ENDOFCODE));
+}
+
 }  // namespace jdi
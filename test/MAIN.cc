@@ -14,6 +14,7 @@
 */
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
@@ -300,7 +301,7 @@ int main(int argc, char** argv) {
         if (!had_diff && p < tokens2.size() && (tokens[p].type != tokens2[p].type || tokens[p].content.view() != tokens2[p].content.view())) {
           cerr << p << endl;
           for (const auto &sl : lex.detailed_position())
-            cerr << "In " << sl.filename << ":" << sl.line << ":" << sl.pos << ":\n";
+            cerr << "In " << sl.filename() << ":" << sl.line << ":" << sl.pos << ":\n";
           token.report_errorf(default_error_handler,
                               "Token differs from golden set! Read "
                               + token.to_string() + ", expected "
@@ -341,10 +342,23 @@ int main(int argc, char** argv) {
     Context enigma;
     // This is the difference between success and failure in 03 mode.
     // enigma.add_macro_func("__attribute__", "", "", true);
+    ParseStats stats;
+    enigma.set_stats(&stats);
+    // Set JDI_TRACE to a path to write a timeline of the parse there.
+    ParseTrace trace;
+    const char *trace_path = getenv("JDI_TRACE");
+    if (trace_path) enigma.set_trace(&trace);
     start_time(ts);
     int res = enigma.parse_stream(f);
     end_time(te,tel);
+    enigma.set_stats(nullptr);
     cout << "Parse finished in " << tel << " microseconds." << endl;
+    cout << "Parse statistics: " << stats.to_json() << endl;
+    if (trace_path) {
+      enigma.set_trace(nullptr);
+      std::ofstream trace_out(trace_path);
+      trace.write_json(trace_out);
+    }
 
     //enigma.output_definitions();
     if (res)
@@ -3,8 +3,15 @@
 
 #include <System/lex_cpp.h>
 #include <System/builtins.h>
+#include <Storage/value_funcs.h>
+#include <System/symbols.h>
+#include <API/incremental.h>
+#include <Bench/corpus.h>
 #include <Testing/error_handler.h>
 #include <Testing/matchers.h>
+#include <climits>
+#include <fstream>
+#include <thread>
 
 using ::testing::Eq;
 using ::testing::AllOf;
@@ -52,5 +59,974 @@ TEST(ParsingTest, SimpleClassDefinition) {
           "my_class", HasMembers(FunctionDefinition("do_something")))));
 }
 
+TEST(ParsingTest, EnumValuesEvaluateOperators) {
+  auto ctex = Parse(R"cpp(
+    enum numbers { a = 2 + 3 * 4, b = -a, c = (a << 2) - ~b, d = !c };
+  )cpp");
+  auto value_of = [&](const char *name) {
+    definition *d = ctex.get_global()->look_up(name);
+    EXPECT_NE(d, nullptr) << name;
+    EXPECT_TRUE(d && (d->flags & DEF_VALUED)) << name;
+    return d && (d->flags & DEF_VALUED)
+        ? (long) ((definition_valued*) d)->value_of : -1L;
+  };
+  EXPECT_EQ(value_of("a"), 14);
+  EXPECT_EQ(value_of("b"), -14);
+  EXPECT_EQ(value_of("c"), 43);
+  EXPECT_EQ(value_of("d"), 0);
+
+  // Nodes know their operation from when they were built; copies keep it.
+  AST_Node_Binary sum(std::make_unique<AST_Node>("4", AT_DECLITERAL),
+                      std::make_unique<AST_Node>("5", AT_DECLITERAL), "+");
+  ErrorCounter herr;
+  EXPECT_EQ((long) sum.duplicate()->eval(herr.at({"operator_test", 0, 0})), 9);
+  AST_Node_Binary unknown(std::make_unique<AST_Node>("4", AT_DECLITERAL),
+                          std::make_unique<AST_Node>("5", AT_DECLITERAL), "@");
+  (void) unknown.eval(herr.at({"operator_test", 0, 0}));
+  EXPECT_EQ(herr.errors, 1);
+}
+
+TEST(ParsingTest, OperatorTableMatchesSymbols) {
+  macro_map no_macros;
+  llreader read("test_input", R"cpp(
+      :: ++ -- ( [ . -> + - ! ~ * & sizeof new delete .* ->* / % << >>
+      < > <= >= == != ^ | && || ? = += -= *= %= /= &= ^= |= <<= >>= ,
+  )cpp", false);
+  lexer lex(read, no_macros, error_constitutes_failure);
+  int count = 0;
+  for (token_t token = lex.get_token(); token.type != TT_ENDOFCODE;
+       token = lex.get_token(), ++count) {
+    const string op = token.content.toString();
+    auto sym = symbols.find(op);
+    ASSERT_NE(sym, symbols.end()) << op;
+    const operator_info &info = operators[token.type];
+    EXPECT_EQ(info.type, sym->second.type) << op;
+    EXPECT_EQ(info.prec_binary, sym->second.prec_binary) << op;
+    EXPECT_EQ(info.prec_unary_pre, sym->second.prec_unary_pre) << op;
+    EXPECT_EQ(info.prec_unary_post, sym->second.prec_unary_post) << op;
+  }
+  EXPECT_EQ(count, 46);
+  EXPECT_EQ(operators[TT_IDENTIFIER].type, 0);
+}
+
+TEST(ParsingTest, ValuesKeepIntegerTypes) {
+  static_assert(sizeof(value) <= 16, "values should stay two words");
+
+  // Integers are exact beyond the precision of a double.
+  const long long odd = 9007199254740993LL;
+  EXPECT_EQ(values_add(value(odd), value(0)).integer, odd);
+  const value max(18446744073709551615ULL);
+  EXPECT_EQ(values_add(max, value(0)).toString(), "18446744073709551615");
+
+  // Kernels follow the usual arithmetic conversions.
+  EXPECT_EQ((long) values_less(value(-1), value(0u)), 0);
+  EXPECT_EQ((long) values_less(value(-1), value(0)), 1);
+  const value quotient = values_divide(value(7), value(2));
+  EXPECT_EQ(quotient.type, VT_INTEGER);
+  EXPECT_EQ((long) quotient, 3);
+  EXPECT_EQ((double) values_divide(value(7.0), value(2)), 3.5);
+  EXPECT_EQ(values_divide(value(1), value(0)).type, VT_NONE);
+  EXPECT_EQ(values_divide(value(LLONG_MIN), value(-1)).integer, LLONG_MIN);
+  EXPECT_EQ(values_add(value(VT_DEPENDENT), value(1)).type, VT_DEPENDENT);
+
+  // Equal strings share their storage.
+  EXPECT_EQ(value("abc").str, value(std::string("abc")).str);
+  EXPECT_EQ(values_add(value("abc"), value(1)).toString(), "bc");
+}
+
+TEST(ParsingTest, LogicalOperatorsShortCircuit) {
+  // Evaluating an undeclared identifier is an error; the logical operators
+  // must not get that far when their left operand decides the result.
+  auto undeclared = [] {
+    return std::make_unique<AST_Node>("missing", AT_IDENTIFIER);
+  };
+  auto literal = [](const char *text) {
+    return std::make_unique<AST_Node>(text, AT_DECLITERAL);
+  };
+  ErrorCounter herr;
+  const ErrorContext errc = herr.at({"short_circuit_test", 0, 0});
+
+  AST_Node_Binary and_false(literal("0"), undeclared(), "&&");
+  EXPECT_EQ((long) and_false.eval(errc), 0);
+  AST_Node_Binary or_true(literal("2"), undeclared(), "||");
+  EXPECT_EQ((long) or_true.eval(errc), 1);
+  AST_Node_Ternary pick_false(literal("0"), undeclared(), literal("7"), "?");
+  EXPECT_EQ((long) pick_false.eval(errc), 7);
+  EXPECT_EQ(herr.errors, 0);
+
+  AST_Node_Binary and_true(literal("1"), undeclared(), "&&");
+  (void) and_true.eval(errc);
+  AST_Node_Binary or_false(literal("0"), undeclared(), "||");
+  (void) or_false.eval(errc);
+  EXPECT_EQ(herr.errors, 2);
+}
+
+TEST(ParsingTest, ConstantSubexpressionsAreFolded) {
+  auto ctex = Parse(R"cpp(
+    enum flags { A = 1 << 3, B = A | 4 };
+    template<int N = B + 1, int M = N * (2 + 3)> struct sized {};
+  )cpp");
+  definition *b = ctex.get_global()->look_up("B");
+  ASSERT_NE(b, nullptr);
+  ASSERT_TRUE(b->flags & DEF_VALUED);
+  value &b_value = ((definition_valued*) b)->value_of;
+  EXPECT_EQ((long) b_value, 12);
+
+  definition *sized = ctex.get_global()->look_up("sized");
+  ASSERT_NE(sized, nullptr);
+  ASSERT_TRUE(sized->flags & DEF_TEMPLATE);
+  auto &params = ((definition_template*) sized)->params;
+  ASSERT_EQ(params.size(), 2u);
+  ASSERT_NE(params[0]->default_assignment, nullptr);
+  ASSERT_NE(params[1]->default_assignment, nullptr);
+  const ErrorContext errc = error_constitutes_failure->at({"fold_test", 0, 0});
+
+  // The default was evaluated when it was read, and keeps its text.
+  b_value = value(100L);
+  EXPECT_EQ((long) params[0]->default_assignment->eval(errc), 13);
+  EXPECT_EQ(params[0]->default_assignment->toString(), "(B) + (1)");
+
+  // Only the constant part of a dependent expression is folded.
+  EXPECT_EQ(params[1]->default_assignment->eval(errc).type, VT_DEPENDENT);
+  EXPECT_EQ(params[1]->default_assignment->toString(), "(N) * ((2) + (3))");
+}
+
+TEST(ParsingTest, DefaultsEvaluateWithSubstitutions) {
+  auto ctex = Parse(R"cpp(
+    template<int N, int K = (long) N, int M = 2 < N ? N * 2 + 1 : 0>
+    struct sized {};
+  )cpp");
+  definition *sized = ctex.get_global()->look_up("sized");
+  ASSERT_NE(sized, nullptr);
+  ASSERT_TRUE(sized->flags & DEF_TEMPLATE);
+  auto &params = ((definition_template*) sized)->params;
+  ASSERT_EQ(params.size(), 3u);
+  ASSERT_NE(params[1]->default_assignment, nullptr);
+  ASSERT_NE(params[2]->default_assignment, nullptr);
+  const ErrorContext errc = error_constitutes_failure->at({"subst_test", 0, 0});
+
+  for (long n : {1L, 5L}) {
+    definition_valued arg("N", sized, nullptr, 0, DEF_VALUED, value(n));
+    remap_set subs{{params[0].get(), &arg}};
+    // Casts aren't compiled; these are still evaluated through a duplicate.
+    EXPECT_EQ((long) params[1]->default_assignment->eval(errc, subs), n);
+    EXPECT_EQ((long) params[2]->default_assignment->eval(errc, subs),
+              n > 2 ? n * 2 + 1 : 0);
+  }
+  // Neither tree was changed by being evaluated for an instantiation.
+  EXPECT_EQ(params[1]->default_assignment->toString(), "(long int)(N)");
+  EXPECT_EQ(params[2]->default_assignment->eval(errc).type, VT_DEPENDENT);
+}
+
+TEST(ParsingTest, InlineFunctionBodiesAreSkipped) {
+  const string code = R"cpp(
+    #define BLOCK(x) { x; }
+    struct widget {
+      int size() const { if (n) BLOCK(return n) return "}"[0]; }
+      int n;
+    };
+  )cpp";
+  auto ctex = Parse(code.c_str());
+  definition *widget = ctex.get_global()->look_up("widget");
+  ASSERT_NE(widget, nullptr);
+  ASSERT_TRUE(widget->flags & DEF_CLASS);
+  definition *size = ((definition_class*) widget)->find_local("size");
+  ASSERT_NE(size, nullptr);
+  EXPECT_NE(((definition_class*) widget)->find_local("n"), nullptr);
+
+  // The overload keeps where its body lies.
+  ASSERT_TRUE(size->flags & DEF_FUNCTION);
+  auto &overloads = ((definition_function*) size)->overloads;
+  ASSERT_EQ(overloads.size(), 1u);
+  auto *body = (SkippedBody*) overloads.begin()->second->implementation;
+  ASSERT_NE(body, nullptr);
+  ASSERT_TRUE(body->has_range());
+  EXPECT_EQ(body->filename, "test_input");
+  EXPECT_EQ(code.substr(body->begin, body->end - body->begin),
+            R"( if (n) BLOCK(return n) return "}"[0]; )");
+}
+
+definition_class *TypedefClass(const Context &ctex, const char *name) {
+  definition *d = ctex.get_global()->look_up(name);
+  if (!d || !(d->flags & DEF_TYPED)) return nullptr;
+  definition *t = ((definition_typed*) d)->type;
+  if (!t || !(t->flags & DEF_CLASS)) return nullptr;
+  return (definition_class*) t;
+}
+
+TEST(ParsingTest, TemplateSpecializationSelection) {
+  auto ctex = Parse(R"cpp(
+    template<class T> struct is_int { int generic; };
+    template<> struct is_int<int> { int special; };
+    template<int N> struct fact { int generic; };
+    template<> struct fact<0> { int zero; };
+    template<class T> struct ptr { int generic; };
+    template<class T> struct ptr<T*> { int pointer; };
+    typedef is_int<int> a;
+    typedef is_int<char> b;
+    typedef fact<0> c;
+    typedef fact<4> d;
+    typedef ptr<int*> e;
+    typedef ptr<int> f;
+    typedef is_int<int> g;
+  )cpp");
+  const std::pair<const char*, const char*> expected[] = {
+    {"a", "special"}, {"b", "generic"}, {"c", "zero"}, {"d", "generic"},
+    {"e", "pointer"}, {"f", "generic"}, {"g", "special"},
+  };
+  for (const auto &[tdef, member] : expected) {
+    definition_class *cls = TypedefClass(ctex, tdef);
+    ASSERT_NE(cls, nullptr) << tdef;
+    EXPECT_NE(cls->find_local(member), nullptr)
+        << tdef << " should use the specialization declaring " << member;
+  }
+  EXPECT_EQ(TypedefClass(ctex, "a"), TypedefClass(ctex, "g"));
+}
+
+TEST(ParsingTest, LazyTemplateMemberInstantiation) {
+  auto ctex = Parse(R"cpp(
+    template<class T> struct box {
+      typedef T value_type;
+      typedef value_type *pointer;
+      T contents;
+      value_type get();
+    };
+    typedef box<int> int_box;
+  )cpp");
+  definition_class *cls = TypedefClass(ctex, "int_box");
+  ASSERT_NE(cls, nullptr);
+  EXPECT_EQ(cls->members.count("get"), 0u);
+
+  definition *ptr = cls->find_local("pointer");
+  ASSERT_NE(ptr, nullptr);
+  ASSERT_TRUE(ptr->flags & DEF_TYPED);
+  definition *vt = ((definition_typed*) ptr)->type;
+  ASSERT_NE(vt, nullptr);
+  EXPECT_EQ(vt, cls->members["value_type"].get());
+  definition *param = ((definition_typed*) vt)->type;
+  ASSERT_NE(param, nullptr);
+  ASSERT_TRUE(param->flags & DEF_TYPED);
+  EXPECT_EQ(((definition_typed*) param)->type->name, "int");
+  EXPECT_EQ(cls->members.count("get"), 0u);
+
+  definition *get = cls->look_up("get");
+  ASSERT_NE(get, nullptr);
+  EXPECT_EQ(get->parent, cls);
+  EXPECT_NE(cls->toString().find("T contents;"), string::npos)
+      << cls->toString();
+  EXPECT_EQ(cls->lazy, nullptr);
+}
+
+TEST(ParsingTest, InstantiationsShareDependentValues) {
+  auto ctex = Parse(R"cpp(
+    template<int N> struct sized { enum dims { size = N * 4 + 1, next }; };
+    typedef sized<2> two;
+    typedef sized<5> five;
+  )cpp");
+  auto value_in = [](definition_scope *scope, size_t i) -> value {
+    definition *dims = scope ? scope->find_local("dims") : nullptr;
+    if (!dims || !(dims->flags & DEF_ENUM)) return value();
+    auto &constants = ((definition_enum*) dims)->constants;
+    return i < constants.size() ? constants[i].def->value_of : value();
+  };
+  definition_class *two = TypedefClass(ctex, "two");
+  definition_class *five = TypedefClass(ctex, "five");
+  ASSERT_NE(two, nullptr);
+  ASSERT_NE(five, nullptr);
+  EXPECT_EQ((long) value_in(two, 0), 9);
+  EXPECT_EQ((long) value_in(five, 0), 21);
+
+  // The pattern is untouched by either instantiation.
+  definition *sized = ctex.get_global()->look_up("sized");
+  ASSERT_NE(sized, nullptr);
+  ASSERT_TRUE(sized->flags & DEF_TEMPLATE);
+  auto *pattern = (definition_scope*) ((definition_template*) sized)->def.get();
+  EXPECT_EQ(value_in(pattern, 0).type, VT_DEPENDENT);
+}
+
+TEST(ParsingTest, LayeredContextLeavesBaseUntouched) {
+  Context base(error_constitutes_failure);
+  llreader base_read("base_input", R"cpp(
+    namespace ns { int a; }
+    typedef int base_int;
+    template<class T> struct tp { T x; };
+    int f(int);
+  )cpp", false);
+  base.parse_stream(base_read);
+  base.freeze();
+
+  Context layer(base, error_constitutes_failure);
+  llreader layer_read("layer_input", R"cpp(
+    namespace ns { int b; }
+    base_int c;
+    template<> struct tp<int> { int special; };
+    typedef tp<int> ti;
+    typedef tp<char> tc;
+    int f(double);
+  )cpp", false);
+  layer.parse_stream(layer_read);
+
+  definition *base_ns = base.get_global()->look_up("ns");
+  ASSERT_NE(base_ns, nullptr);
+  EXPECT_EQ(((definition_scope*) base_ns)->find_local("b"), nullptr);
+  EXPECT_EQ(base.get_global()->look_up("c"), nullptr);
+
+  definition *layer_ns = layer.get_global()->look_up("ns");
+  ASSERT_NE(layer_ns, nullptr);
+  EXPECT_NE(layer_ns, base_ns);
+  EXPECT_TRUE(layer.owns(layer_ns));
+  EXPECT_FALSE(layer.owns(base_ns));
+  EXPECT_NE(((definition_scope*) layer_ns)->find_local("a"), nullptr);
+  EXPECT_NE(((definition_scope*) layer_ns)->find_local("b"), nullptr);
+  EXPECT_NE(layer.get_global()->look_up("c"), nullptr);
+
+  // Specializations and instantiations made over the base stay in the layer.
+  auto *tp = (definition_template*) base.get_global()->look_up("tp");
+  EXPECT_TRUE(tp->specializations.empty());
+  EXPECT_TRUE(tp->instantiations.empty());
+  definition_class *ti = TypedefClass(layer, "ti");
+  ASSERT_NE(ti, nullptr);
+  EXPECT_NE(ti->look_up("special"), nullptr);
+  ASSERT_NE(TypedefClass(layer, "tc"), nullptr);
+
+  // Overloading a base function adds to its overloads instead of hiding them.
+  auto *base_f = (definition_function*) base.get_global()->look_up("f");
+  auto *layer_f = (definition_function*) layer.get_global()->look_up("f");
+  EXPECT_EQ(base_f->overloads.size(), 1u);
+  ASSERT_NE(layer_f, base_f);
+  EXPECT_EQ(layer_f->overloads.size(), 2u);
+}
+
+TEST(ParsingTest, FrozenContextConcurrentReads) {
+  auto ctex = Parse(R"cpp(
+    template<class T> struct box {
+      typedef T value_type;
+      value_type get();
+    };
+    typedef box<int> int_box;
+  )cpp");
+  definition_class *int_box = TypedefClass(ctex, "int_box");
+  ASSERT_NE(int_box, nullptr);
+  ASSERT_NE(int_box->lazy, nullptr);
+  ctex.freeze();
+  ASSERT_TRUE(ctex.is_frozen());
+  EXPECT_TRUE(int_box->flags & DEF_FROZEN);
+  EXPECT_EQ(int_box->lazy, nullptr);
+  EXPECT_NE(int_box->members.count("get"), 0u);
+
+  definition *box = ctex.get_global()->look_up("box");
+  ASSERT_NE(box, nullptr);
+  ASSERT_TRUE(box->flags & DEF_TEMPLATE);
+  definition_template *box_temp = (definition_template*) box;
+  const size_t instantiations = box_temp->instantiations.size();
+
+  // Instantiations made by each thread are private to it, and are freed when
+  // it exits; inspect them before then.
+  constexpr int kThreads = 4;
+  bool worked[kThreads] = {};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; ++i) threads.emplace_back([&, i] {
+    for (int j = 0; j < 64; ++j) {
+      definition_class *cls = TypedefClass(ctex, "int_box");
+      if (cls != int_box || !cls->find_local("value_type") || !cls->look_up("get"))
+        return;
+      cls->toString();
+    }
+    arg_key key(1);
+    key.put_type(0, full_type(builtin_type__char));
+    ErrorContext errc = error_constitutes_failure->at({"frozen_test", 0, 0});
+    definition *inst = box_temp->instantiate(key, errc);
+    worked[i] = inst && inst == box_temp->instantiate(key, errc)
+                     && ((definition_class*) inst)->look_up("get");
+  });
+  for (std::thread &t : threads) t.join();
+
+  for (int i = 0; i < kThreads; ++i)
+    EXPECT_TRUE(worked[i]) << "thread " << i;
+  EXPECT_EQ(box_temp->instantiations.size(), instantiations);
+
+  // Neither lookups nor evaluation write into shared tables.
+  ASSERT_EQ(box_temp->params.size(), 1u);
+  definition_tempparam *param = box_temp->params[0].get();
+  const size_t param_members = param->members.size();
+  EXPECT_EQ(param->get_local("nested"), nullptr);
+  EXPECT_EQ(param->members.size(), param_members);
+  const size_t symbol_count = symbols.size();
+  AST_Node_Unary unknown(std::make_unique<AST_Node>("1", AT_DECLITERAL), "@",
+                         true);
+  ErrorCounter herr;
+  (void) unknown.eval(herr.at({"frozen_test", 0, 0}));
+  EXPECT_EQ(herr.errors, 1);
+  EXPECT_EQ(symbols.size(), symbol_count);
+}
+
+TEST(ParsingTest, ParallelParseFiles) {
+  Context base(error_constitutes_failure);
+  llreader base_read("base_input", R"cpp(
+    template<class T> struct box { T contents; };
+    #define BOXED(x) box<x>
+  )cpp", false);
+  base.parse_stream(base_read);
+  // Workers search the base's include path.
+  const std::filesystem::path inc =
+      std::filesystem::path(::testing::TempDir()) / "parallel_include";
+  std::filesystem::create_directories(inc);
+  std::ofstream(inc / "parallel_x.h") << "int from_x;";
+  base.add_search_directory(inc.string());
+
+  const char *const sources[] = {
+    "typedef BOXED(int) box0; int only0;",
+    "typedef BOXED(char) box1; int only1;\n#include <parallel_x.h>\n",
+    "typedef BOXED(int) box2; int only2;",
+  };
+  vector<std::filesystem::path> paths;
+  for (size_t i = 0; i < std::size(sources); ++i) {
+    paths.push_back(std::filesystem::path(::testing::TempDir()) /
+                    ("parallel_parse_" + std::to_string(i) + ".h"));
+    std::ofstream(paths.back()) << sources[i];
+  }
+  ParsedFiles res = parse_files(paths, 2, error_constitutes_failure, true, &base);
+  for (const auto &path : paths) std::filesystem::remove(path);
+  std::filesystem::remove_all(inc);
+
+  EXPECT_TRUE(base.is_frozen());
+  ASSERT_EQ(res.contexts.size(), paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    const string n = std::to_string(i);
+    ASSERT_NE(res.contexts[i], nullptr);
+    definition_class *cls = TypedefClass(*res.contexts[i], ("box" + n).c_str());
+    ASSERT_NE(cls, nullptr) << n;
+    EXPECT_NE(cls->look_up("contents"), nullptr) << n;
+    for (size_t j = 0; j < paths.size(); ++j)
+      EXPECT_EQ(res.contexts[i]->get_global()->look_up("only" + std::to_string(j))
+                    != nullptr, i == j) << n;
+  }
+  EXPECT_NE(res.contexts[1]->get_global()->look_up("from_x"), nullptr);
+  ASSERT_NE(res.merged, nullptr);
+  for (size_t i = 0; i < paths.size(); ++i)
+    EXPECT_NE(res.merged->get_global()->look_up("only" + std::to_string(i)),
+              nullptr);
+  EXPECT_NE(res.merged->get_macros().count("BOXED"), 0u);
+}
+
+TEST(ParsingTest, ObserverSeesEachCompletedDeclaration) {
+  struct Recorder: DeclarationObserver {
+    std::vector<string> seen;
+    void declared(definition *def, const SourceRange &range) override {
+      seen.push_back(def->qualified_id() + " " + std::to_string(range.begin.line)
+                     + "-" + std::to_string(range.end.line));
+    }
+  } recorder;
+  Context ctex(error_constitutes_failure);
+  ctex.set_observer(&recorder);
+  llreader read("observed_input", R"cpp(
+    namespace ns {
+      struct point {
+        int x, y;
+      };
+      enum mode { on, off };
+    }
+    typedef ns::point *point_ptr;
+    struct ns::point *again;
+    template<class T> struct box { T contents; };
+    int area(int w,
+             int h) {
+      return w * h;
+    }
+    struct meter { operator int() {
+      return 1; } };
+  )cpp", false);
+  ASSERT_EQ(ctex.parse_stream(read), 0);
+  // Members come before their scopes; naming `point' again declares nothing.
+  // Function definitions end at their closing brace.
+  EXPECT_THAT(recorder.seen, ::testing::ElementsAre(
+      "::ns::point::x 4-4", "::ns::point::y 4-4", "::ns::point 3-5",
+      "::ns::mode 6-6", "::ns 2-7", "::point_ptr 8-8", "::again 9-9",
+      "::box::box::contents 10-10", "::box 10-10", "::area 11-14",
+      "::meter::(cast) 15-16", "::meter 15-16"));
+}
+
+TEST(ParsingTest, FilterDiscardsRejectedFunctions) {
+  const char *code = R"cpp(
+    namespace keep { int f(int); struct s { void m(); }; }
+    namespace drop {
+      int g(int); int g(float);
+      template<class T> T h(T) { return T(); }
+      struct t { void m() {} int x; };
+      int v;
+    }
+    namespace keep { using drop::g; int use(drop::t *p); }
+  )cpp";
+  auto overloads = [](Context &ctex, const char *scope, const char *name) {
+    auto *sc = (definition_scope*) ctex.get_global()->look_up(scope);
+    auto *fn = dynamic_cast<definition_function*>(sc->look_up(name));
+    return fn ? fn->overloads.size() + fn->template_overloads.size()
+              : size_t(-1);
+  };
+
+  DeclarationFilter filter;
+  filter.scopes = {"keep"};
+  Context ctex(error_constitutes_failure);
+  ctex.set_filter(&filter);
+  llreader read("filtered_input", code, false);
+  ASSERT_EQ(ctex.parse_stream(read), 0);
+  // Rejected functions remain declared, without overloads; the rest stays.
+  EXPECT_EQ(overloads(ctex, "keep", "f"), 1u);
+  EXPECT_EQ(overloads(ctex, "keep", "use"), 1u);
+  EXPECT_EQ(overloads(ctex, "drop", "g"), 0u);
+  EXPECT_EQ(overloads(ctex, "drop", "h"), 0u);
+  auto *t = (definition_scope*) ((definition_scope*)
+      ctex.get_global()->look_up("drop"))->look_up("t");
+  EXPECT_EQ(((definition_function*) t->look_up("m"))->overloads.size(), 0u);
+  EXPECT_NE(t->look_up("x"), nullptr);
+  EXPECT_NE(((definition_scope*) ctex.get_global()->look_up("drop"))
+                ->look_up("v"), nullptr);
+
+  // Rules combine; a file outside every prefix keeps no functions at all.
+  filter.path_prefixes = {"elsewhere/"};
+  Context ctex2(error_constitutes_failure);
+  ctex2.set_filter(&filter);
+  llreader read2("filtered_input", code, false);
+  ASSERT_EQ(ctex2.parse_stream(read2), 0);
+  EXPECT_EQ(overloads(ctex2, "keep", "f"), 0u);
+  filter.path_prefixes = {"filtered_"};
+  filter.kinds = DEF_TYPENAME;
+  Context ctex3(error_constitutes_failure);
+  ctex3.set_filter(&filter);
+  llreader read3("filtered_input", code, false);
+  ASSERT_EQ(ctex3.parse_stream(read3), 0);
+  EXPECT_EQ(overloads(ctex3, "keep", "f"), 0u);
+  EXPECT_NE(((definition_scope*) ctex3.get_global()->look_up("drop"))
+                ->look_up("v"), nullptr);
+  filter.kinds = DEF_FUNCTION;
+  Context ctex4(error_constitutes_failure);
+  ctex4.set_filter(&filter);
+  llreader read4("filtered_input", code, false);
+  ASSERT_EQ(ctex4.parse_stream(read4), 0);
+  EXPECT_EQ(overloads(ctex4, "keep", "f"), 1u);
+  EXPECT_EQ(overloads(ctex4, "drop", "g"), 0u);
+}
+
+TEST(ParsingTest, FilterKeepsRedeclarationsAndResolvesPaths) {
+  namespace fs = std::filesystem;
+  const fs::path dir = fs::path(::testing::TempDir()) / "filter_paths";
+  fs::create_directories(dir / "mine");
+  fs::create_directories(dir / "sys");
+  std::ofstream(dir / "mine" / "a.h") << R"cpp(
+    int f(int);
+    #include "../sys/s.h"
+    int mine_only(int);
+  )cpp";
+  std::ofstream(dir / "sys" / "s.h") << "int f(int); int sys_only(int);";
+
+  DeclarationFilter filter;
+  filter.path_prefixes = {(dir / "mine").generic_string() + "/"};
+  Context ctex(error_constitutes_failure);
+  ctex.set_filter(&filter);
+  llreader read(dir / "mine" / "a.h");
+  ASSERT_EQ(ctex.parse_stream(read), 0);
+  fs::remove_all(dir);
+
+  auto overloads = [&](const char *name) {
+    auto *fn = dynamic_cast<definition_function*>(
+        ctex.get_global()->look_up(name));
+    return fn ? fn->overloads.size() : size_t(-1);
+  };
+  // Redeclaring f from a rejected header does not take back the overload
+  // kept from ours, and `mine/../sys` is not inside `mine/`.
+  EXPECT_EQ(overloads("f"), 1u);
+  EXPECT_EQ(overloads("mine_only"), 1u);
+  EXPECT_EQ(overloads("sys_only"), 0u);
+}
+
+TEST(ParsingTest, SaveAndLoadRoundTrip) {
+  auto saved = Parse(R"cpp(
+    #define SQUARE(x) ((x) * (x))
+    #define ANSWER 42
+    namespace ns {
+      enum color { red, green = 4, blue };
+      int scale(int x, int factor = SQUARE(3));
+    }
+    template<class T> struct box { T contents; typedef T *pointer; };
+    template<> struct box<char> { int special; };
+    typedef box<int> int_box;
+    typedef box<char> char_box;
+    struct node { node *next; int values[ANSWER]; };
+  )cpp");
+  const std::filesystem::path file =
+      std::filesystem::path(::testing::TempDir()) / "saved_context.jdi";
+  ASSERT_EQ(saved.save(file), 0);
+
+  Context loaded(error_constitutes_failure);
+  ASSERT_EQ(loaded.load(file), 0);
+  std::filesystem::remove(file);
+  EXPECT_EQ(loaded.get_global()->toString(), saved.get_global()->toString());
+  for (const char *name : {"SQUARE", "ANSWER"}) {
+    auto macro = loaded.get_macros().find(name);
+    ASSERT_NE(macro, loaded.get_macros().end()) << name;
+    EXPECT_EQ(macro->second->toString(),
+              saved.get_macros().find(name)->second->toString());
+  }
+
+  definition *ns = loaded.get_global()->look_up("ns");
+  ASSERT_NE(ns, nullptr);
+  definition *blue = ((definition_scope*) ns)->find_local("blue");
+  ASSERT_NE(blue, nullptr);
+  ASSERT_TRUE(blue->flags & DEF_VALUED);
+  EXPECT_EQ((long) ((definition_valued*) blue)->value_of, 5);
+
+  definition *scale = ((definition_scope*) ns)->find_local("scale");
+  ASSERT_NE(scale, nullptr);
+  ASSERT_TRUE(scale->flags & DEF_FUNCTION);
+  auto &overloads = ((definition_function*) scale)->overloads;
+  ASSERT_EQ(overloads.size(), 1u);
+  const ref_stack &refs = overloads.begin()->second->referencers;
+  ASSERT_EQ(refs.top().type, ref_stack::RT_FUNCTION);
+  const auto &params = ((const ref_stack::node_func&) refs.top()).params;
+  ASSERT_EQ(params.size(), 2u);
+  ASSERT_NE(params[1].default_value, nullptr);
+  EXPECT_EQ((long) params[1].default_value->eval(
+                error_constitutes_failure->at({"test", 0, 0})), 9);
+
+  definition_class *char_box = TypedefClass(loaded, "char_box");
+  ASSERT_NE(char_box, nullptr);
+  EXPECT_NE(char_box->find_local("special"), nullptr);
+
+  // The loaded template can still be instantiated anew.
+  loaded.freeze();
+  Context layer(loaded, error_constitutes_failure);
+  llreader read("layer_input", "typedef box<long> long_box;", false);
+  layer.parse_stream(read);
+  definition_class *long_box = TypedefClass(layer, "long_box");
+  ASSERT_NE(long_box, nullptr);
+  EXPECT_NE(long_box->look_up("contents"), nullptr);
+  EXPECT_EQ(long_box->look_up("special"), nullptr);
+}
+
+TEST(ParsingTest, DamagedSavedContextsAreRejected) {
+  auto saved = Parse(R"cpp(
+    #define SQUARE(x) ((x) * (x))
+    namespace ns {
+      enum color { red, green = 4, blue };
+      int scale(int x, int factor = SQUARE(3));
+      int scale(double x);
+    }
+    template<class T> struct box { T contents; typedef T *pointer; };
+    template<> struct box<char> { int special; };
+    template<class T> struct box<T*> { int ptr; };
+    typedef box<int> int_box;
+    struct node: box<int> { node *next; int values[4]; };
+    template<class T> T maxi(T a, T b);
+  )cpp");
+  const std::filesystem::path file =
+      std::filesystem::path(::testing::TempDir()) / "damaged_context.jdi";
+  ASSERT_EQ(saved.save(file), 0);
+  std::string data;
+  {
+    std::ifstream in(file, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  ASSERT_FALSE(data.empty());
+  auto write = [&](const std::string &bytes) {
+    std::ofstream(file, std::ios::binary | std::ios::trunc) << bytes;
+  };
+
+  // Every truncation is reported, whether read in full or on demand.
+  for (size_t len = 0; len < data.size(); len += 1 + data.size() / 64) {
+    write(data.substr(0, len));
+    for (bool lazy : {false, true}) {
+      ErrorCounter herr;
+      Context loaded(&herr);
+      const int res = lazy ? loaded.load_mapped(file) : loaded.load(file);
+      if (!res) loaded.freeze();
+      EXPECT_TRUE(res || herr.errors) << "truncated to " << len;
+    }
+  }
+
+  // A corrupted byte anywhere is either reported or harmless; what was read
+  // must be safe to print and to freeze.
+  int rejected = 0;
+  for (size_t at = 0; at < data.size(); ++at) {
+    std::string bad = data;
+    bad[at] ^= 0x5A;
+    write(bad);
+    for (bool lazy : {false, true}) {
+      ErrorCounter herr;
+      Context loaded(&herr);
+      const int res = lazy ? loaded.load_mapped(file) : loaded.load(file);
+      if (res) { ++rejected; continue; }
+      (void) loaded.get_global()->toString();
+      loaded.freeze();
+      (void) loaded.get_global()->toString();
+    }
+  }
+  EXPECT_GT(rejected, 0);
+  std::filesystem::remove(file);
+}
+
+TEST(ParsingTest, MappedContextReadsScopesOnDemand) {
+  auto saved = Parse(R"cpp(
+    namespace touched { struct widget { int width; }; }
+    namespace untouched { struct gadget { int size; }; }
+    typedef touched::widget *widget_ptr;
+  )cpp");
+  const std::filesystem::path file =
+      std::filesystem::path(::testing::TempDir()) / "mapped_context.jdi";
+  ASSERT_EQ(saved.save(file), 0);
+
+  Context mapped(error_constitutes_failure);
+  ASSERT_EQ(mapped.load_mapped(file), 0);
+  auto *touched = dynamic_cast<definition_scope*>(
+      mapped.get_global()->look_up("touched"));
+  auto *untouched = dynamic_cast<definition_scope*>(
+      mapped.get_global()->look_up("untouched"));
+  ASSERT_NE(touched, nullptr);
+  ASSERT_NE(untouched, nullptr);
+  EXPECT_NE(touched->deferred, nullptr);
+  EXPECT_NE(untouched->deferred, nullptr);
+
+  // Reaching a class through a typedef reads only that class.
+  definition_class *widget = TypedefClass(mapped, "widget_ptr");
+  ASSERT_NE(widget, nullptr);
+  EXPECT_NE(widget->find_local("width"), nullptr);
+  EXPECT_NE(touched->deferred, nullptr);
+  EXPECT_EQ(touched->find_local("widget"), widget);
+  EXPECT_EQ(touched->deferred, nullptr);
+  EXPECT_NE(untouched->deferred, nullptr);
+
+  // Freezing reads in the rest.
+  mapped.freeze();
+  EXPECT_EQ(untouched->deferred, nullptr);
+  EXPECT_EQ(mapped.get_global()->toString(), saved.get_global()->toString());
+  std::filesystem::remove(file);
+}
+
+TEST(ParsingTest, IncrementalReparse) {
+  Context base(error_constitutes_failure);
+  const std::filesystem::path dir = ::testing::TempDir();
+  const auto write = [&](const char *name, const char *text) {
+    std::ofstream(dir / name) << text;
+  };
+  write("incr_a.h", R"cpp(
+    #define FROM_A 1
+    template<class T> struct box { T contents; };
+    struct a_type { int a_member; };
+  )cpp");
+  write("incr_b.h", R"cpp(
+    template<> struct box<char> { int special; };
+    int b_old;
+  )cpp");
+  write("incr_main.cc", R"cpp(
+    int before;
+    #include "incr_a.h"
+    #include "incr_b.h"
+    typedef box<char> boxc;
+    int after;
+  )cpp");
+
+  IncrementalParse tu(dir / "incr_main.cc", error_constitutes_failure, &base);
+  EXPECT_EQ(tu.parse(), 0);
+  ASSERT_EQ(tu.pieces().size(), 3u);
+  EXPECT_EQ(tu.reparsed_from(), 0u);
+  definition_scope *global = tu.context().get_global();
+  for (const char *name : {"before", "a_type", "b_old", "after"})
+    EXPECT_NE(global->look_up(name), nullptr) << name;
+  definition_class *boxc = TypedefClass(tu.context(), "boxc");
+  ASSERT_NE(boxc, nullptr);
+  EXPECT_NE(boxc->look_up("special"), nullptr);
+  EXPECT_EQ(tu.pieces()[0].context->get_macros().count("FROM_A"), 0u);
+  EXPECT_NE(tu.context().get_macros().count("FROM_A"), 0u);
+
+  // Only the piece including b, and those after, are parsed again.
+  const Context *checkpoint = tu.pieces()[1].context.get();
+  write("incr_b.h", "int b_new;");
+  EXPECT_EQ(tu.reparse(dir / "incr_b.h"), 0);
+  EXPECT_EQ(tu.reparsed_from(), 2u);
+  EXPECT_EQ(tu.pieces()[1].context.get(), checkpoint);
+  global = tu.context().get_global();
+  EXPECT_EQ(global->look_up("b_old"), nullptr);
+  for (const char *name : {"before", "a_type", "b_new", "after"})
+    EXPECT_NE(global->look_up(name), nullptr) << name;
+  boxc = TypedefClass(tu.context(), "boxc");
+  ASSERT_NE(boxc, nullptr);
+  EXPECT_NE(boxc->look_up("contents"), nullptr);
+
+  EXPECT_EQ(tu.reparse(dir / "incr_a.h"), 0);
+  EXPECT_EQ(tu.reparsed_from(), 1u);
+  EXPECT_EQ(tu.reparse(dir / "incr_unrelated.h"), 0);
+  EXPECT_EQ(tu.reparsed_from(), 3u);
+
+  for (const char *name : {"incr_a.h", "incr_b.h", "incr_main.cc"})
+    std::filesystem::remove(dir / name);
+}
+
+TEST(ParsingTest, IncrementalParseMatchesFullParse) {
+  const std::filesystem::path dir = ::testing::TempDir();
+  const auto write = [&](const char *name, const char *text) {
+    std::ofstream(dir / name) << text;
+  };
+  write("span_a.h", "void f(int); namespace ns { int a; }");
+  write("span_b.h", "void f(double); namespace ns { int b; }");
+  write("span_main.cc", R"cpp(
+    #include "span_a.h"
+    #include "span_b.h"
+    void f(char);
+    namespace ns { int c; }
+  )cpp");
+
+  Context full(error_constitutes_failure);
+  llreader read(dir / "span_main.cc");
+  ASSERT_EQ(full.parse_stream(read), 0);
+  IncrementalParse tu(dir / "span_main.cc", error_constitutes_failure);
+  ASSERT_EQ(tu.parse(), 0);
+  ASSERT_EQ(tu.pieces().size(), 3u);
+  for (const char *name : {"span_a.h", "span_b.h", "span_main.cc"})
+    std::filesystem::remove(dir / name);
+
+  // Overloads and namespace members declared across checkpoints add up.
+  for (const Context *ctex : {(const Context*) &full, &tu.context()}) {
+    auto *f = dynamic_cast<definition_function*>(
+        ctex->get_global()->look_up("f"));
+    ASSERT_NE(f, nullptr);
+    EXPECT_EQ(f->overloads.size(), 3u);
+    auto *ns = (definition_scope*) ctex->get_global()->look_up("ns");
+    ASSERT_NE(ns, nullptr);
+    for (const char *name : {"a", "b", "c"})
+      EXPECT_NE(ns->find_local(name), nullptr) << name;
+  }
+}
+
+TEST(ParsingTest, ParseStatsCountPhases) {
+  const std::filesystem::path dir = ::testing::TempDir();
+  std::ofstream(dir / "stats_inc.h") << R"cpp(
+    #define TWICE(x) ((x) * 2)
+    template<int N> struct box { enum { size = TWICE(N) }; };
+  )cpp";
+  std::ofstream(dir / "stats_main.cc") << R"cpp(
+    #include "stats_inc.h"
+    box<3> a;
+    box<4> b;
+    box<3> c;
+  )cpp";
+
+  ParseStats stats;
+  Context ctex(error_constitutes_failure);
+  ctex.set_stats(&stats);
+  llreader read(dir / "stats_main.cc");
+  const size_t size = read.length;
+  ASSERT_EQ(ctex.parse_stream(read), 0);
+  std::filesystem::remove(dir / "stats_inc.h");
+  std::filesystem::remove(dir / "stats_main.cc");
+
+  EXPECT_EQ(stats.files_opened, 2u);
+  EXPECT_GT(stats.bytes_mapped, size);
+  EXPECT_GT(stats.tokens, 20u);
+  EXPECT_EQ(stats.macros_expanded, 1u);
+  EXPECT_GT(stats.lookups, 0u);
+  EXPECT_EQ(stats.instantiations, 2u);
+  for (int i = 0; i < ParseStats::PHASE_COUNT; ++i)
+    EXPECT_GT(stats.time[i].count(), 0) << ParseStats::phase_name(ParseStats::Phase(i));
+
+  const std::string json = stats.to_json();
+  EXPECT_NE(json.find("\"instantiations\": 2"), std::string::npos) << json;
+  EXPECT_NE(json.find("\"lexing\": "), std::string::npos) << json;
+
+  // Nothing is collected once the stats are taken away.
+  ctex.set_stats(nullptr);
+  const size_t tokens = stats.tokens;
+  llreader more("more", "int d;", false);
+  ASSERT_EQ(ctex.parse_stream(more), 0);
+  EXPECT_EQ(stats.tokens, tokens);
+}
+
+TEST(ParsingTest, ParseTraceNestsSpans) {
+  const std::filesystem::path dir = ::testing::TempDir();
+  std::ofstream(dir / "trace_inc.h") << R"cpp(
+    template<int N> struct box { enum { size = N * 2 }; };
+  )cpp";
+  std::ofstream(dir / "trace_main.cc") << R"cpp(
+    #include "trace_inc.h"
+    namespace ns { box<3> a; }
+  )cpp";
+
+  ParseTrace trace;
+  Context ctex(error_constitutes_failure);
+  ctex.set_trace(&trace);
+  llreader read(dir / "trace_main.cc");
+  ASSERT_EQ(ctex.parse_stream(read), 0);
+  std::filesystem::remove(dir / "trace_inc.h");
+  std::filesystem::remove(dir / "trace_main.cc");
+
+  const auto find = [&](ParseTrace::Category category, std::string_view name)
+      -> const ParseTrace::Event* {
+    for (const ParseTrace::Event &ev : trace.events()) {
+      if (ev.category == category &&
+          std::string_view(ev.name).substr(0, name.length()) == name)
+        return &ev;
+    }
+    return nullptr;
+  };
+  const auto within = [](const ParseTrace::Event *inner,
+                         const ParseTrace::Event *outer) {
+    return inner->begin >= outer->begin &&
+           inner->begin + inner->length <= outer->begin + outer->length;
+  };
+  const auto *main_file = find(ParseTrace::SOURCE_FILE, (dir / "trace_main.cc").string());
+  const auto *inc_file = find(ParseTrace::SOURCE_FILE, (dir / "trace_inc.h").string());
+  const auto *box = find(ParseTrace::DECLARATION, "::box");
+  const auto *ns = find(ParseTrace::DECLARATION, "::ns");
+  const auto *a = find(ParseTrace::DECLARATION, "::ns::a");
+  const auto *inst = find(ParseTrace::INSTANTIATION, "::box<3>");
+  for (const auto *ev : {main_file, inc_file, box, ns, a, inst}) {
+    ASSERT_NE(ev, nullptr) << trace.to_json();
+    EXPECT_TRUE(ev->ended) << ev->name;
+  }
+  EXPECT_TRUE(within(inc_file, main_file));
+  EXPECT_TRUE(within(box, inc_file));
+  EXPECT_TRUE(within(ns, main_file));
+  EXPECT_FALSE(within(ns, inc_file));
+  EXPECT_TRUE(within(a, ns));
+  EXPECT_TRUE(within(inst, a));
+
+  const std::string json = trace.to_json();
+  EXPECT_NE(json.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\": \"::box<3>\", \"cat\": \"instantiation\", "
+                      "\"ph\": \"X\""), std::string::npos) << json;
+}
+
+TEST(ParsingTest, BenchmarkCorpusParsesCleanly) {
+  jdi_bench::CorpusShape shape = jdi_bench::CorpusShape::scaled(2);
+  shape.include_depth = 2;
+  const std::filesystem::path dir =
+      std::filesystem::path(::testing::TempDir()) / "jdi_corpus";
+  const jdi_bench::Corpus corpus = jdi_bench::generate_corpus(dir, shape);
+  ASSERT_EQ(corpus.files.size(), 7u);
+  EXPECT_EQ(jdi_bench::generate_header(shape, 3, {}),
+            jdi_bench::generate_header(shape, 3, {}));
+
+  ParseStats stats;
+  Context ctex(error_constitutes_failure);
+  ctex.set_stats(&stats);
+  llreader read(corpus.main);
+  EXPECT_EQ(ctex.parse_stream(read), 0);
+  for (const std::filesystem::path &file : corpus.files)
+    std::filesystem::remove(file);
+  std::filesystem::remove(dir);
+
+  EXPECT_EQ(stats.files_opened, corpus.files.size());
+  EXPECT_EQ(stats.bytes_mapped, corpus.bytes);
+  auto *ns = dynamic_cast<definition_scope*>(
+      ctex.get_global()->find_local("ns_5_0"));
+  ASSERT_NE(ns, nullptr);
+  ns = dynamic_cast<definition_scope*>(ns->find_local("ns_5_1"));
+  ASSERT_NE(ns, nullptr);
+  ns = dynamic_cast<definition_scope*>(ns->find_local("ns_5_2"));
+  ASSERT_NE(ns, nullptr);
+  for (const char *name : {"class_5_15", "chain_type_5_15", "wrapped_h5_15",
+                           "wrapped_fn_h5_15", "enum_5_63"})
+    EXPECT_NE(ns->find_local(name), nullptr) << name;
+  EXPECT_EQ(stats.instantiations, 6u * 16u);
+}
+
 }  // namespace
 }  // namespace jdi
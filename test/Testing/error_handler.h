@@ -8,17 +8,26 @@ namespace {
 class ErrorConstitutesFailure : public jdi::ErrorHandler {
   void error(std::string_view err, jdi::SourceLocation sloc) final {
     ADD_FAILURE() << "Underlying code reported an error: " << err
-                  << " (at " << sloc.filename << ":" << sloc.line << ":"
+                  << " (at " << sloc.filename() << ":" << sloc.line << ":"
                   << sloc.pos << ")";
   }
   void warning(std::string_view err, jdi::SourceLocation sloc) final {
     ADD_FAILURE() << "Underlying code reported a warning: " << err
-                  << " (at " << sloc.filename << ":" << sloc.line << ":"
+                  << " (at " << sloc.filename() << ":" << sloc.line << ":"
                   << sloc.pos << ")";
   }
   void info(std::string_view, int, jdi::SourceLocation) final {}
 } *error_constitutes_failure = new ErrorConstitutesFailure;
 
+/// Counts the errors reported, for tests in which they are expected.
+class ErrorCounter : public jdi::ErrorHandler {
+ public:
+  int errors = 0;
+  void error(std::string_view, jdi::SourceLocation) final { ++errors; }
+  void warning(std::string_view, jdi::SourceLocation) final {}
+  void info(std::string_view, int, jdi::SourceLocation) final {}
+};
+
 }  // namespace
 
 #endif  // JDI_TESTING_ERROR_HANDLER_h